@@ -7,6 +7,7 @@ using Vocaluxe.Base;
 using System.Diagnostics;
 using Vocaluxe.Lib.Song;
 using Vocaluxe.Lib.Draw;
+using Vocaluxe.Lib.Video;
 using System.Drawing;
 using Vocaluxe.Menu;
 
@@ -454,6 +455,7 @@ namespace Vocaluxe.Base
             if (_Video == -1)
             {
                 _Video = CVideo.VdLoad(_CurrentPlaylistElement.VideoFilePath);
+                CVideo.VdSetPriority(_Video, EVideoPriority.Background);
                 CVideo.VdSkip(_Video, 0f, _CurrentPlaylistElement.VideoGap);
                 _VideoEnabled = true;
                 _FadeTimer.Reset();
@@ -251,6 +251,9 @@ namespace Vocaluxe.Base
         public static EOffOn VideoPreview = EOffOn.TR_CONFIG_ON;
         public static EOffOn VideosInSongs = EOffOn.TR_CONFIG_ON;
         public static EOffOn VideosToBackground = EOffOn.TR_CONFIG_OFF;
+        public static EOffOn MapMediaFiles = EOffOn.TR_CONFIG_OFF;
+        public static int VideoLoopCacheSize = 0;       //[MB]
+        public static int VideoLoopCacheLength = 30;    //[s]
 
         // Record
         public static SMicConfig[] MicConfig;
@@ -427,6 +430,16 @@ namespace Vocaluxe.Base
                 CHelper.TryGetEnumValueFromXML<EOffOn>("//root/Video/VideoPreview", navigator, ref VideoPreview);
                 CHelper.TryGetEnumValueFromXML<EOffOn>("//root/Video/VideosInSongs", navigator, ref VideosInSongs);
                 CHelper.TryGetEnumValueFromXML<EOffOn>("//root/Video/VideosToBackground", navigator, ref VideosToBackground);
+                CHelper.TryGetEnumValueFromXML<EOffOn>("//root/Video/MapMediaFiles", navigator, ref MapMediaFiles);
+                CHelper.TryGetIntValueFromXML("//root/Video/VideoLoopCacheSize", navigator, ref VideoLoopCacheSize);
+                if (VideoLoopCacheSize < 0)
+                    VideoLoopCacheSize = 0;
+                if (VideoLoopCacheSize > 1024)
+                    VideoLoopCacheSize = 1024;
+
+                CHelper.TryGetIntValueFromXML("//root/Video/VideoLoopCacheLength", navigator, ref VideoLoopCacheLength);
+                if (VideoLoopCacheLength < 0)
+                    VideoLoopCacheLength = 0;
                 #endregion Video
 
                 #region Record
@@ -668,6 +681,15 @@ namespace Vocaluxe.Base
             writer.WriteComment("Show backgroundmusic videos as background: " + ListStrings(Enum.GetNames(typeof(EOffOn))));
             writer.WriteElementString("VideosToBackground", Enum.GetName(typeof(EOffOn), VideosToBackground));
 
+            writer.WriteComment("Read song and video files through memory mapping (for songs on local drives): " + ListStrings(Enum.GetNames(typeof(EOffOn))));
+            writer.WriteElementString("MapMediaFiles", Enum.GetName(typeof(EOffOn), MapMediaFiles));
+
+            writer.WriteComment("Memory to keep the decoded frames of short looping videos in (MB per video, 0 = off): 0..1024");
+            writer.WriteElementString("VideoLoopCacheSize", VideoLoopCacheSize.ToString());
+
+            writer.WriteComment("Maximum length of videos kept in the loop cache (seconds)");
+            writer.WriteElementString("VideoLoopCacheLength", VideoLoopCacheLength.ToString());
+
             writer.WriteEndElement();
             #endregion Video
 
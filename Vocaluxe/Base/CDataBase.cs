@@ -6,6 +6,7 @@ using System.Drawing.Imaging;
 using System.Runtime.InteropServices;
 using System.IO;
 using System.Text;
+using System.Threading;
 
 #if WIN
 using System.Data.SQLite;
@@ -21,6 +22,7 @@ using Community.CsharpSqlite;
 
 using Vocaluxe.Lib.Draw;
 using Vocaluxe.Lib.Song;
+using Vocaluxe.Lib.Video.Acinerella;
 
 namespace Vocaluxe.Base
 {
@@ -34,6 +36,16 @@ namespace Vocaluxe.Base
             public string str2;
         }
 
+        struct SDecodedCover
+        {
+            public int Index;
+            public int Width;
+            public int Height;
+            public byte[] Data;
+        }
+
+        private const int COVERQUEUESIZE = 32;      // decoded covers waiting to be stored at most
+
         private static string _HighscoreFilePath;
         private static string _CoverFilePath;
         private static string _CreditsRessourcesFilePath;
@@ -974,151 +986,348 @@ namespace Vocaluxe.Base
         #region Cover
         public static bool GetCover(string CoverPath, ref STexture tex, int MaxSize)
         {
-            bool result = false;
-
             if (!File.Exists(CoverPath))
             {
                 CLog.LogError("Can't find File: " + CoverPath);
                 return false;
             }
 
-            if (_ConnectionCover == null)
+            SQLiteCommand command = GetCoverCommand();
+            bool result = ReadCover(command, CoverPath, ref tex);
+            if (!result && HasFailedCover(command, CoverPath))
             {
-                _ConnectionCover = new SQLiteConnection();
-                _ConnectionCover.ConnectionString = "Data Source=" + _CoverFilePath;
-                _ConnectionCover.Open();
+                tex = new STexture(-1);
             }
+            else if (!result)
+            {
+                int w, h;
+                byte[] data = DecodeCover(CoverPath, 0f, MaxSize, out w, out h);
+                if (data == null)
+                    data = DecodeCoverBitmap(CoverPath, MaxSize, out w, out h);
 
-            SQLiteCommand command;
-            command = new SQLiteCommand(_ConnectionCover);
+                if (data == null)
+                {
+                    CLog.LogError("Error loading Texture: " + CoverPath);
+                    tex = new STexture(-1);
+                    AddFailedCover(command, CoverPath);
+                }
+                else
+                {
+                    tex = CDraw.QuequeTexture(w, h, ref data);
+                    result = AddCover(command, CoverPath, w, h, data);
+                }
+            }
 
-            command.CommandText = "SELECT id, width, height FROM Cover WHERE [Path] = @path";
-            command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
+            command.Dispose();
 
-            SQLiteDataReader reader = null;
+            return result;
+        }
+
+        /// <summary>
+        /// Returns a frame of a video as cover. The frame is extracted once and kept in the cover database.
+        /// </summary>
+        public static bool GetVideoCover(string VideoPath, ref STexture tex, int MaxSize)
+        {
+            if (!File.Exists(VideoPath))
+                return false;
+
+            SQLiteCommand command = GetCoverCommand();
+            bool result = ReadCover(command, VideoPath, ref tex);
+            if (!result && !HasFailedCover(command, VideoPath))
+            {
+                int w, h;
+                byte[] data = DecodeCover(VideoPath, CSettings.VideoCoverTime, MaxSize, out w, out h);
+                if (data != null)
+                {
+                    tex = CDraw.QuequeTexture(w, h, ref data);
+                    result = AddCover(command, VideoPath, w, h, data);
+                }
+                else
+                    AddFailedCover(command, VideoPath);
+            }
+
+            command.Dispose();
+
+            return result;
+        }
+
+        /// <summary>
+        /// Decodes and downscales an image, or the frame of a video at the given time, natively into BGRA.
+        /// AC_OUTPUT_RGBA32 is ffmpeg's native endian RGB32, which is BGRA in memory like the textures.
+        /// </summary>
+        private static byte[] DecodeCover(string FilePath, float Time, int MaxSize, out int w, out int h)
+        {
+            w = 0;
+            h = 0;
+
+            IntPtr image = CAcinerella.ac_get_thumbnail(FilePath, Time, MaxSize, TAc_output_format.AC_OUTPUT_RGBA32);
+            if (image == IntPtr.Zero)
+                return null;
+
+            TAc_image Image = (TAc_image)Marshal.PtrToStructure(image, typeof(TAc_image));
+            byte[] data = new byte[Image.buffer_size];
+            Marshal.Copy(Image.pBuffer, data, 0, data.Length);
+            CAcinerella.ac_free_image(image);
+
+            w = Image.width;
+            h = Image.height;
+            return data;
+        }
+
+        /// <summary>
+        /// Loads a cover in a format ffmpeg does not know through System.Drawing.
+        /// </summary>
+        private static byte[] DecodeCoverBitmap(string CoverPath, int MaxSize, out int w, out int h)
+        {
+            w = MaxSize;
+            h = MaxSize;
+
+            Bitmap origin;
             try
             {
-                reader = command.ExecuteReader();
+                origin = new Bitmap(CoverPath);
             }
             catch (Exception)
             {
-                throw;
+                return null;
             }
 
-            if (reader != null && reader.HasRows)
-            {
-                reader.Read();
-                int id = reader.GetInt32(0);
-                int w = reader.GetInt32(1);
-                int h = reader.GetInt32(2);
-                reader.Close();
+            if (origin.Width >= origin.Height && origin.Width > w)
+                h = (int)Math.Round((float)w / origin.Width * origin.Height);
+            else if (origin.Height > origin.Width && origin.Height > h)
+                w = (int)Math.Round((float)h / origin.Height * origin.Width);
 
-                command.CommandText = "SELECT Data FROM CoverData WHERE CoverID = " + id.ToString();
-                try
-                {
-                    reader = command.ExecuteReader();
-                }
-                catch (Exception)
-                {
-                    throw;
-                }
+            Bitmap bmp = new Bitmap(w, h);
+            Graphics g = Graphics.FromImage(bmp);
+            g.DrawImage(origin, new Rectangle(0, 0, w, h));
+            g.Dispose();
+            origin.Dispose();
 
-                if (reader.HasRows)
-                {
-                    result = true;
-                    reader.Read();
-                    byte[] data = GetBytes(reader);
-                    tex = CDraw.QuequeTexture(w, h, ref data);
-                }
+            byte[] data = new byte[w * h * 4];
+
+            BitmapData bmp_data = bmp.LockBits(new Rectangle(0, 0, bmp.Width, bmp.Height), ImageLockMode.ReadOnly, System.Drawing.Imaging.PixelFormat.Format32bppArgb);
+            Marshal.Copy(bmp_data.Scan0, data, 0, w * h * 4);
+            bmp.UnlockBits(bmp_data);
+            bmp.Dispose();
+
+            return data;
+        }
+
+        /// <summary>
+        /// Decodes and downscales the covers of all given images, or the frames at the given time of all
+        /// given videos, which are not in the cover database yet. They are decoded on all cores at once,
+        /// the textures are created when the covers are used. Files which could not be decoded are
+        /// remembered and not tried again until they are changed.
+        /// </summary>
+        public static void CreateCovers(List<string> FilePaths, float Time, int MaxSize)
+        {
+            SQLiteCommand command = GetCoverCommand();
+
+            List<string> missing = new List<string>();
+            foreach (string path in FilePaths)
+            {
+                if (!HasCover(command, path) && File.Exists(path) && !HasFailedCover(command, path))
+                    missing.Add(path);
             }
-            else
+
+            if (missing.Count > 0)
             {
-                if (reader != null)
-                    reader.Close();
+                //The database is only used by this thread, so the covers are decoded by another one
+                //and stored here as they arrive. The decoding waits while too many covers are queued.
+                string[] files = missing.ToArray();
+                Queue<SDecodedCover> decoded = new Queue<SDecodedCover>();
+                bool finished = false;
 
-                if (_TransactionCover == null)
+                Thread decoder = new Thread(delegate()
                 {
-                    _TransactionCover = _ConnectionCover.BeginTransaction();
-                }
+                    CAcinerella.ac_get_thumbnails(files, Time, MaxSize, TAc_output_format.AC_OUTPUT_RGBA32, 0,
+                        delegate(IntPtr sender, Int32 index, IntPtr image)
+                        {
+                            SDecodedCover cover = new SDecodedCover();
+                            cover.Index = index;
+                            if (image != IntPtr.Zero)
+                            {
+                                TAc_image Image = (TAc_image)Marshal.PtrToStructure(image, typeof(TAc_image));
+                                cover.Data = new byte[Image.buffer_size];
+                                Marshal.Copy(Image.pBuffer, cover.Data, 0, Image.buffer_size);
+                                cover.Width = Image.width;
+                                cover.Height = Image.height;
+                            }
+
+                            lock (decoded)
+                            {
+                                while (decoded.Count >= COVERQUEUESIZE)
+                                    Monitor.Wait(decoded);
+                                decoded.Enqueue(cover);
+                                Monitor.PulseAll(decoded);
+                            }
+                        });
+
+                    lock (decoded)
+                    {
+                        finished = true;
+                        Monitor.PulseAll(decoded);
+                    }
+                });
+                decoder.Name = "CoverDecoder";
+                decoder.IsBackground = true;
+                decoder.Start();
 
-                Bitmap origin;
-                try
+                while (true)
                 {
-                    origin = new Bitmap(CoverPath);
-                }
-                catch (Exception)
-                {
-                    CLog.LogError("Error loading Texture: " + CoverPath);
-                    tex = new STexture(-1);
-
-                    if (reader != null)
+                    SDecodedCover cover;
+                    lock (decoded)
                     {
-                        reader.Close();
-                        reader.Dispose();
+                        while (decoded.Count == 0 && !finished)
+                            Monitor.Wait(decoded);
+                        if (decoded.Count == 0)
+                            break;
+                        cover = decoded.Dequeue();
+                        Monitor.PulseAll(decoded);
                     }
-                    command.Dispose();
 
-                    return false;
+                    //Images ffmpeg does not know may still be loaded by System.Drawing
+                    string path = files[cover.Index];
+                    if (cover.Data == null)
+                        cover.Data = DecodeCoverBitmap(path, MaxSize, out cover.Width, out cover.Height);
+
+                    if (cover.Data != null)
+                        AddCover(command, path, cover.Width, cover.Height, cover.Data);
+                    else
+                        AddFailedCover(command, path);
                 }
 
-                int w = MaxSize;
-                int h = MaxSize;
+                decoder.Join();
+            }
 
-                if (origin.Width >= origin.Height && origin.Width > w)
-                    h = (int)Math.Round((float)w / origin.Width * origin.Height);
-                else if (origin.Height > origin.Width && origin.Height > h)
-                    w = (int)Math.Round((float)h / origin.Height * origin.Width);
+            command.Dispose();
+        }
 
-                Bitmap bmp = new Bitmap(w, h);
-                Graphics g = Graphics.FromImage(bmp);
-                g.DrawImage(origin, new Rectangle(0, 0, w, h));
-                g.Dispose();
+        private static SQLiteCommand GetCoverCommand()
+        {
+            if (_ConnectionCover == null)
+            {
+                _ConnectionCover = new SQLiteConnection();
+                _ConnectionCover.ConnectionString = "Data Source=" + _CoverFilePath;
+                _ConnectionCover.Open();
+            }
 
-                byte[] data = new byte[w * h * 4];
+            return new SQLiteCommand(_ConnectionCover);
+        }
 
-                BitmapData bmp_data = bmp.LockBits(new Rectangle(0, 0, bmp.Width, bmp.Height), ImageLockMode.ReadOnly, System.Drawing.Imaging.PixelFormat.Format32bppArgb);
-                Marshal.Copy(bmp_data.Scan0, data, 0, w * h * 4);
-                bmp.UnlockBits(bmp_data);
-                bmp.Dispose();
+        private static bool HasCover(SQLiteCommand command, string CoverPath)
+        {
+            command.Parameters.Clear();
+            command.CommandText = "SELECT id FROM Cover WHERE [Path] = @path";
+            command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
 
-                tex = CDraw.QuequeTexture(w, h, ref data);
-                
-                command.CommandText = "INSERT INTO Cover (Path, width, height) " +
-                    "VALUES (@path, " + w.ToString() + ", " + h.ToString() + ")";
-                command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
-                command.ExecuteNonQuery();
+            SQLiteDataReader reader = command.ExecuteReader();
+            bool result = reader.HasRows;
+            reader.Close();
+            reader.Dispose();
 
-                command.CommandText = "SELECT id FROM Cover WHERE [Path] = @path";
-                command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
-                reader = null;
-                try
-                {
-                    reader = command.ExecuteReader();
-                }
-                catch (Exception)
-                {
-                    throw;
-                }
+            return result;
+        }
 
-                if (reader != null)
+        //Returns whether decoding the file failed before and the file has not been changed since
+        private static bool HasFailedCover(SQLiteCommand command, string CoverPath)
+        {
+            command.Parameters.Clear();
+            command.CommandText = "SELECT id FROM CoverFailed WHERE [Path] = @path AND Modified = @modified";
+            command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
+            command.Parameters.Add("@modified", System.Data.DbType.Int64, 0).Value = File.GetLastWriteTimeUtc(CoverPath).Ticks;
+
+            SQLiteDataReader reader = command.ExecuteReader();
+            bool result = reader.HasRows;
+            reader.Close();
+            reader.Dispose();
+
+            return result;
+        }
+
+        private static void AddFailedCover(SQLiteCommand command, string CoverPath)
+        {
+            if (_TransactionCover == null)
+            {
+                _TransactionCover = _ConnectionCover.BeginTransaction();
+            }
+
+            command.Parameters.Clear();
+            command.CommandText = "DELETE FROM CoverFailed WHERE [Path] = @path";
+            command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
+            command.ExecuteNonQuery();
+
+            command.CommandText = "INSERT INTO CoverFailed (Path, Modified) VALUES (@path, @modified)";
+            command.Parameters.Add("@modified", System.Data.DbType.Int64, 0).Value = File.GetLastWriteTimeUtc(CoverPath).Ticks;
+            command.ExecuteNonQuery();
+        }
+
+        private static bool ReadCover(SQLiteCommand command, string CoverPath, ref STexture tex)
+        {
+            bool result = false;
+
+            command.Parameters.Clear();
+            command.CommandText = "SELECT id, width, height FROM Cover WHERE [Path] = @path";
+            command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
+
+            SQLiteDataReader reader = command.ExecuteReader();
+            if (reader.HasRows)
+            {
+                reader.Read();
+                int id = reader.GetInt32(0);
+                int w = reader.GetInt32(1);
+                int h = reader.GetInt32(2);
+                reader.Close();
+
+                command.CommandText = "SELECT Data FROM CoverData WHERE CoverID = " + id.ToString();
+                reader = command.ExecuteReader();
+
+                if (reader.HasRows)
                 {
-                    reader.Read();
-                    int id = reader.GetInt32(0);
-                    reader.Close();
-                    command.CommandText = "INSERT INTO CoverData (CoverID, Data) " +
-                    "VALUES ('" + id.ToString() + "', @data)";
-                    command.Parameters.Add("@data", System.Data.DbType.Binary, 20).Value = data;
-                    command.ExecuteReader();
                     result = true;
+                    reader.Read();
+                    byte[] data = GetBytes(reader);
+                    tex = CDraw.QuequeTexture(w, h, ref data);
                 }
             }
 
-            if (reader != null)
+            reader.Close();
+            reader.Dispose();
+
+            return result;
+        }
+
+        private static bool AddCover(SQLiteCommand command, string CoverPath, int w, int h, byte[] data)
+        {
+            if (_TransactionCover == null)
             {
+                _TransactionCover = _ConnectionCover.BeginTransaction();
+            }
+
+            command.Parameters.Clear();
+            command.CommandText = "INSERT INTO Cover (Path, width, height) " +
+                "VALUES (@path, " + w.ToString() + ", " + h.ToString() + ")";
+            command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
+            command.ExecuteNonQuery();
+
+            command.CommandText = "SELECT id FROM Cover WHERE [Path] = @path";
+            command.Parameters.Add("@path", System.Data.DbType.String, 0).Value = CoverPath;
+            SQLiteDataReader reader = command.ExecuteReader();
+
+            bool result = false;
+            if (reader.Read())
+            {
+                int id = reader.GetInt32(0);
                 reader.Close();
-                reader.Dispose();
+                command.CommandText = "INSERT INTO CoverData (CoverID, Data) " +
+                "VALUES ('" + id.ToString() + "', @data)";
+                command.Parameters.Add("@data", System.Data.DbType.Binary, 20).Value = data;
+                command.ExecuteNonQuery();
+                result = true;
             }
-            command.Dispose();
+
+            reader.Close();
+            reader.Dispose();
 
             return result;
         }
@@ -1186,9 +1395,12 @@ namespace Vocaluxe.Base
             {
                 reader.Read();
 
-                if (reader.GetInt32(0) < CSettings.iDatabaseHighscoreVersion)
+                int version = reader.GetInt32(0);
+                if (version < CSettings.iDatabaseCoverVersion)
                 {
                     // update database
+                    reader.Close();
+                    UpdateCoverDB(command, version);
                 }
             }
 
@@ -1206,6 +1418,22 @@ namespace Vocaluxe.Base
             return true;
         }
 
+        //Files which could not be decoded, with the time they were last written to
+        private const string CREATECOVERFAILED = "CREATE TABLE IF NOT EXISTS CoverFailed ( id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, " +
+            "Path TEXT NOT NULL, Modified INTEGER NOT NULL);";
+
+        private static void UpdateCoverDB(SQLiteCommand command, int Version)
+        {
+            if (Version < 2)
+            {
+                command.CommandText = CREATECOVERFAILED;
+                command.ExecuteNonQuery();
+            }
+
+            command.CommandText = "UPDATE Version SET Value = " + CSettings.iDatabaseCoverVersion.ToString();
+            command.ExecuteNonQuery();
+        }
+
         private static void CreateCoverDB()
         {
             SQLiteConnection connection = new SQLiteConnection();
@@ -1237,6 +1465,9 @@ namespace Vocaluxe.Base
                 "CoverID INTEGER NOT NULL, Data BLOB NOT NULL);";
             command.ExecuteNonQuery();
 
+            command.CommandText = CREATECOVERFAILED;
+            command.ExecuteNonQuery();
+
             command.Dispose();
             connection.Close();
             connection.Dispose();
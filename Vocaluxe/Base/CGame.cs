@@ -242,10 +242,7 @@ namespace Vocaluxe.Base
             _MidBeatD = -0.5f + GetBeatFromTime(Time, song.BPM, song.Gap + CConfig.MicDelay/1000f);
             _CurrentBeatD = (int)Math.Floor(_MidBeatD);
 
-            for (int p = 0; p < _NumPlayer; p++)
-            {
-                CSound.AnalyzeBuffer(p);
-            }
+            CSound.AnalyzeBuffers(_NumPlayer);
 
             if (_OldBeatD >= _CurrentBeatD)
                 return;
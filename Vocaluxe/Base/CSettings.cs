@@ -50,7 +50,7 @@ namespace Vocaluxe.Base
         public const int iBuild = 67;             // Increase on every published version! Never Reset!
 
         public const int iDatabaseHighscoreVersion = 1;
-        public const int iDatabaseCoverVersion = 1;
+        public const int iDatabaseCoverVersion = 2;
         public const int iDatabaseCreditsRessourcesVersion = 1;
         
 
@@ -81,6 +81,9 @@ namespace Vocaluxe.Base
 
         public const string sSoundT440 = "440Hz.mp3";
 
+        //Time in seconds of the video frame shown as cover of songs without a cover
+        public const float VideoCoverTime = 30f;
+
         public const string sFolderCover = "Cover";
         public const string sFolderGraphics = "Graphics";
         public const string sFolderFonts = "Fonts";
@@ -94,6 +97,7 @@ namespace Vocaluxe.Base
         public const string sFolderLanguages = "Languages";
         public const string sFolderScreenshots = "Screenshots";
         public const string sFolderBackgroundMusic = "BackgroundMusic";
+        public const string sFolderMediaInfoCache = "MediaInfoCache";
 
         //public const String[] ToneStrings = new String[]{ "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
         public const int ToneMin = -36;
@@ -104,6 +108,7 @@ namespace Vocaluxe.Base
         public const float MouseMoveOffTime = 3f;
         
         public const int MaxNumPlayer = 6;
+        public const int MicAnalysisSamples = 8192;          // samples of each pitch analysis, ~186ms at 44.1kHz
         public const int MaxScore = 10000;
         public const int LinebonusScore = 1000;
         public const int MinScoreForDB = 100;
@@ -179,6 +184,7 @@ namespace Vocaluxe.Base
             Folders.Add(sFolderScreenshots);
             Folders.Add(sFolderBackgroundMusic);
             Folders.Add(sFolderSounds);
+            Folders.Add(sFolderMediaInfoCache);
 
             foreach (string folder in Folders)
             {
@@ -3,12 +3,14 @@ using System.Collections.Generic;
 using System.Diagnostics;
 using System.Globalization;
 using System.IO;
+using System.Runtime.InteropServices;
 using System.Text;
 using System.Text.RegularExpressions;
 using System.Threading;
 
 using Vocaluxe.Lib.Draw;
 using Vocaluxe.Lib.Song;
+using Vocaluxe.Lib.Video.Acinerella;
 using Vocaluxe.Menu;
 
 namespace Vocaluxe.Base
@@ -918,16 +920,26 @@ namespace Vocaluxe.Base
             CLog.StopBenchmark(2, "List Songs");
 
             CLog.StartBenchmark(2, "Read TXTs");
+            List<CSong> songs = new List<CSong>();
             foreach (string file in files)
             {
                 CSong Song = new CSong();
                 if (Song.ReadTXTSong(file))
+                    songs.Add(Song);
+            }
+            CLog.StopBenchmark(2, "Read TXTs");
+
+            CLog.StartBenchmark(2, "Scan Media Files");
+            bool[] playable = ScanMediaFiles(songs);
+            for (int i = 0; i < songs.Count; i++)
+            {
+                if (playable[i])
                 {
-                    Song.ID = _Songs.Count;
-                    _Songs.Add(Song);
+                    songs[i].ID = _Songs.Count;
+                    _Songs.Add(songs[i]);
                 }
             }
-            CLog.StopBenchmark(2, "Read TXTs");
+            CLog.StopBenchmark(2, "Scan Media Files");
 
             CLog.StartBenchmark(2, "Sort Songs");
             Sort(CConfig.SongSorting);
@@ -938,6 +950,7 @@ namespace Vocaluxe.Base
             if (CConfig.Renderer != ERenderer.TR_CONFIG_SOFTWARE && CConfig.CoverLoading == ECoverLoading.TR_CONFIG_COVERLOADING_ATSTART)
             {
                 CLog.StartBenchmark(2, "Load Cover");
+                CreateCovers();
                 for (int i = 0; i < _Songs.Count; i++)
                 {
                     CSong song = _Songs[i];
@@ -955,6 +968,63 @@ namespace Vocaluxe.Base
             CLog.StopBenchmark(1, "Load Songs ");
         }
 
+        /// <summary>
+        /// Checks the audio and video files of all songs at once on all cores, so songs which can not
+        /// be played are left out instead of failing when they are started. Videos which can not be
+        /// decoded are removed from their songs.
+        /// </summary>
+        private static bool[] ScanMediaFiles(List<CSong> songs)
+        {
+            //The audio files come first, followed by the videos of the songs which have one
+            List<string> files = new List<string>();
+            List<int> videos = new List<int>();
+            for (int i = 0; i < songs.Count; i++)
+                files.Add(Path.Combine(songs[i].Folder, songs[i].MP3FileName));
+            for (int i = 0; i < songs.Count; i++)
+            {
+                if (songs[i].VideoFileName != String.Empty)
+                {
+                    files.Add(Path.Combine(songs[i].Folder, songs[i].VideoFileName));
+                    videos.Add(i);
+                }
+            }
+
+            bool[] playable = new bool[songs.Count];
+            bool[] videoplayable = new bool[videos.Count];
+            CAcinerella.ac_scan_files(files.ToArray(), 0, delegate(IntPtr sender, IntPtr result)
+            {
+                //Only the needed stream counts, e.g. the cover picture of a MP3 file does not
+                TAc_scan_result Result = (TAc_scan_result)Marshal.PtrToStructure(result, typeof(TAc_scan_result));
+                if (Result.index < songs.Count)
+                {
+                    playable[Result.index] = Result.error == TAc_scan_error.AC_SCAN_OK && Result.audio_decoder;
+                    if (!playable[Result.index])
+                        CLog.LogError("Can't play audio file " + files[Result.index] + " (" + _ScanError(Result, Result.audio_codec) + ")");
+                }
+                else
+                {
+                    int video = Result.index - songs.Count;
+                    videoplayable[video] = Result.error == TAc_scan_error.AC_SCAN_OK && Result.video_decoder;
+                    if (!videoplayable[video])
+                        CLog.LogError("Can't play video file " + files[Result.index] + " (" + _ScanError(Result, Result.video_codec) + ")");
+                }
+            });
+
+            for (int i = 0; i < videos.Count; i++)
+            {
+                if (!videoplayable[i])
+                    songs[videos[i]].VideoFileName = String.Empty;
+            }
+            return playable;
+        }
+
+        private static string _ScanError(TAc_scan_result Result, string Codec)
+        {
+            if (Result.error == TAc_scan_error.AC_SCAN_OK)
+                return Codec == String.Empty ? "stream missing" : "no decoder for " + Codec;
+            return Result.error.ToString();
+        }
+
         public static void LoadCover(long WaitTime, int NumLoads)
         {
             if (CConfig.Renderer == ERenderer.TR_CONFIG_SOFTWARE)
@@ -1010,8 +1080,31 @@ namespace Vocaluxe.Base
              * */
         }
 
+        /// <summary>
+        /// Decodes the covers, or the video frames shown as cover of songs without one, which are not
+        /// in the cover database yet at once on all cores, instead of one by one while the covers are loaded.
+        /// </summary>
+        private static void CreateCovers()
+        {
+            List<string> covers = new List<string>();
+            List<string> videos = new List<string>();
+            foreach (CSong song in _Songs)
+            {
+                if (song.CoverFileName != String.Empty)
+                    covers.Add(Path.Combine(song.Folder, song.CoverFileName));
+                else if (song.VideoFileName != String.Empty)
+                    videos.Add(Path.Combine(song.Folder, song.VideoFileName));
+            }
+
+            if (covers.Count > 0)
+                CDataBase.CreateCovers(covers, 0f, CConfig.CoverSize);
+            if (videos.Count > 0)
+                CDataBase.CreateCovers(videos, CSettings.VideoCoverTime, CConfig.CoverSize);
+        }
+
         private static void _LoadCover()
         {
+            CreateCovers();
             for (int i = 0; i < _Songs.Count; i++)
             {
                 CSong song = _Songs[i];
@@ -3,8 +3,11 @@ using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
 using System.Text;
+using System.Threading;
 
 using Vocaluxe.Lib.Sound;
+using Vocaluxe.Lib.Sound.Decoder;
+using Vocaluxe.Lib.Video.Acinerella;
 
 namespace Vocaluxe.Base
 {
@@ -63,6 +66,19 @@ namespace Vocaluxe.Base
             return _Playback.Load(Media, Prescan);
         }
 
+        /// <summary>
+        /// Opens a file in the background, so loading it later does not wait for the probing
+        /// </summary>
+        public static void Prefetch(string Media)
+        {
+            CAudioDecoderFFmpeg.Prefetch(Media);
+        }
+
+        public static void ClearPrefetches()
+        {
+            CAudioDecoderFFmpeg.ClearPrefetches();
+        }
+
         public static void Close(int Stream)
         {
             _Playback.Close(Stream);
@@ -108,6 +124,11 @@ namespace Vocaluxe.Base
             _Playback.SetStreamVolume(Stream, Volume);
         }
 
+        public static void SetPriority(int Stream, EAudioPriority Priority)
+        {
+            _Playback.SetPriority(Stream, Priority);
+        }
+
 
         public static float GetLength(int Stream)
         {
@@ -213,9 +234,9 @@ namespace Vocaluxe.Base
             return _Record.Stop();
         }
 
-        public static void AnalyzeBuffer(int Player)
+        public static void AnalyzeBuffers(int NumPlayer)
         {
-            _Record.AnalyzeBuffer(Player);
+            _Record.AnalyzeBuffers(NumPlayer);
         }
 
         public static int RecordGetToneAbs(int Player)
@@ -299,24 +320,58 @@ namespace Vocaluxe.Base
     {
         private const double _BaseToneFreq = 65.4064;
         private const int _NumHalfTones = 47;
+        private const int _DefaultAnalysisSamples = 4096;
+        private const int _RingWindows = 4;                 // the ring holds at least this many analysis windows
+
+        // samples in one period of each halftone, the lags the autocorrelation compares
+        private static int[] _SamplesPerPeriod = CreateSamplesPerPeriod();
+
+        // all windows of one AnalyzeBuffers call follow each other in _BatchSamples, so the
+        // autocorrelation of all players is done with one native call
+        private static Int16[] _BatchSamples = new Int16[0];
+        private static double[] _BatchWeights = new double[0];
+        private static Object _BatchLock = new Object();
+        private static bool _NativeAnalysis = true;
 
         private float[] _ToneWeigth;
-        private Int16[] _AnalysisBuffer = new Int16[4096];
+        private int _AnalysisSamples;
         private Object _AnalysisBufferLock = new Object();
 
         private bool _ToneValid = false;
         private int _Tone = 0;
         private int _ToneAbs = 0;
         private double _MaxVolume = 0.0;
-        private bool _NewSamples;
 
-        private MemoryStream _Stream;                       // full buffer
+        // single producer/single consumer ring of the latest samples. Only the capture thread
+        // writes _Ring and _WritePos, the analyzer only reads them and keeps its own position,
+        // so neither side ever waits for the other. Old samples are simply overwritten.
+        private Int16[] _Ring;
+        private int _RingMask;
+        private long _WritePos;                             // samples written since Reset, published by the capture thread
+        private long _AnalyzedPos;                          // _WritePos of the last analysis, analyzer only
+        private Stream _RecordSink;
 
         public CBuffer()
+            : this(_DefaultAnalysisSamples)
+        {
+        }
+
+        /// <summary>
+        /// Creates a buffer which analyzes the given number of the latest samples. Larger windows
+        /// compare more periods of low tones.
+        /// </summary>
+        public CBuffer(int AnalysisSamples)
         {
+            _AnalysisSamples = AnalysisSamples;
             _ToneWeigth = new float[_NumHalfTones];
-            _Stream = new MemoryStream();
-            _NewSamples = false;
+
+            int RingSize = 1;
+            while (RingSize < AnalysisSamples * _RingWindows)
+                RingSize <<= 1;
+            _Ring = new Int16[RingSize];
+            _RingMask = RingSize - 1;
+            _WritePos = 0L;
+            _AnalyzedPos = 0L;
         }
 
         public int NumHalfTones
@@ -375,14 +430,14 @@ namespace Vocaluxe.Base
             }
         }
 
-        public long Length
-        {
-            get { return _Stream.Length; }
-        }
-
-        public byte[] Buffer
+        /// <summary>
+        /// Optional stream every captured buffer is written to, e.g. to record the whole song.
+        /// It is written on the capture thread, so it should be fast (buffered file). Null by default.
+        /// </summary>
+        public Stream RecordSink
         {
-            get { return _Stream.ToArray(); }
+            get { return _RecordSink; }
+            set { _RecordSink = value; }
         }
 
         public float[] ToneWeigth
@@ -396,21 +451,25 @@ namespace Vocaluxe.Base
             }
         }
 
+        /// <summary>
+        /// Clears all samples and results. Must not be called while the capture stream is running.
+        /// </summary>
         public void Reset()
         {
-            _Stream.SetLength(0L);
-            _AnalysisBuffer = new Int16[_AnalysisBuffer.Length];
-            _ToneValid = false;
-            _ToneAbs = 0;
-            _Tone = 0;
-            _NewSamples = false;
-        }
-
-        public void Add(byte[] bytes)
-        {
-            _Stream.Write(bytes, 0, bytes.Length);
+            lock (_AnalysisBufferLock)
+            {
+                Array.Clear(_Ring, 0, _Ring.Length);
+                Interlocked.Exchange(ref _WritePos, 0L);
+                _AnalyzedPos = 0L;
+                _ToneValid = false;
+                _ToneAbs = 0;
+                _Tone = 0;
+            }
         }
 
+        /// <summary>
+        /// Adds captured 16 bit samples. Called by the capture thread only, never blocks.
+        /// </summary>
         public void ProcessNewBuffer(byte[] buffer)
         {
 
@@ -421,65 +480,163 @@ namespace Vocaluxe.Base
             //if (assigned(fVoiceStream)) then
             //fVoiceStream.WriteData(Buffer, BufferSize);
 
-            lock (_AnalysisBufferLock)
-            {
-                Add(buffer);
-                _NewSamples = true;
-            }
+            Stream Sink = _RecordSink;
+            if (Sink != null)
+                Sink.Write(buffer, 0, buffer.Length);
+
+            int Samples = buffer.Length / 2;
+            if (Samples > _Ring.Length)
+                Samples = _Ring.Length;
+            int SrcOffset = buffer.Length - Samples * 2;    // keep the newest samples only
+
+            // the samples are little endian 16 bit, like Int16 in memory
+            long WritePos = _WritePos;
+            int Start = (int)(WritePos & _RingMask);
+            int First = Math.Min(Samples, _Ring.Length - Start);
+            System.Buffer.BlockCopy(buffer, SrcOffset, _Ring, Start * 2, First * 2);
+            if (First < Samples)
+                System.Buffer.BlockCopy(buffer, SrcOffset + First * 2, _Ring, 0, (Samples - First) * 2);
+
+            // publish the samples after they are written
+            Interlocked.Exchange(ref _WritePos, WritePos + Samples);
         }
 
-        public void AnalyzeBuffer()
+        /// <summary>
+        /// Detects the pitch and volume of the newest samples of the first Count buffers. The
+        /// windows of all buffers are analyzed together with one call of the native autocorrelation.
+        /// </summary>
+        public static void AnalyzeBuffers(CBuffer[] Buffers, int Count)
         {
-            if (!_NewSamples)
-                return;
+            List<CBuffer> Pending = new List<CBuffer>(Count);
+            for (int i = 0; i < Count; i++)
+            {
+                Pending.Add(Buffers[i]);
+            }
 
-            lock (_AnalysisBufferLock)
+            lock (_BatchLock)
             {
-                int len = _AnalysisBuffer.Length * 2;
-                if (_Stream.Length >= len)
+                // one batch for each window size
+                while (Pending.Count > 0)
                 {
-                    byte[] buf = new byte[len];
-                    _Stream.Position -= len;
-                    _Stream.Read(buf, 0, len);
+                    int Samples = Pending[0]._AnalysisSamples;
+                    List<CBuffer> Batch = Pending.FindAll(delegate(CBuffer b) { return b._AnalysisSamples == Samples; });
+                    Pending.RemoveAll(delegate(CBuffer b) { return b._AnalysisSamples == Samples; });
+
+                    if (_BatchSamples.Length < Batch.Count * Samples)
+                        _BatchSamples = new Int16[Batch.Count * Samples];
+                    if (_BatchWeights.Length < Batch.Count * _NumHalfTones)
+                        _BatchWeights = new double[Batch.Count * _NumHalfTones];
+
+                    // buffers without new samples are left out
+                    List<CBuffer> Ready = new List<CBuffer>(Batch.Count);
+                    foreach (CBuffer b in Batch)
+                    {
+                        if (b.CopyWindow(_BatchSamples, Ready.Count * Samples))
+                            Ready.Add(b);
+                    }
+                    if (Ready.Count == 0)
+                        continue;
 
-                    byte[] b = new byte[2];
-                    for (int i = 0; i < _AnalysisBuffer.Length; i++)
+                    try
+                    {
+                        AnalyzeByAutocorrelation(_BatchSamples, Samples, Ready.Count, _BatchWeights);
+                        for (int i = 0; i < Ready.Count; i++)
+                        {
+                            Ready[i].AnalyzeWindow(_BatchSamples, i * Samples, _BatchWeights, i * _NumHalfTones);
+                        }
+                    }
+                    catch (Exception)
                     {
-                        b[0] = buf[i * 2];
-                        b[1] = buf[i * 2 + 1];
 
-                        _AnalysisBuffer[i] = BitConverter.ToInt16(b, 0);
                     }
                 }
-                _NewSamples = false;
             }
+        }
+
+        // Copies the newest window to Target, returns false if there are no new samples
+        private bool CopyWindow(Int16[] Target, int Offset)
+        {
+            long WritePos = Interlocked.Read(ref _WritePos);
+            if (WritePos == _AnalyzedPos)
+                return false;
 
-            try
+            int Samples = _AnalysisSamples;
+            if (WritePos < Samples)
+                return false;
+
+            lock (_AnalysisBufferLock)
             {
-                // find maximum volume
-                _MaxVolume = 0;
-                for (int i = 0; i < _AnalysisBuffer.Length / 4; i++)
-                {
-                    float Volume = Math.Abs((float)_AnalysisBuffer[i]) / (float)Int16.MaxValue;
-                    if (Volume > MaxVolume)
-                        _MaxVolume = Volume;
-                }
+                int Start = (int)((WritePos - Samples) & _RingMask);
+                int First = Math.Min(Samples, _Ring.Length - Start);
+                Array.Copy(_Ring, Start, Target, Offset, First);
+                if (First < Samples)
+                    Array.Copy(_Ring, 0, Target, Offset + First, Samples - First);
+
+                // the capture thread overwrote the window while it was copied (analysis stalled
+                // for several windows), try again with the newest samples next time
+                if (Interlocked.Read(ref _WritePos) - (WritePos - Samples) > _Ring.Length)
+                    return false;
+
+                _AnalyzedPos = WritePos;
+            }
+            return true;
+        }
 
-                if (_MaxVolume >= 0.02f)
-                    AnalyzeByAutocorrelation(true);
-                else
-                    AnalyzeByAutocorrelation(false);
+        private static int[] CreateSamplesPerPeriod()
+        {
+            const double HalftoneBase = 1.05946309436; // 2^(1/12) -> HalftoneBase^12 = 2 (one octave)
 
+            int[] SamplesPerPeriod = new int[_NumHalfTones];
+            for (int ToneIndex = 0; ToneIndex < _NumHalfTones; ToneIndex++)
+            {
+                double Freq = _BaseToneFreq * Math.Pow(HalftoneBase, ToneIndex);
+                SamplesPerPeriod[ToneIndex] = (int)Math.Round(44100.0 / Freq);
             }
-            catch (Exception)
+            return SamplesPerPeriod;
+        }
+
+        // Computes the weights of all halftones for Count windows of Samples samples, the weights
+        // of each window follow each other in Weights
+        private static void AnalyzeByAutocorrelation(Int16[] Windows, int Samples, int Count, double[] Weights)
+        {
+            if (_NativeAnalysis)
             {
+                try
+                {
+                    CAcinerella.ac_analyze_pitch(Windows, Samples, Count, _SamplesPerPeriod, Weights);
+                    return;
+                }
+                catch (DllNotFoundException)
+                {
+                    _NativeAnalysis = false;
+                }
+                catch (EntryPointNotFoundException)
+                {
+                    _NativeAnalysis = false;
+                }
+            }
 
+            for (int i = 0; i < Count; i++)
+            {
+                for (int ToneIndex = 0; ToneIndex < _NumHalfTones; ToneIndex++)
+                {
+                    Weights[i * _NumHalfTones + ToneIndex] = AnalyzeAutocorrelation(Windows, i * Samples, Samples, _SamplesPerPeriod[ToneIndex]);
+                }
             }
         }
 
-        private void AnalyzeByAutocorrelation(bool valid)
+        private void AnalyzeWindow(Int16[] Window, int Offset, double[] Weights, int WeightOffset)
         {
-            const double HalftoneBase = 1.05946309436; // 2^(1/12) -> HalftoneBase^12 = 2 (one octave)
+            // find maximum volume
+            _MaxVolume = 0;
+            for (int i = Offset; i < Offset + _AnalysisSamples / 4; i++)
+            {
+                float Volume = Math.Abs((float)Window[i]) / (float)Int16.MaxValue;
+                if (Volume > _MaxVolume)
+                    _MaxVolume = Volume;
+            }
+
+            bool valid = _MaxVolume >= 0.02f;
 
             // prepare to analyze
             double MaxWeight = -1.0;
@@ -488,14 +645,9 @@ namespace Vocaluxe.Base
             float[] Weigth = new float[_NumHalfTones];
 
             // analyze halftones
-            // Note: at the lowest tone (~65Hz) and a buffer-size of 4096
-            // at 44.1 (or 48kHz) only 6 (or 5) samples are compared, this might be
-            // too few samples -> use a bigger buffer-size
-
             for (int ToneIndex = 0; ToneIndex < _NumHalfTones; ToneIndex++)
             {
-                double CurFreq = _BaseToneFreq * Math.Pow(HalftoneBase, ToneIndex);
-                double CurWeight = AnalyzeAutocorrelationFreq(CurFreq);
+                double CurWeight = Weights[WeightOffset + ToneIndex];
 
                 if (CurWeight > MaxWeight)
                 {
@@ -524,26 +676,22 @@ namespace Vocaluxe.Base
                 _ToneValid = false;
         }
 
-        private double AnalyzeAutocorrelationFreq(double Freq)
+        // The managed version of ac_analyze_pitch, used if the native library is missing
+        private static double AnalyzeAutocorrelation(Int16[] Samples, int Offset, int Length, int SamplesPerPeriod)
         {
-            int SampleIndex = 0;                                            // index of sample to analyze
-            int SamplesPerPeriod = (int)Math.Round(44100.0 / Freq);         // samples in one period
-            int CorrelatingSampleIndex = SampleIndex + SamplesPerPeriod;    // index of sample one period ahead
-
-            double AccumDist = 0.0;                                         // accumulated distances
+            int Count = Length - SamplesPerPeriod;                          // number of correlating sample pairs
 
-            // compare correlating samples
-            while (CorrelatingSampleIndex < _AnalysisBuffer.Length)
+            // compare each sample with the corresponding sample one period ahead. The distances
+            // are summed up exactly as integers and normalized once
+            // (distance 0=equal .. 1=totally different, correlation: 1-dist)
+            long AccumDist = 0;
+            for (int SampleIndex = Offset; SampleIndex < Offset + Count; SampleIndex++)
             {
-                // calc distance (correlation: 1-dist) to corresponding sample in next period
-                // distance (0=equal .. 1=totally different) between correlated samples
-                double Dist = Math.Abs((double)_AnalysisBuffer[SampleIndex] - _AnalysisBuffer[CorrelatingSampleIndex]) / (double)Int16.MaxValue;
-                AccumDist += Dist;
-                SampleIndex++;
-                CorrelatingSampleIndex++;
+                int Dist = Samples[SampleIndex] - Samples[SampleIndex + SamplesPerPeriod];
+                AccumDist += Dist < 0 ? -Dist : Dist;
             }
 
-            return 1 - AccumDist / _AnalysisBuffer.Length;
+            return 1 - (double)AccumDist / Int16.MaxValue / Length;
         }
     }
 
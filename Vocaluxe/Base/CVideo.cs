@@ -58,6 +58,29 @@ namespace Vocaluxe.Base
             return _VideoDecoder.Close(StreamID);
         }
 
+        /// <summary>
+        /// Opens a video in the background and seeks it to the given position, so a later
+        /// VdLoad and VdSkip of the same file shows the first frame right away
+        /// </summary>
+        public static void VdPrefetch(string VideoFileName, float Start, float Gap)
+        {
+            _VideoDecoder.Prefetch(VideoFileName, Start, Gap);
+        }
+
+        public static void VdClearPrefetches()
+        {
+            _VideoDecoder.ClearPrefetches();
+        }
+
+        /// <summary>
+        /// Marks the prefetches as needed, a shown video which is prefetched is kept and sought
+        /// when it is closed instead of being freed
+        /// </summary>
+        public static void VdKeepPrefetches()
+        {
+            _VideoDecoder.KeepPrefetches();
+        }
+
         public static float VdGetLength(int StreamID)
         {
             return _VideoDecoder.GetLength(StreamID);
@@ -88,11 +111,21 @@ namespace Vocaluxe.Base
             _VideoDecoder.Resume(StreamID);
         }
 
+        public static void VdSetPriority(int StreamID, EVideoPriority Priority)
+        {
+            _VideoDecoder.SetPriority(StreamID, Priority);
+        }
+
         public static bool VdFinished(int StreamID)
         {
             return _VideoDecoder.Finished(StreamID);
         }
 
+        public static string[] VdGetStats()
+        {
+            return _VideoDecoder.GetStats();
+        }
+
         #endregion Interface
 
         #endregion VideoDecoder
@@ -1053,10 +1053,23 @@ namespace Vocaluxe.Lib.Draw
         /// <returns>True if succeeded</returns>
         public bool UpdateTexture(ref STexture Texture, IntPtr Data)
         {
-            byte[] PointerData = new Byte[4 * (int)Texture.width * (int)Texture.height];
-            Marshal.Copy(Data, PointerData, 0, PointerData.Length);
+            if ((Texture.index >= 0) && (_Textures.Count > 0) && _TextureExists(ref Texture))
+            {
+                int LineSize = 4 * (int)Texture.width;
+                DataRectangle rect = _D3DTextures[Texture.index].LockRectangle(0, LockFlags.None);
+                for (int i = 0; i < (int)Texture.height; i++)
+                {
+                    rect.Data.Position = i * rect.Pitch;
+                    rect.Data.WriteRange(new IntPtr(Data.ToInt64() + i * LineSize), LineSize);
+                }
+                _D3DTextures[Texture.index].UnlockRectangle(0);
 
-            return UpdateTexture(ref Texture, ref PointerData);
+                Texture.height_ratio = Texture.height / NextPowerOfTwo(Texture.height);
+                Texture.width_ratio = Texture.width / NextPowerOfTwo(Texture.width);
+                return true;
+            }
+            else
+                return false;
         }
 
         /// <summary>
@@ -955,14 +955,10 @@ namespace Vocaluxe.Lib.Draw
                     try
                     {
                         GL.BindBuffer(BufferTarget.PixelUnpackBuffer, Texture.PBO);
-                                
-                        IntPtr Buffer = GL.MapBuffer(BufferTarget.PixelUnpackBuffer, BufferAccess.WriteOnly);
-                        byte[] d = new byte[(int)Texture.height * (int)Texture.width * 4];
 
-                        Marshal.Copy(Data, d, 0, (int)Texture.height * (int)Texture.width * 4);
-                        Marshal.Copy(d, 0, Buffer, (int)Texture.height * (int)Texture.width * 4);
-                                
-                        GL.UnmapBuffer(BufferTarget.PixelUnpackBuffer);
+                        //The driver copies the data straight into the buffer
+                        GL.BufferSubData(BufferTarget.PixelUnpackBuffer, IntPtr.Zero,
+                            (IntPtr)((int)Texture.height * (int)Texture.width * 4), Data);
 
                         GL.BindTexture(TextureTarget.Texture2D, Texture.ID);
                         GL.TexSubImage2D(TextureTarget.Texture2D, 0, 0, 0, (int)Texture.width, (int)Texture.height,
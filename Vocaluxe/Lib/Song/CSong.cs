@@ -63,6 +63,12 @@ namespace Vocaluxe.Lib.Song
                         if (!CDataBase.GetCover(Path.Combine(this.Folder, this.CoverFileName), ref _CoverTextureSmall, CConfig.CoverSize))
                             _CoverTextureSmall = CCover.NoCover;
                     }
+                    else if (this.VideoFileName != String.Empty)
+                    {
+                        //Songs without a cover show a frame of their video
+                        if (!CDataBase.GetVideoCover(Path.Combine(this.Folder, this.VideoFileName), ref _CoverTextureSmall, CConfig.CoverSize))
+                            _CoverTextureSmall = CCover.NoCover;
+                    }
                     else
                         _CoverTextureSmall = CCover.NoCover;
 
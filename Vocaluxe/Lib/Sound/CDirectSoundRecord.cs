@@ -21,7 +21,7 @@ namespace Vocaluxe.Lib.Sound
             _Buffer = new CBuffer[CSettings.MaxNumPlayer];
             for (int i = 0; i < _Buffer.Length; i++)
             {
-                _Buffer[i] = new CBuffer();
+                _Buffer[i] = new CBuffer(CSettings.MicAnalysisSamples);
             }
 
             Init();
@@ -75,7 +75,6 @@ namespace Vocaluxe.Lib.Sound
                 }
                 _initialized = false;
             }
-            //System.IO.File.WriteAllBytes("test0.raw", _Buffer[0].Buffer);
         }
 
         public bool Start(SRecordDevice[] DeviceConfig)
@@ -134,12 +133,12 @@ namespace Vocaluxe.Lib.Sound
             }
             return true;
         }
-        public void AnalyzeBuffer(int Player)
+        public void AnalyzeBuffers(int NumPlayer)
         {
             if (!_initialized)
                 return;
 
-            _Buffer[Player].AnalyzeBuffer();
+            CBuffer.AnalyzeBuffers(_Buffer, Math.Min(NumPlayer, _Buffer.Length));
         }
 
         public int GetToneAbs(int Player)
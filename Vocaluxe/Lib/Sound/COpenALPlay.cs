@@ -234,6 +234,21 @@ namespace Vocaluxe.Lib.Sound
             }
         }
 
+        public void SetPriority(int Stream, EAudioPriority Priority)
+        {
+            if (_Initialized)
+            {
+                lock (MutexDecoder)
+                {
+                    if (AlreadyAdded(Stream))
+                    {
+                        _Decoder[GetStreamIndex(Stream)].Priority = Priority;
+                    }
+                }
+
+            }
+        }
+
         public float GetLength(int Stream)
         {
             if (_Initialized)
@@ -483,6 +498,25 @@ namespace Vocaluxe.Lib.Sound
             }
         }
 
+        /// <summary>
+        /// The song must not wait for the video decoding, which runs at normal priority, so its
+        /// thread runs above it. Previews and background music stay at normal priority.
+        /// </summary>
+        public EAudioPriority Priority
+        {
+            set
+            {
+                try
+                {
+                    _DecoderThread.Priority = value == EAudioPriority.Song ? ThreadPriority.AboveNormal : ThreadPriority.Normal;
+                }
+                catch (ThreadStateException)
+                {
+                    //the stream has already been closed
+                }
+            }
+        }
+
         public float Volume
         {
             get { return _Volume * 100f; }
@@ -624,9 +658,8 @@ namespace Vocaluxe.Lib.Sound
             if (stream.handle != 0)
             {
                 _FileOpened = true;
-                _data = new RingBuffer(BUFSIZE);
+                _data = new RingBuffer(BUFSIZE - BUFSIZE % _ByteCount);
                 _NoMoreData = false;
-                _DecoderThread.Priority = ThreadPriority.Normal;
                 _DecoderThread.Name = Path.GetFileName(FileName);
                 _DecoderThread.Start();
 
@@ -659,7 +692,7 @@ namespace Vocaluxe.Lib.Sound
 
             lock (MutexData)
             {
-                _data = new RingBuffer(BUFSIZE);
+                _data = new RingBuffer(BUFSIZE - BUFSIZE % _ByteCount);
                 _NoMoreData = false;
             }
         }
@@ -711,21 +744,32 @@ namespace Vocaluxe.Lib.Sound
                 return;
 
             float Timecode;
-            byte[] Buffer;
+            RingBuffer Data;
+            IntPtr Buffer;
+            int Size;
 
-            bool DoIt = false;
             lock (MutexData)
             {
-                if (BUFSIZE - 10000L > _data.BytesNotRead)
-                    DoIt = true;
+                if (BUFSIZE - 10000L <= _data.BytesNotRead)
+                    return;
+
+                //the decoder writes straight into the free part of the ring buffer
+                Data = _data;
+                Buffer = Data.BeginWrite(out Size);
             }
 
-            if (!DoIt)
-                return;
+            //Each decode fills one buffer of the source
+            int FrameCount = Math.Min(Size / _ByteCount, buffer_size / _ByteCount);
+            int Frames = _Decoder.Decode(Buffer, FrameCount, out Timecode);
 
-            _Decoder.Decode(out Buffer, out Timecode);
+            lock (MutexData)
+            {
+                Data.EndWrite(Frames * _ByteCount);
+                if (Frames > 0)
+                    _TimeCode = Timecode;
+            }
 
-            if (Buffer == null)
+            if (Frames < FrameCount)
             {
                 if (_Loop)
                 {
@@ -743,12 +787,6 @@ namespace Vocaluxe.Lib.Sound
                 }
                 return;
             }
-
-            lock (MutexData)
-            {
-                _data.Write(Buffer);
-                _TimeCode = Timecode;
-            }
         }
 
         private void DoFree()
@@ -218,6 +218,21 @@ namespace Vocaluxe.Lib.Sound
             }
         }
 
+        public void SetPriority(int Stream, EAudioPriority Priority)
+        {
+            if (_Initialized)
+            {
+                lock (MutexDecoder)
+                {
+                    if (AlreadyAdded(Stream))
+                    {
+                        _Decoder[GetStreamIndex(Stream)].Priority = Priority;
+                    }
+                }
+
+            }
+        }
+
         public float GetLength(int Stream)
         {
             if (_Initialized)
@@ -370,10 +385,12 @@ namespace Vocaluxe.Lib.Sound
     class PortAudioStream
     {
         const long BUFSIZE = 50000L;
+        const int DECODEFRAMES = 2048;              // frames decoded at once if PortAudio chooses the buffer size
 
         private CSyncTimer _SyncTimer;
         private bool _Initialized;
         private int _ByteCount = 4;
+        private int _DecodeFrames = DECODEFRAMES;
         private float _Volume = 1f;
         
         private Stopwatch _fadeTimer = new Stopwatch();
@@ -463,6 +480,25 @@ namespace Vocaluxe.Lib.Sound
             }
         }
 
+        /// <summary>
+        /// The song must not wait for the video decoding, which runs at normal priority, so its
+        /// thread runs above it. Previews and background music stay at normal priority.
+        /// </summary>
+        public EAudioPriority Priority
+        {
+            set
+            {
+                try
+                {
+                    _DecoderThread.Priority = value == EAudioPriority.Song ? ThreadPriority.AboveNormal : ThreadPriority.Normal;
+                }
+                catch (ThreadStateException)
+                {
+                    //the stream has already been closed
+                }
+            }
+        }
+
         public float Volume
         {
             get { return _Volume * 100f; }
@@ -616,6 +652,11 @@ namespace Vocaluxe.Lib.Sound
             outputParams.suggestedLatency = _outputDeviceInfo.defaultLowOutputLatency;
 
             uint bufsize = (uint)CConfig.AudioBufferSize;
+
+            //Each decode fills one buffer of the stream
+            if (bufsize > 0)
+                _DecodeFrames = (int)bufsize;
+
             errorCheck("OpenDefaultStream", PortAudio.Pa_OpenStream(
                 out _Ptr,
                 IntPtr.Zero,
@@ -633,9 +674,8 @@ namespace Vocaluxe.Lib.Sound
                 _Paused = true;
                 _waiting = true;
                 _FileOpened = true;
-                _data = new RingBuffer(BUFSIZE);
+                _data = new RingBuffer(BUFSIZE - BUFSIZE % _ByteCount);
                 _NoMoreData = false;
-                _DecoderThread.Priority = ThreadPriority.Normal;
                 _DecoderThread.Name = Path.GetFileName(FileName);
                 _DecoderThread.Start();
                 
@@ -664,7 +704,7 @@ namespace Vocaluxe.Lib.Sound
                 _Decoder.SetPosition(_Start);
                 _CurrentTime = _Start;
                 _TimeCode = _Start;
-                _data = new RingBuffer(BUFSIZE);
+                _data = new RingBuffer(BUFSIZE - BUFSIZE % _ByteCount);
                 _NoMoreData = false;
                 EventDecode.Set();
                 _waiting = false;
@@ -722,21 +762,31 @@ namespace Vocaluxe.Lib.Sound
                 return;
 
             float Timecode;
-            byte[] Buffer;
+            RingBuffer Data;
+            IntPtr Buffer;
+            int Size;
 
-            bool DoIt = false;
             lock (_LockData)
             {
-                if (!_skip && BUFSIZE - 10000L > _data.BytesNotRead)
-                    DoIt = true;
+                if (_skip || BUFSIZE - 10000L <= _data.BytesNotRead)
+                    return;
+
+                //the decoder writes straight into the free part of the ring buffer
+                Data = _data;
+                Buffer = Data.BeginWrite(out Size);
             }
 
-            if (!DoIt)
-                return;
+            int FrameCount = Math.Min(Size / _ByteCount, _DecodeFrames);
+            int Frames = _Decoder.Decode(Buffer, FrameCount, out Timecode);
 
-            _Decoder.Decode(out Buffer, out Timecode);
+            lock (_LockData)
+            {
+                Data.EndWrite(Frames * _ByteCount);
+                if (Frames > 0)
+                    _TimeCode = Timecode;
+            }
 
-            if (Buffer == null)
+            if (Frames < FrameCount)
             {
                 if (_Loop)
                 {
@@ -757,8 +807,6 @@ namespace Vocaluxe.Lib.Sound
 
             lock (_LockData)
             {
-                _data.Write(Buffer);
-                _TimeCode = Timecode;
                 if (_data.BytesNotRead < BUFSIZE - 10000L)
                 {
                     _waiting = false;
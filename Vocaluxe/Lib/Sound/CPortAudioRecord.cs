@@ -30,7 +30,7 @@ namespace Vocaluxe.Lib.Sound
             _Buffer = new CBuffer[CSettings.MaxNumPlayer];
             for (int i = 0; i < _Buffer.Length; i++)
             {
-                _Buffer[i] = new CBuffer();
+                _Buffer[i] = new CBuffer(CSettings.MicAnalysisSamples);
             }
 
             Init();
@@ -194,20 +194,18 @@ namespace Vocaluxe.Lib.Sound
                 PortAudio.Pa_Terminate();
                 _initialized = false;
             }
-
-            //System.IO.File.WriteAllBytes("test0.raw", _Buffer[0].Buffer);
         }
 
         /// <summary>
-        /// Detect Pitch and Volume of the newest voice buffer
+        /// Detect Pitch and Volume of the newest voice buffers of the first NumPlayer players
         /// </summary>
-        /// <param name="Player"></param>
-        public void AnalyzeBuffer(int Player)
+        /// <param name="NumPlayer"></param>
+        public void AnalyzeBuffers(int NumPlayer)
         {
             if (!_initialized)
                 return;
 
-            _Buffer[Player].AnalyzeBuffer();
+            CBuffer.AnalyzeBuffers(_Buffer, Math.Min(NumPlayer, _Buffer.Length));
         }
 
         public int GetToneAbs(int Player)
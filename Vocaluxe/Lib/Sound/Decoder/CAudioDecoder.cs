@@ -49,5 +49,11 @@ namespace Vocaluxe.Lib.Sound.Decoder
             Buffer = null;
             TimeStamp = 0f;
         }
+
+        public virtual int Decode(IntPtr Buffer, int FrameCount, out float TimeStamp)
+        {
+            TimeStamp = 0f;
+            return 0;
+        }
     }
 }
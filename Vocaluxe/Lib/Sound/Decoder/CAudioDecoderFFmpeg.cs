@@ -11,9 +11,17 @@ namespace Vocaluxe.Lib.Sound.Decoder
 {
     class CAudioDecoderFFmpeg: CAudioDecoder
     {
-        private TAc_read_callback _rc;
-        private TAc_seek_callback _sc;
-        private FileStream _fs;
+        private const int MAXPREFETCH = 3;          // files opened in advance at most
+
+        struct SPrefetch
+        {
+            public string FileName;
+            public IntPtr Instance;
+            public IntPtr Job;
+        }
+
+        private static List<SPrefetch> _Prefetches = new List<SPrefetch>();
+        private static Object _PrefetchLock = new Object();
 
         private IntPtr _instance = IntPtr.Zero;
         private IntPtr _audiodecoder = IntPtr.Zero;
@@ -27,9 +35,6 @@ namespace Vocaluxe.Lib.Sound.Decoder
 
         public override void Init()
         {
-            _rc = new TAc_read_callback(read_proc);
-            _sc = new TAc_seek_callback(seek_proc);
-
             _FileOpened = false;
 
             _Initialized = true;
@@ -41,10 +46,13 @@ namespace Vocaluxe.Lib.Sound.Decoder
                 return;
 
             _FileName = FileName;
-            _fs = new FileStream(FileName, FileMode.Open, FileAccess.Read, FileShare.Read);
 
-            _instance = CAcinerella.ac_init();
-            CAcinerella.ac_open(_instance, IntPtr.Zero, null, _rc, _sc, null, IntPtr.Zero);
+            //A video of the same file reads from the same instance
+            _instance = _TakePrefetch(FileName);
+            if (_instance != IntPtr.Zero)
+                CAcSharedInstances.Add(FileName, _instance, TAc_stream_type.AC_STREAM_TYPE_AUDIO);
+            else
+                _instance = CAcSharedInstances.Open(FileName, TAc_stream_type.AC_STREAM_TYPE_AUDIO);
 
             _Instance = (TAc_instance)Marshal.PtrToStructure(_instance, typeof(TAc_instance));
 
@@ -63,13 +71,23 @@ namespace Vocaluxe.Lib.Sound.Decoder
 
                 if (Info.stream_type == TAc_stream_type.AC_STREAM_TYPE_AUDIO)
                 {
-                    try
-                    {
-                        _audiodecoder = CAcinerella.ac_create_decoder(_instance, i);
-                    }
-                    catch (Exception)
+                    lock (CAcSharedInstances.Lock)
                     {
-                        return;                        
+                        //The playback expects interleaved 16 bit samples in mono or stereo,
+                        //the decoder converts everything else
+                        _Instance = (TAc_instance)Marshal.PtrToStructure(_instance, typeof(TAc_instance));
+                        _Instance.audio_output_format = TAc_audio_format.AC_AUDIO_S16;
+                        _Instance.audio_channel_count = Math.Min(Info.audio_info.channel_count, 2);
+                        Marshal.StructureToPtr(_Instance, _instance, false);
+
+                        try
+                        {
+                            _audiodecoder = CAcinerella.ac_create_decoder(_instance, i);
+                        }
+                        catch (Exception)
+                        {
+                            return;
+                        }
                     }
                     
                     AudioStreamIndex = i;
@@ -77,7 +95,8 @@ namespace Vocaluxe.Lib.Sound.Decoder
                 }
             }
 
-            if (AudioStreamIndex < 0)
+            //The codec of the stream is not supported
+            if (AudioStreamIndex < 0 || _audiodecoder == IntPtr.Zero)
             {
                 //Free();
                 return;
@@ -93,14 +112,90 @@ namespace Vocaluxe.Lib.Sound.Decoder
 
             _CurrentTime = 0f;
 
-            if (_FormatInfo.BitDepth != 16)
+            if (_FormatInfo.BitDepth != 16 || _FormatInfo.ChannelCount <= 0)
             {
-                CLog.LogError("Unsupported BitDepth in file " + FileName);
+                CLog.LogError("Unsupported audio format in file " + FileName);
                 return;
             }
             _FileOpened = true;
         }
 
+        /// <summary>
+        /// Starts to open a file in the background, so opening it later does not wait for the
+        /// probing and stream discovery. The oldest prefetch is given up if there are too many.
+        /// </summary>
+        public static void Prefetch(string FileName)
+        {
+            if (!File.Exists(FileName))
+                return;
+
+            lock (_PrefetchLock)
+            {
+                foreach (SPrefetch prefetch in _Prefetches)
+                {
+                    if (prefetch.FileName == FileName)
+                        return;
+                }
+
+                SPrefetch p = new SPrefetch();
+                p.FileName = FileName;
+                p.Instance = CAcinerella.ac_init();
+                p.Job = CAcinerella.ac_open_async(p.Instance, FileName, CConfig.MapMediaFiles == EOffOn.TR_CONFIG_ON);
+                if (p.Job == IntPtr.Zero)
+                {
+                    CAcinerella.ac_free(p.Instance);
+                    return;
+                }
+                _Prefetches.Add(p);
+
+                if (_Prefetches.Count > MAXPREFETCH)
+                {
+                    _CancelPrefetch(_Prefetches[0]);
+                    _Prefetches.RemoveAt(0);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Gives up all files which are opened in advance
+        /// </summary>
+        public static void ClearPrefetches()
+        {
+            lock (_PrefetchLock)
+            {
+                foreach (SPrefetch prefetch in _Prefetches)
+                {
+                    _CancelPrefetch(prefetch);
+                }
+                _Prefetches.Clear();
+            }
+        }
+
+        private static void _CancelPrefetch(SPrefetch Prefetch)
+        {
+            CAcinerella.ac_open_async_cancel(Prefetch.Job);
+            CAcinerella.ac_free(Prefetch.Instance);
+        }
+
+        //Returns the instance of a prefetched file once it has been opened, or IntPtr.Zero
+        //if the file has not been prefetched
+        private static IntPtr _TakePrefetch(string FileName)
+        {
+            SPrefetch p = new SPrefetch();
+            lock (_PrefetchLock)
+            {
+                int Index = _Prefetches.FindIndex(delegate(SPrefetch prefetch) { return prefetch.FileName == FileName; });
+                if (Index < 0)
+                    return IntPtr.Zero;
+
+                p = _Prefetches[Index];
+                _Prefetches.RemoveAt(Index);
+            }
+
+            CAcinerella.ac_open_async_wait(p.Job);
+            return p.Instance;
+        }
+
         public override void Close()
         {
             if (!_Initialized)
@@ -108,17 +203,14 @@ namespace Vocaluxe.Lib.Sound.Decoder
 
             _Initialized = false;
 
-            if (!_FileOpened)
-                return;
-
             if (_audiodecoder != IntPtr.Zero)
                 CAcinerella.ac_free_decoder(_audiodecoder);
+            _audiodecoder = IntPtr.Zero;
 
-            if (_instance != IntPtr.Zero)
-                CAcinerella.ac_close(_instance);
-
-            if (_instance != IntPtr.Zero)
-                CAcinerella.ac_free(_instance);
+            //Closes the file unless a video still reads from it. A file which could not be
+            //decoded is given back as well, so it is not shared anymore.
+            CAcSharedInstances.Release(_instance, TAc_stream_type.AC_STREAM_TYPE_AUDIO);
+            _instance = IntPtr.Zero;
 
             _FileOpened = false;
         }
@@ -202,22 +294,30 @@ namespace Vocaluxe.Lib.Sound.Decoder
             TimeStamp = 0f;
         }
 
-        #region Callbacks
-        private Int32 read_proc(IntPtr sender, IntPtr buf, Int32 size)
+        public override int Decode(IntPtr Buffer, int FrameCount, out float TimeStamp)
         {
-            Int32 r = 0;
+            TimeStamp = 0f;
+            if (!_Initialized && !_FileOpened)
+                return 0;
 
-            byte[] bb = new byte[size];
-            r = _fs.Read(bb, 0, size);
-            Marshal.Copy(bb, 0, buf, size);
+            int FramesRead = 0;
+            try
+            {
+                FramesRead = CAcinerella.ac_read_audio_frames(_instance, _audiodecoder, Buffer, FrameCount);
+            }
+            catch (Exception)
+            {
+                FramesRead = 0;
+            }
 
-            return r;
-        }
+            if (FramesRead > 0)
+            {
+                TAc_decoder Decoder = (TAc_decoder)Marshal.PtrToStructure(_audiodecoder, typeof(TAc_decoder));
 
-        private Int64 seek_proc(IntPtr sender, Int64 pos, Int32 whence)
-        {
-            return (Int64)_fs.Seek((long)pos, (SeekOrigin)whence);
+                TimeStamp = (float)Decoder.timecode;
+                _CurrentTime = TimeStamp;
+            }
+            return FramesRead;
         }
-        #endregion Callbacks
     }
 }
@@ -26,5 +26,6 @@ namespace Vocaluxe.Lib.Sound.Decoder
         float GetPosition();
 
         void Decode(out byte[] Buffer, out float TimeStamp);
+        int Decode(IntPtr Buffer, int FrameCount, out float TimeStamp);
     }
 }
@@ -1,5 +1,6 @@
 ﻿using System;
 using System.Collections.Generic;
+using System.Runtime.InteropServices;
 using System.Text;
 
 namespace Vocaluxe.Lib.Sound
@@ -18,6 +19,15 @@ namespace Vocaluxe.Lib.Sound
 
     delegate void CLOSEPROC(int StreamID);
 
+    /// <summary>
+    /// Decides which streams are decoded first if the decoding competes with the videos
+    /// </summary>
+    enum EAudioPriority
+    {
+        Song,
+        Normal
+    }
+
     interface IPlayback
     {
         bool Init();
@@ -38,6 +48,7 @@ namespace Vocaluxe.Lib.Sound
         void FadeAndPause(int Stream, float TargetVolume, float Seconds);
         void FadeAndStop(int Stream, float TargetVolume, float Seconds);
         void SetStreamVolume(int Stream, float Volume);        
+        void SetPriority(int Stream, EAudioPriority Priority);
 
         float GetLength(int Stream);
         float GetPosition(int Stream);
@@ -59,6 +70,7 @@ namespace Vocaluxe.Lib.Sound
         private long _readPos;
         private long _writePos;
         private long _bytesNotRead;
+        private GCHandle _handle;
 
         public long BytesNotRead
         {
@@ -92,6 +104,28 @@ namespace Vocaluxe.Lib.Sound
             }
         }
 
+        /// <summary>
+        /// Pins the buffer and returns the contiguous free block at the write position,
+        /// so a decoder can write into it directly. Has to be followed by EndWrite.
+        /// </summary>
+        public IntPtr BeginWrite(out int Size)
+        {
+            Size = (int)Math.Min(_size - _writePos, _size - _bytesNotRead);
+            _handle = GCHandle.Alloc(_data, GCHandleType.Pinned);
+            return new IntPtr(_handle.AddrOfPinnedObject().ToInt64() + _writePos);
+        }
+
+        public void EndWrite(int Written)
+        {
+            if (_handle.IsAllocated)
+                _handle.Free();
+
+            _writePos += Written;
+            if (_writePos >= _size)
+                _writePos = 0L;
+            _bytesNotRead += Written;
+        }
+
         public void Read(ref byte[] Data)
         {
             long read = 0L;
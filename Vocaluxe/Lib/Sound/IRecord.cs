@@ -44,7 +44,7 @@ namespace Vocaluxe.Lib.Sound
 
         bool Start(SRecordDevice[] DeviceConfig);
         bool Stop();
-        void AnalyzeBuffer(int Player);
+        void AnalyzeBuffers(int NumPlayer);
 
         int GetToneAbs(int Player);
         int GetTone(int Player);
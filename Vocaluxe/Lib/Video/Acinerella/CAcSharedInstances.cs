@@ -0,0 +1,138 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using System.Text;
+
+using Vocaluxe.Base;
+
+namespace Vocaluxe.Lib.Video.Acinerella
+{
+    /// <summary>
+    /// Keeps track of the opened files whose audio and video are decoded at the same time, e.g.
+    /// a song with the audio in its video file. Such a file is opened and demuxed only once, the
+    /// instance runs in the shared demux mode. Each stream type is used by one decoder at most.
+    /// </summary>
+    public static class CAcSharedInstances
+    {
+        class SInstance
+        {
+            public string FileName;
+            public IntPtr Instance;
+            public int References;
+            public bool Audio;
+            public bool Video;
+        }
+
+        private static List<SInstance> _Instances = new List<SInstance>();
+
+        /// <summary>
+        /// Has to be held while the settings of a shared instance are changed and a decoder is created
+        /// </summary>
+        public static readonly Object Lock = new Object();
+
+        /// <summary>
+        /// Returns an instance of the file for a decoder of the given stream type. The instance is
+        /// shared with the decoder of the other type if the file is opened already. Check whether
+        /// the instance has been opened and give it back with Release.
+        /// </summary>
+        public static IntPtr Open(string FileName, TAc_stream_type Type)
+        {
+            lock (Lock)
+            {
+                SInstance shared = _Instances.Find(delegate(SInstance s)
+                {
+                    return s.FileName == FileName && !_InUse(s, Type);
+                });
+                if (shared != null)
+                {
+                    _Use(shared, Type);
+                    return shared.Instance;
+                }
+
+                IntPtr Instance = CAcinerella.ac_init();
+                if (CConfig.MapMediaFiles == EOffOn.TR_CONFIG_ON)
+                    CAcinerella.ac_open_mapped(Instance, FileName);
+                else
+                    CAcinerella.ac_open_file(Instance, FileName, 0);
+
+                _Add(FileName, Instance, Type);
+                return Instance;
+            }
+        }
+
+        /// <summary>
+        /// Lets the decoder of the other stream type share an instance which has been opened
+        /// elsewhere, e.g. in advance. Give it back with Release.
+        /// </summary>
+        public static void Add(string FileName, IntPtr Instance, TAc_stream_type Type)
+        {
+            lock (Lock)
+            {
+                _Add(FileName, Instance, Type);
+            }
+        }
+
+        /// <summary>
+        /// Gives back an instance the decoder of the given type has freed its decoder of. The
+        /// instance is closed when no decoder uses it anymore.
+        /// </summary>
+        public static void Release(IntPtr Instance, TAc_stream_type Type)
+        {
+            if (Instance == IntPtr.Zero)
+                return;
+
+            lock (Lock)
+            {
+                SInstance shared = _Instances.Find(delegate(SInstance s) { return s.Instance == Instance; });
+                if (shared != null)
+                {
+                    if (Type == TAc_stream_type.AC_STREAM_TYPE_AUDIO)
+                        shared.Audio = false;
+                    else
+                        shared.Video = false;
+
+                    shared.References--;
+                    if (shared.References > 0)
+                        return;
+
+                    _Instances.Remove(shared);
+                }
+            }
+
+            CAcinerella.ac_close(Instance);
+            CAcinerella.ac_free(Instance);
+        }
+
+        private static bool _InUse(SInstance Shared, TAc_stream_type Type)
+        {
+            return Type == TAc_stream_type.AC_STREAM_TYPE_AUDIO ? Shared.Audio : Shared.Video;
+        }
+
+        private static void _Use(SInstance Shared, TAc_stream_type Type)
+        {
+            if (Type == TAc_stream_type.AC_STREAM_TYPE_AUDIO)
+                Shared.Audio = true;
+            else
+                Shared.Video = true;
+            Shared.References++;
+        }
+
+        //Files which could not be opened are not shared, Release only closes them
+        private static void _Add(string FileName, IntPtr Instance, TAc_stream_type Type)
+        {
+            TAc_instance Settings = (TAc_instance)Marshal.PtrToStructure(Instance, typeof(TAc_instance));
+            if (!Settings.opened)
+                return;
+
+            //Takes effect when the first decoder is created
+            Settings.shared_demux = true;
+            Marshal.StructureToPtr(Settings, Instance, false);
+
+            SInstance shared = new SInstance();
+            shared.FileName = FileName;
+            shared.Instance = Instance;
+            _Use(shared, Type);
+            _Instances.Add(shared);
+        }
+    }
+}
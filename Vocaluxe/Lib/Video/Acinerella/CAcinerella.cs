@@ -1,6 +1,7 @@
 ﻿using System;
 using System.Runtime.InteropServices;
 using System.IO;
+using System.Text;
 
 using Vocaluxe.Base;
 
@@ -32,7 +33,72 @@ namespace Vocaluxe.Lib.Video.Acinerella
         AC_OUTPUT_RGB24 = 0,
         AC_OUTPUT_BGR24 = 1,
         AC_OUTPUT_RGBA32 = 2,
-        AC_OUTPUT_BGRA32 = 3
+        AC_OUTPUT_BGRA32 = 3,
+        //Planar YUV 4:2:0, the Y plane is followed by the U and V planes with half
+        //the width and height.
+        AC_OUTPUT_YUV420P = 4,
+        //YUV 4:2:0 with a Y plane followed by one plane of interleaved U and V
+        //samples.
+        AC_OUTPUT_NV12 = 5
+    }
+
+    //Defines how video decoders use multiple threads
+    public enum TAc_thread_type : int
+    {
+        //Use frame and slice threading, depending on what the codec supports.
+        AC_THREAD_AUTO = 0,
+        //Decode multiple frames at once. Each thread delays the output by one frame.
+        AC_THREAD_FRAME = 1,
+        //Decode multiple slices of one frame at once.
+        AC_THREAD_SLICE = 2
+    }
+
+    //Defines the format audio data is outputted in. The samples of all channels
+    //are interleaved.
+    public enum TAc_audio_format : int
+    {
+        //Signed 16 bit integer samples
+        AC_AUDIO_S16 = 0,
+        //32 bit floating point samples in the range of -1 to 1
+        AC_AUDIO_F32 = 1
+    }
+
+    //Defines which frames a video decoder skips parts of the decoding for. Each
+    //level includes the frames of the levels before it.
+    public enum TAc_discard : int
+    {
+        //Decode all frames completely
+        AC_DISCARD_NONE = 0,
+        //Frames no other frame refers to
+        AC_DISCARD_NONREF = 1,
+        //Bidirectionally predicted frames
+        AC_DISCARD_BIDIR = 2,
+        //All frames but keyframes, disturbs the following frames up to the next keyframe
+        AC_DISCARD_NONKEY = 3,
+        //All frames
+        AC_DISCARD_ALL = 4
+    }
+
+    //Priority classes of the decode scheduler which runs the decode ahead of all video
+    //decoders. A class is only served while no decoder of a higher class has work.
+    public enum TAc_priority : int
+    {
+        //The video of the song being sung
+        AC_PRIORITY_SONG = 0,
+        //Videos shown with the background music
+        AC_PRIORITY_BACKGROUND = 1,
+        //Song previews and theme videos, the default
+        AC_PRIORITY_PREVIEW = 2
+    }
+
+    //Implementations of ac_analyze_pitch, all of them return identical results
+    public enum TAc_pitch_kernel : int
+    {
+        //The fastest implementation the processor supports, the default
+        AC_PITCH_AUTO = 0,
+        AC_PITCH_SCALAR = 1,
+        AC_PITCH_SSE2 = 2,
+        AC_PITCH_AVX2 = 3
     }
 
 
@@ -59,6 +125,40 @@ namespace Vocaluxe.Lib.Video.Acinerella
         public TAc_output_format output_format;
         //Contains information about the opened stream/file
         public TAc_file_info info;
+        //Set this value to change the number of threads video decoders use. Zero
+        //chooses the count by the number of processor cores, one decodes in the
+        //calling thread only. Takes effect when the decoder is created.
+        public Int32 thread_count;
+        //Set this value to change how video decoders use their threads
+        public TAc_thread_type thread_type;
+        //Set these values to scale the video frames to the given size while they are
+        //converted. If only one of them is set, the other one is chosen by the aspect
+        //ratio. Zero keeps the size of the video.
+        public Int32 output_width;
+        public Int32 output_height;
+        //Set this value to limit the larger side of the video frames to the given
+        //size, the aspect ratio is kept. Zero disables the limit.
+        public Int32 output_max_size;
+        //If true, codecs which support it decode the frames at a reduced resolution
+        //when the output size is small enough.
+        [MarshalAs(UnmanagedType.I1)]
+        public bool allow_lowres;
+        //Set this value to let video decoders convert their frames into a pool of
+        //reference counted frames, see ac_get_video_frame. The value is the number of
+        //frames allocated in advance. Zero disables the pool.
+        public Int32 frame_pool_size;
+        //If true, the packages of streams with a decoder are queued for their decoders
+        //instead of being dropped, so several decoders can share one opened file. A seek
+        //moves all streams of the instance, the other decoders continue after the last
+        //package they got. A decoder which does not read loses its queued packages.
+        [MarshalAs(UnmanagedType.I1)]
+        public bool shared_demux;
+        //Set these values to change the sample format, sample rate and channel count
+        //audio decoders output. Zero keeps the sample rate or channel count of the
+        //stream. Takes effect when the decoder is created.
+        public TAc_audio_format audio_output_format;
+        public Int32 audio_sample_rate;
+        public Int32 audio_channel_count;
     }
 
     // Contains information about an Acinerella audio stream.
@@ -67,7 +167,7 @@ namespace Vocaluxe.Lib.Video.Acinerella
     {
         //Samples per second. Default values are 44100 or 48000.
         public Int32 samples_per_second;
-        //Bits per sample. Can be 8 or 16 Bit.
+        //Bits per sample. Can be 8, 16 or 32 Bit.
         public Int32 bit_depth;
         //Count of channels in the audio stream.
         public Int32 channel_count;
@@ -122,6 +222,52 @@ namespace Vocaluxe.Lib.Video.Acinerella
         public IntPtr buffer;
         //Size of the data in the buffer.
         public Int32 buffer_size;
+
+        //The size of the frames in the buffer of a video decoder. May differ from
+        //the size of the video if the output is scaled.
+        public Int32 output_width;
+        public Int32 output_height;
+
+        //Pointers on the planes of the frame. The packed RGB formats only use the
+        //first plane, YUV420P uses three and NV12 two planes. If the video is
+        //decoded in the requested YUV format and not scaled, the planes point
+        //directly into the decoded frame instead of the buffer. In both cases they
+        //are valid until the next frame is decoded.
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = CAcinerella.AC_MAX_PLANES)]
+        public IntPtr[] planes;
+        //Size of one line of each plane in bytes.
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = CAcinerella.AC_MAX_PLANES)]
+        public Int32[] strides;
+        //Size of each plane in bytes.
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = CAcinerella.AC_MAX_PLANES)]
+        public Int32[] plane_sizes;
+    }
+
+    // Contains a frame from the frame pool of a video decoder. The data of the frame
+    // stays valid until the frame is released with ac_release_frame.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TAc_frame
+    {
+        //The timecode of the frame in seconds.
+        public double timecode;
+        //The size of the frame in pixels.
+        public Int32 width;
+        public Int32 height;
+
+        //Pointer to the buffer which contains the frame.
+        public IntPtr buffer;
+        //Size of the data in the buffer.
+        public Int32 buffer_size;
+
+        //Pointers on the planes of the frame, see TAc_decoder.
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = CAcinerella.AC_MAX_PLANES)]
+        public IntPtr[] planes;
+        //Size of one line of each plane in bytes.
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = CAcinerella.AC_MAX_PLANES)]
+        public Int32[] strides;
+        //Size of each plane in bytes.
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = CAcinerella.AC_MAX_PLANES)]
+        public Int32[] plane_sizes;
     }
 
     // Contains information about an Acinerella package.
@@ -132,6 +278,99 @@ namespace Vocaluxe.Lib.Video.Acinerella
         public Int32 stream_index;
     }
 
+    // Performance counters of a decoder, see ac_get_stats. The counters start at zero
+    // when the decoder is created and only grow. Times are in microseconds.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TAc_stats
+    {
+        //Packages and bytes read from the file by all decoders of the instance and
+        //the time spent in the demuxer.
+        public Int64 packets_read;
+        public Int64 bytes_read;
+        public Int64 read_time;
+        //Packages of other streams the decoder read and threw away.
+        public Int64 packets_discarded;
+        //Time spent in the codec and in the conversion into the output format.
+        public Int64 decode_time;
+        public Int64 convert_time;
+        //Frames the codec returned, the ones which were skipped without being converted
+        //and the ones an accurate seek decoded to reach its target.
+        public Int64 frames_decoded;
+        public Int64 frames_dropped;
+        public Int64 frames_sought;
+        //Frames of the decode ahead ring which were replaced by a later one before
+        //they were fetched.
+        public Int64 frames_late;
+        //Number of seeks, the total and the longest time they took.
+        public Int64 seek_count;
+        public Int64 seek_time;
+        public Int64 seek_time_max;
+        //Largest package, largest output buffer and most packages queued for one stream.
+        public Int64 max_package_size;
+        public Int64 max_buffer_size;
+        public Int64 max_queued_packages;
+        //Current level of the automatic discard mode, zero if all frames are decoded completely.
+        public Int64 discard_level;
+    }
+
+    // Result of scanning a media file, see ac_scan_files.
+    public enum TAc_scan_error : int
+    {
+        //The file contains an audio or video stream which can be decoded. Check
+        //audio_decoder and video_decoder for the stream type which is needed.
+        AC_SCAN_OK = 0,
+        //The file does not exist, can not be read or has an unknown format.
+        AC_SCAN_OPEN_FAILED = 1,
+        //The file contains neither an audio nor a video stream.
+        AC_SCAN_NO_STREAMS = 2,
+        //There is no decoder for the codecs of any audio or video stream.
+        AC_SCAN_NO_DECODER = 3
+    }
+
+    // Contains what ac_scan_files found out about one media file.
+    [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+    public struct TAc_scan_result
+    {
+        //Index of the file in the list passed to ac_scan_files.
+        public Int32 index;
+        //Whether the file can be played.
+        public TAc_scan_error error;
+        //Short names of the container format and of the codecs of the audio and video
+        //stream, the first one which can be decoded is preferred. Empty if not available.
+        [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 32)]
+        public string container;
+        [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 32)]
+        public string audio_codec;
+        [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 32)]
+        public string video_codec;
+        //Length of the file in milliseconds, -1 if unknown.
+        public Int64 duration;
+        //If true, the file has an audio or video stream.
+        [MarshalAs(UnmanagedType.I1)]
+        public bool has_audio;
+        [MarshalAs(UnmanagedType.I1)]
+        public bool has_video;
+        //If true, there is a decoder for the codec of the audio or video stream. An
+        //attached picture like the cover of a MP3 file is a video stream as well.
+        [MarshalAs(UnmanagedType.I1)]
+        public bool audio_decoder;
+        [MarshalAs(UnmanagedType.I1)]
+        public bool video_decoder;
+    }
+
+    // An image returned by ac_get_thumbnail. The lines of the image follow each
+    // other without any padding.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TAc_image
+    {
+        //Size of the image in pixels.
+        public Int32 width;
+        public Int32 height;
+        //Pointer on the image data and its size in bytes.
+        public IntPtr pBuffer;
+        public Int32 buffer_size;
+    }
+
 
     // Callback function used to ask the application to read data. Should return
     // the number of bytes read or an value smaller than zero if an error occured.
@@ -155,6 +394,18 @@ namespace Vocaluxe.Lib.Video.Acinerella
     [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
     public delegate Int32 TAc_openclose_callback(IntPtr sender);
 
+    // Callback function which receives the result of each file scanned by
+    // ac_scan_files. The result is only valid during the call.
+    // TAc_scan_callback = procedure(sender: Pointer; result: PAc_scan_result); cdecl;
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    public delegate void TAc_scan_callback(IntPtr sender, IntPtr result);
+
+    // Callback function which receives the thumbnail of each file passed to
+    // ac_get_thumbnails, IntPtr.Zero if there is none. The image is only valid during the call.
+    // TAc_thumbnail_callback = procedure(sender: Pointer; index: integer; image: PAc_image); cdecl;
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    public delegate void TAc_thumbnail_callback(IntPtr sender, Int32 index, IntPtr image);
+
 
     public static class CAcinerella
     {
@@ -178,6 +429,9 @@ namespace Vocaluxe.Lib.Video.Acinerella
 #endif
 #endif
 
+        // Maximum number of planes a frame in one of the output formats has.
+        public const int AC_MAX_PLANES = 3;
+
         private static Object _lock = new Object();
 
         // Defines the type of an Acinerella media stream. Currently only video and
@@ -253,6 +507,123 @@ namespace Vocaluxe.Lib.Video.Acinerella
                 return _ac_open(PAc_instance, sender, open_proc, read_proc, seek_proc, close_proc, proberesult);
             }
         }
+
+        // Opens a media file directly from disk. The file is read natively, so no data
+        // has to pass the read/seek callbacks.
+        // @param(buffer_size specifies the size of the IO buffer in bytes. Pass zero to
+        // use the default size.)
+        /*function ac_open_file(
+            inst: PAc_instance;
+            filename: PChar;
+            buffer_size: integer): integer; cdecl; external ac_dll;
+        */
+        [DllImport(AcDll, EntryPoint = "ac_open_file", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_open_file(IntPtr PAc_instance, byte[] filename, Int32 buffer_size);
+
+        public static Int32 ac_open_file(IntPtr PAc_instance, string FileName, Int32 buffer_size)
+        {
+            //acinerella expects an UTF-8 encoded, null terminated path
+            byte[] filename = Encoding.UTF8.GetBytes(FileName + "\0");
+
+            lock (_lock)
+            {
+                return _ac_open_file(PAc_instance, filename, buffer_size);
+            }
+        }
+
+        // Opens a media file by mapping it into memory. ffmpeg reads the data straight
+        // from the mapping and seeking does not need any system call. This is meant for
+        // files on local drives. If the file can not be mapped, it is read like in
+        // ac_open_file.
+        /*function ac_open_mapped(
+            inst: PAc_instance;
+            filename: PChar): integer; cdecl; external ac_dll;
+        */
+        [DllImport(AcDll, EntryPoint = "ac_open_mapped", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_open_mapped(IntPtr PAc_instance, byte[] filename);
+
+        public static Int32 ac_open_mapped(IntPtr PAc_instance, string FileName)
+        {
+            byte[] filename = Encoding.UTF8.GetBytes(FileName + "\0");
+
+            lock (_lock)
+            {
+                return _ac_open_mapped(PAc_instance, filename);
+            }
+        }
+
+        // Opens a media file on a thread of its own, which probes the file and discovers its
+        // streams. The instance must not be used until the job has been finished by
+        // ac_open_async_wait or ac_open_async_cancel, which have to be called exactly once.
+        // Returns nil if the thread could not be started.
+        /*function ac_open_async(
+            inst: PAc_instance;
+            filename: PChar;
+            mapped: boolean): PAc_open_job; cdecl; external ac_dll;
+        */
+        [DllImport(AcDll, EntryPoint = "ac_open_async", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern IntPtr _ac_open_async(IntPtr PAc_instance, byte[] filename, [MarshalAs(UnmanagedType.I1)] bool mapped);
+
+        public static IntPtr ac_open_async(IntPtr PAc_instance, string FileName, bool Mapped)
+        {
+            byte[] filename = Encoding.UTF8.GetBytes(FileName + "\0");
+
+            lock (_lock)
+            {
+                return _ac_open_async(PAc_instance, filename, Mapped);
+            }
+        }
+
+        // Returns true if the file has been opened or the opening has failed, so
+        // ac_open_async_wait does not block.
+        //function ac_open_async_ready(job: PAc_open_job): boolean; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_open_async_ready", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool _ac_open_async_ready(IntPtr PAc_open_job);
+
+        public static bool ac_open_async_ready(IntPtr PAc_open_job)
+        {
+            return _ac_open_async_ready(PAc_open_job);
+        }
+
+        // Waits until the file has been opened and frees the job. Returns what ac_open_file
+        // would have returned.
+        //function ac_open_async_wait(job: PAc_open_job): integer; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_open_async_wait", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_open_async_wait(IntPtr PAc_open_job);
+
+        public static Int32 ac_open_async_wait(IntPtr PAc_open_job)
+        {
+            return _ac_open_async_wait(PAc_open_job);
+        }
+
+        // Stops the opening as soon as possible, closes the file if it has been opened and
+        // frees the job. The instance still has to be freed.
+        //procedure ac_open_async_cancel(job: PAc_open_job); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_open_async_cancel", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_open_async_cancel(IntPtr PAc_open_job);
+
+        public static void ac_open_async_cancel(IntPtr PAc_open_job)
+        {
+            _ac_open_async_cancel(PAc_open_job);
+        }
+
+        // Enables the stream info cache for files opened by ac_open_file and ac_open_mapped.
+        // Later opens of an unchanged file skip probing and the stream info discovery.
+        // Pass null to disable the cache.
+        //procedure ac_set_info_cache(directory: PChar); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_set_info_cache", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_set_info_cache(byte[] directory);
+
+        public static void ac_set_info_cache(string Directory)
+        {
+            byte[] directory = Directory == null ? null : Encoding.UTF8.GetBytes(Directory + "\0");
+
+            lock (_lock)
+            {
+                _ac_set_info_cache(directory);
+            }
+        }
         
         // Closes an opened media file.
         //procedure ac_close(inst: PAc_instance);cdecl; external ac_dll;
@@ -303,6 +674,17 @@ namespace Vocaluxe.Lib.Video.Acinerella
         [DllImport(AcDll, EntryPoint = "ac_free_package", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
         public static extern void ac_free_package(IntPtr PAc_package);
 
+        // Returns an empty package which can be filled by ac_read_package_to.
+        //function ac_alloc_package(inst: PAc_instance): PAc_package; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_alloc_package", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        public static extern IntPtr ac_alloc_package(IntPtr inst);
+
+        // Reads the next package into the given package, replacing the data read before.
+        // Returns 0 at the end of the file.
+        //function ac_read_package_to(inst: PAc_instance; package: PAc_package): integer; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_read_package_to", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        public static extern Int32 ac_read_package_to(IntPtr inst, IntPtr PAc_package);
+
         // Creates an decoder for the specified stream number. Returns NIL if no decoder
         // could be found.
         //function ac_create_decoder(pacInstance: PAc_instance; nb: integer): PAc_decoder; cdecl; external ac_dll;
@@ -355,6 +737,21 @@ namespace Vocaluxe.Lib.Video.Acinerella
             }
         }
 
+        // Decodes exactly frame_count sample frames into the given buffer. Samples which
+        // do not fit are kept for the next call. Returns the number of sample frames
+        // written, which is only less than frame_count at the end of the file.
+        //function ac_read_audio_frames(pacInstance: PAc_instance; pDecoder: PAc_decoder; buffer: PByte; frame_count: integer): integer; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_read_audio_frames", ExactSpelling = true, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_read_audio_frames(IntPtr PAcInstance, IntPtr PAc_decoder, IntPtr Buffer, Int32 FrameCount);
+
+        public static Int32 ac_read_audio_frames(IntPtr PAcInstance, IntPtr PAc_decoder, IntPtr Buffer, Int32 FrameCount)
+        {
+            lock (_lock)
+            {
+                return _ac_read_audio_frames(PAcInstance, PAc_decoder, Buffer, FrameCount);
+            }
+        }
+
         [DllImport(AcDll, EntryPoint = "ac_get_frame", ExactSpelling = true, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
         private static extern Int32 _ac_get_frame(IntPtr PAcInstance, IntPtr PAc_decoder);
 
@@ -377,6 +774,169 @@ namespace Vocaluxe.Lib.Video.Acinerella
             }
         }
 
+        // Returns the frame the video decoder has decoded last and adds a reference to it.
+        // Has to be called from the thread which decodes. Returns IntPtr.Zero if the
+        // decoder does not use a frame pool or no frame has been decoded yet.
+        //function ac_get_video_frame(pDecoder: PAc_decoder): PAc_frame; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_get_video_frame", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern IntPtr _ac_get_video_frame(IntPtr PAc_decoder);
+
+        public static IntPtr ac_get_video_frame(IntPtr PAc_decoder)
+        {
+            lock (_lock)
+            {
+                return _ac_get_video_frame(PAc_decoder);
+            }
+        }
+
+        // Releases a frame returned by ac_get_video_frame or ac_get_frame_at, so the decoder
+        // can reuse it. May be called from any thread, even after the decoder has been freed.
+        // Thread safe, so it does not wait for the lock.
+        //procedure ac_release_frame(pFrame: PAc_frame); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_release_frame", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_release_frame(IntPtr PAc_frame);
+
+        public static void ac_release_frame(IntPtr PAc_frame)
+        {
+            _ac_release_frame(PAc_frame);
+        }
+
+        // Starts a thread which decodes the video ahead of the playback into a ring of
+        // frame_count frames. The decoder has to use a frame pool which is larger than the ring.
+        // As long as the thread runs, only the decode ahead functions may be used on the decoder
+        // and its instance. Returns 1 if the thread has been started.
+        //function ac_start_decode_ahead(pDecoder: PAc_decoder; frame_count: integer; loop: boolean): integer; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_start_decode_ahead", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_start_decode_ahead(IntPtr PAc_decoder, Int32 frame_count, [MarshalAs(UnmanagedType.I1)] bool loop);
+
+        public static Int32 ac_start_decode_ahead(IntPtr PAc_decoder, Int32 frame_count, bool loop)
+        {
+            lock (_lock)
+            {
+                return _ac_start_decode_ahead(PAc_decoder, frame_count, loop);
+            }
+        }
+
+        // Stops the decode ahead thread. Called by ac_free_decoder as well.
+        //procedure ac_stop_decode_ahead(pDecoder: PAc_decoder); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_stop_decode_ahead", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_stop_decode_ahead(IntPtr PAc_decoder);
+
+        public static void ac_stop_decode_ahead(IntPtr PAc_decoder)
+        {
+            lock (_lock)
+            {
+                _ac_stop_decode_ahead(PAc_decoder);
+            }
+        }
+
+        // Lets the decode ahead thread continue at the given time in seconds.
+        //procedure ac_decode_ahead_seek(pDecoder: PAc_decoder; time: double); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_decode_ahead_seek", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_decode_ahead_seek(IntPtr PAc_decoder, double time);
+
+        public static void ac_decode_ahead_seek(IntPtr PAc_decoder, double time)
+        {
+            lock (_lock)
+            {
+                _ac_decode_ahead_seek(PAc_decoder, time);
+            }
+        }
+
+        // Changes whether the decode ahead thread starts over at the end of the video.
+        //procedure ac_decode_ahead_loop(pDecoder: PAc_decoder; loop: boolean); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_decode_ahead_loop", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_decode_ahead_loop(IntPtr PAc_decoder, [MarshalAs(UnmanagedType.I1)] bool loop);
+
+        public static void ac_decode_ahead_loop(IntPtr PAc_decoder, bool loop)
+        {
+            lock (_lock)
+            {
+                _ac_decode_ahead_loop(PAc_decoder, loop);
+            }
+        }
+
+        // Returns the latest decoded frame which is due at the given presentation time in
+        // seconds, it has to be released with ac_release_frame. Returns IntPtr.Zero if no new
+        // frame is due. Called by the render thread, the function is thread safe and does
+        // not wait for the lock.
+        //function ac_get_frame_at(pDecoder: PAc_decoder; time: double): PAc_frame; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_get_frame_at", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern IntPtr _ac_get_frame_at(IntPtr PAc_decoder, double time);
+
+        public static IntPtr ac_get_frame_at(IntPtr PAc_decoder, double time)
+        {
+            return _ac_get_frame_at(PAc_decoder, time);
+        }
+
+        // Returns true if the decode ahead has reached the end of the video and all
+        // frames have been fetched.
+        //function ac_decode_ahead_finished(pDecoder: PAc_decoder): boolean; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_decode_ahead_finished", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool _ac_decode_ahead_finished(IntPtr PAc_decoder);
+
+        public static bool ac_decode_ahead_finished(IntPtr PAc_decoder)
+        {
+            return _ac_decode_ahead_finished(PAc_decoder);
+        }
+
+        // Sets the priority class the decode scheduler decodes the video ahead with. May be
+        // called at any time from any thread.
+        //procedure ac_set_decode_priority(pDecoder: PAc_decoder; priority: TAc_priority); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_set_decode_priority", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_set_decode_priority(IntPtr PAc_decoder, TAc_priority priority);
+
+        public static void ac_set_decode_priority(IntPtr PAc_decoder, TAc_priority priority)
+        {
+            _ac_set_decode_priority(PAc_decoder, priority);
+        }
+
+        // Copies the performance counters of the decoder. The counters are updated without
+        // locking, so this may be polled every frame from any thread.
+        //procedure ac_get_stats(pDecoder: PAc_decoder; stats: PAc_stats); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_get_stats", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_get_stats(IntPtr PAc_decoder, out TAc_stats stats);
+
+        public static void ac_get_stats(IntPtr PAc_decoder, out TAc_stats stats)
+        {
+            _ac_get_stats(PAc_decoder, out stats);
+        }
+
+        // Lets a video decoder skip the decoding of frames, the deblocking or the inverse
+        // transform. Takes effect with the next package and may be called from any thread.
+        //procedure ac_set_discard(pDecoder: PAc_decoder; skip_frame, skip_loop_filter, skip_idct: TAc_discard); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_set_discard", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_set_discard(IntPtr PAc_decoder, TAc_discard skip_frame, TAc_discard skip_loop_filter, TAc_discard skip_idct);
+
+        public static void ac_set_discard(IntPtr PAc_decoder, TAc_discard skip_frame, TAc_discard skip_loop_filter, TAc_discard skip_idct)
+        {
+            _ac_set_discard(PAc_decoder, skip_frame, skip_loop_filter, skip_idct);
+        }
+
+        // Lets the decode ahead thread raise the discard levels while it falls behind and
+        // lower them again once it keeps up.
+        //procedure ac_set_auto_discard(pDecoder: PAc_decoder; enabled: boolean); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_set_auto_discard", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_set_auto_discard(IntPtr PAc_decoder, [MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        public static void ac_set_auto_discard(IntPtr PAc_decoder, bool enabled)
+        {
+            _ac_set_auto_discard(PAc_decoder, enabled);
+        }
+
+        // Lets the decode ahead thread keep all frames of a looping video in memory and replay
+        // the following passes from there. Only videos whose frames fit into max_size bytes and
+        // which are not longer than max_duration seconds are kept, zero disables the cache.
+        //procedure ac_set_loop_cache(pDecoder: PAc_decoder; max_size: int64; max_duration: double); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_set_loop_cache", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_set_loop_cache(IntPtr PAc_decoder, Int64 max_size, double max_duration);
+
+        public static void ac_set_loop_cache(IntPtr PAc_decoder, Int64 max_size, double max_duration)
+        {
+            _ac_set_loop_cache(PAc_decoder, max_size, max_duration);
+        }
+
         // Seeks to the given target position in the file. The seek funtion is not able to seek a single audio/video stream
         // but seeks the whole file forward. The deocder parameter is only used as an timecode reference.
         // The parameter "dir" specifies the seek direction: 0 for forward, -1 for backward.
@@ -393,6 +953,36 @@ namespace Vocaluxe.Lib.Video.Acinerella
             }
         }
 
+        // Builds the keyframe index of a video decoder from the index of the container. If the
+        // container has none and scan is true, the whole file is read once. Returns the number
+        // of keyframes found.
+        //function ac_build_keyframe_index(pDecoder: PAc_decoder; scan: boolean): integer; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_build_keyframe_index", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_build_keyframe_index(IntPtr PAc_decoder, [MarshalAs(UnmanagedType.I1)] bool scan);
+
+        public static Int32 ac_build_keyframe_index(IntPtr PAc_decoder, bool scan)
+        {
+            lock (_lock)
+            {
+                return _ac_build_keyframe_index(PAc_decoder, scan);
+            }
+        }
+
+        // Seeks a video decoder exactly to the given time in seconds. Jumps to the keyframe
+        // before the time and decodes the frames up to it without converting them. The frame
+        // at the time is converted like by ac_get_frame. Returns 1 if the frame has been found.
+        //function ac_seek_accurate(pDecoder: PAc_decoder; time: double): integer; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_seek_accurate", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_seek_accurate(IntPtr PAc_decoder, double time);
+
+        public static Int32 ac_seek_accurate(IntPtr PAc_decoder, double time)
+        {
+            lock (_lock)
+            {
+                return _ac_seek_accurate(PAc_decoder, time);
+            }
+        }
+
         //function ac_probe_input_buffer(buf: PChar; bufsize: Integer; filename: PChar;
         //var score_max: Integer): PAc_proberesult; cdecl; external ac_dll;
         [DllImport(AcDll, EntryPoint = "ac_probe_input_buffer", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
@@ -402,5 +992,120 @@ namespace Vocaluxe.Lib.Video.Acinerella
             IntPtr filename,
             out Int32 score_max
             );
+
+        // Scans a list of media files on multiple threads without creating decoders. The
+        // result of each file is passed to the callback as soon as it is known, never by
+        // two threads at once. Returns the number of files which can be played. Does not
+        // take the lock, the scan runs on its own instances and may take a while.
+        //function ac_scan_files(filenames: PPChar; count: integer; thread_count: integer;
+        //sender: Pointer; callback: TAc_scan_callback): integer; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_scan_files", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_scan_files(IntPtr[] filenames, Int32 count, Int32 thread_count, IntPtr sender, TAc_scan_callback callback);
+
+        public static Int32 ac_scan_files(string[] FileNames, Int32 ThreadCount, TAc_scan_callback Callback)
+        {
+            IntPtr[] filenames = AllocFileNames(FileNames);
+            try
+            {
+                return _ac_scan_files(filenames, filenames.Length, ThreadCount, IntPtr.Zero, Callback);
+            }
+            finally
+            {
+                FreeFileNames(filenames);
+                GC.KeepAlive(Callback);
+            }
+        }
+
+        // Returns a single frame of a video file, scaled to max_size, as thumbnail. Returns
+        // IntPtr.Zero if the file has no video. Free the image with ac_free_image. Does not
+        // take the lock, the thumbnail is created on its own instance.
+        //function ac_get_thumbnail(filename: PChar; time: double; max_size: integer;
+        //format: TAc_output_format): PAc_image; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_get_thumbnail", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern IntPtr _ac_get_thumbnail(byte[] filename, double time, Int32 max_size, TAc_output_format format);
+
+        public static IntPtr ac_get_thumbnail(string FileName, double Time, Int32 MaxSize, TAc_output_format Format)
+        {
+            byte[] filename = Encoding.UTF8.GetBytes(FileName + "\0");
+            return _ac_get_thumbnail(filename, Time, MaxSize, Format);
+        }
+
+        // Frees an image returned by ac_get_thumbnail.
+        //procedure ac_free_image(image: PAc_image); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_free_image", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        public static extern void ac_free_image(IntPtr image);
+
+        // Creates the thumbnails of a list of video files on multiple threads. Each thumbnail is
+        // passed to the callback as soon as it is done, never by two threads at once. Returns the
+        // number of thumbnails created. Does not take the lock.
+        //function ac_get_thumbnails(filenames: PPChar; count: integer; time: double; max_size: integer;
+        //format: TAc_output_format; thread_count: integer; sender: Pointer;
+        //callback: TAc_thumbnail_callback): integer; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_get_thumbnails", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern Int32 _ac_get_thumbnails(IntPtr[] filenames, Int32 count, double time, Int32 max_size,
+            TAc_output_format format, Int32 thread_count, IntPtr sender, TAc_thumbnail_callback callback);
+
+        public static Int32 ac_get_thumbnails(string[] FileNames, double Time, Int32 MaxSize, TAc_output_format Format,
+            Int32 ThreadCount, TAc_thumbnail_callback Callback)
+        {
+            IntPtr[] filenames = AllocFileNames(FileNames);
+            try
+            {
+                return _ac_get_thumbnails(filenames, filenames.Length, Time, MaxSize, Format, ThreadCount, IntPtr.Zero, Callback);
+            }
+            finally
+            {
+                FreeFileNames(filenames);
+                GC.KeepAlive(Callback);
+            }
+        }
+
+        // Computes the autocorrelation weights of the pitch detection for the sample windows of
+        // several channels at once, the windows follow each other in samples. The weight of
+        // channel c and lag l is stored at weights[c * lag_count + l].
+        //procedure ac_analyze_pitch(samples: PSmallInt; sample_count, channel_count: integer;
+        //lags: PInteger; lag_count: integer; weights: PDouble); cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_analyze_pitch", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        private static extern void _ac_analyze_pitch(Int16[] samples, Int32 sample_count, Int32 channel_count,
+            Int32[] lags, Int32 lag_count, [Out] double[] weights);
+
+        public static void ac_analyze_pitch(Int16[] Samples, int SampleCount, int ChannelCount, int[] Lags, double[] Weights)
+        {
+            _ac_analyze_pitch(Samples, SampleCount, ChannelCount, Lags, Lags.Length, Weights);
+        }
+
+        // Selects the implementation of ac_analyze_pitch. Returns false and keeps the current
+        // one if the processor does not support it.
+        //function ac_set_pitch_kernel(kernel: TAc_pitch_kernel): boolean; cdecl; external ac_dll;
+        [DllImport(AcDll, EntryPoint = "ac_set_pitch_kernel", ExactSpelling = false, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Auto)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool _ac_set_pitch_kernel(TAc_pitch_kernel kernel);
+
+        public static bool ac_set_pitch_kernel(TAc_pitch_kernel Kernel)
+        {
+            return _ac_set_pitch_kernel(Kernel);
+        }
+
+        // Converts a list of file names into UTF-8 encoded C strings
+        private static IntPtr[] AllocFileNames(string[] FileNames)
+        {
+            IntPtr[] filenames = new IntPtr[FileNames.Length];
+            for (int i = 0; i < FileNames.Length; i++)
+            {
+                byte[] filename = Encoding.UTF8.GetBytes(FileNames[i] + "\0");
+                filenames[i] = Marshal.AllocHGlobal(filename.Length);
+                Marshal.Copy(filename, 0, filenames[i], filename.Length);
+            }
+            return filenames;
+        }
+
+        private static void FreeFileNames(IntPtr[] filenames)
+        {
+            foreach (IntPtr filename in filenames)
+            {
+                if (filename != IntPtr.Zero)
+                    Marshal.FreeHGlobal(filename);
+            }
+        }
     }
 }
@@ -0,0 +1,636 @@
+/*
+    This file is part of Acinerella.
+
+    Acinerella is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acinerella is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acinerella.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Decode benchmark of Acinerella. Generates its test media with the ffmpeg
+//command line tool from the lavfi test sources and prints one JSON object per
+//media file to stdout, progress and errors go to stderr.
+//
+//  acbench [-d work directory] [-f ffmpeg executable] [-s seek count] [-q] [-p]
+//
+//-q only uses the smallest video and one audio file. -p only checks that every
+//pitch analysis kernel the processor supports computes exactly the weights of
+//the original autocorrelation and times them, the exit code is 1 if one differs.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "acinerella.h"
+
+#define BENCH_OPEN_RUNS 5
+#define BENCH_SEEK_COUNT 50
+#define BENCH_SKIP_BATCH 25
+#define BENCH_AUDIO_FRAMES 4096
+#define BENCH_VIDEO_SECONDS 10
+#define BENCH_AUDIO_SECONDS 30
+#define BENCH_PITCH_CHANNELS 6
+#define BENCH_PITCH_TONES 47
+#define BENCH_PITCH_RUNS 200
+
+typedef struct {
+  const char *name;
+  const char *args;
+  bool quick;
+} bench_media;
+
+//The video files have a keyframe every two seconds, so the seeks have to
+//decode up to 50 frames after the keyframe
+static const bench_media video_media[] = {
+  {"h264_320x240.mp4", "-f lavfi -i testsrc=size=320x240:rate=25 -c:v libx264 -pix_fmt yuv420p -g 50", true},
+  {"h264_1280x720.mp4", "-f lavfi -i testsrc=size=1280x720:rate=25 -c:v libx264 -pix_fmt yuv420p -g 50", false},
+  {"h264_1920x1080.mp4", "-f lavfi -i testsrc=size=1920x1080:rate=25 -c:v libx264 -pix_fmt yuv420p -g 50", false},
+  {"mpeg4_320x240.avi", "-f lavfi -i testsrc=size=320x240:rate=25 -c:v mpeg4 -q:v 4 -g 50", false},
+  {"mpeg4_1280x720.avi", "-f lavfi -i testsrc=size=1280x720:rate=25 -c:v mpeg4 -q:v 4 -g 50", false},
+};
+
+static const bench_media audio_media[] = {
+  {"sine_44100.mp3", "-f lavfi -i sine=frequency=440:sample_rate=44100 -ac 2 -c:a libmp3lame -b:a 192k", true},
+  {"sine_48000.m4a", "-f lavfi -i sine=frequency=440:sample_rate=48000 -ac 2 -c:a aac -strict experimental -b:a 160k", false},
+  {"sine_44100.ogg", "-f lavfi -i sine=frequency=440:sample_rate=44100 -ac 2 -c:a libvorbis -q:a 5", false},
+};
+
+static const char *work_dir = "acbench_media";
+static const char *ffmpeg_exe = "ffmpeg";
+static int seek_count = BENCH_SEEK_COUNT;
+static bool quick = false;
+static bool pitch_only = false;
+
+//
+//--- Allocation counter ---
+//
+
+//The allocator functions are replaced to count the allocations of the library
+//and ffmpeg, the executable is linked with -rdynamic so the shared libraries
+//bind to them. Only glibc exports the functions needed to forward the calls.
+
+static volatile long alloc_count = 0;
+
+#ifdef __GLIBC__
+#define BENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size) {
+  __sync_fetch_and_add(&alloc_count, 1);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  __sync_fetch_and_add(&alloc_count, 1);
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  __sync_fetch_and_add(&alloc_count, 1);
+  return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  __sync_fetch_and_add(&alloc_count, 1);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+  __sync_fetch_and_add(&alloc_count, 1);
+  void *ptr = __libc_memalign(alignment, size);
+  if (ptr == NULL) {
+    return ENOMEM;
+  }
+  *memptr = ptr;
+  return 0;
+}
+#else
+#define BENCH_COUNT_ALLOCS 0
+#endif
+
+static long allocs(void) {
+  return __sync_fetch_and_add(&alloc_count, 0);
+}
+
+//
+//--- Helpers ---
+//
+
+static int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare_int64(const void *a, const void *b) {
+  int64_t x = *(const int64_t*)a;
+  int64_t y = *(const int64_t*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+//Returns the value at the given percentile of sorted values
+static double percentile(const int64_t *values, int count, int pct) {
+  if (count <= 0) {
+    return -1;
+  }
+  int i = (count - 1) * pct / 100;
+  return (double)values[i];
+}
+
+static bool file_exists(const char *filename) {
+  struct stat st;
+  return stat(filename, &st) == 0 && st.st_size > 0;
+}
+
+static void media_path(char *path, size_t size, const char *name) {
+  snprintf(path, size, "%s/%s", work_dir, name);
+}
+
+//Creates the media file with ffmpeg unless it exists already
+static bool generate_media(const bench_media *media, int seconds) {
+  char path[1024];
+  char cmd[4096];
+  media_path(path, sizeof(path), media->name);
+  if (file_exists(path)) {
+    return true;
+  }
+
+  fprintf(stderr, "acbench: generating %s\n", path);
+  snprintf(cmd, sizeof(cmd), "\"%s\" -nostdin -loglevel error -y %s -t %d \"%s\"",
+    ffmpeg_exe, media->args, seconds, path);
+  return system(cmd) == 0 && file_exists(path);
+}
+
+//Opens the file and creates a decoder for its first stream of the given type
+static lp_ac_decoder open_decoder(lp_ac_instance inst, const char *path, ac_stream_type type) {
+  if (ac_open_file(inst, path, 0) < 0) {
+    return NULL;
+  }
+
+  int i;
+  for (i = 0; i < inst->stream_count; i++) {
+    ac_stream_info info;
+    ac_get_stream_info(inst, i, &info);
+    if (info.stream_type == type) {
+      return ac_create_decoder(inst, i);
+    }
+  }
+  return NULL;
+}
+
+static lp_ac_instance create_instance(void) {
+  lp_ac_instance inst = ac_init();
+  inst->output_format = AC_OUTPUT_BGRA32;
+  inst->audio_output_format = AC_AUDIO_S16;
+  inst->audio_sample_rate = 44100;
+  inst->audio_channel_count = 2;
+  return inst;
+}
+
+static void close_decoder(lp_ac_instance inst, lp_ac_decoder dec) {
+  if (dec != NULL) {
+    ac_free_decoder(dec);
+  }
+  ac_close(inst);
+}
+
+static int CALL_CONVT stdio_read(void *sender, char *buf, int size) {
+  return (int)fread(buf, 1, size, (FILE*)sender);
+}
+
+static int64_t CALL_CONVT stdio_seek(void *sender, int64_t pos, int whence) {
+  FILE *file = (FILE*)sender;
+  if (fseeko(file, pos, whence) != 0) {
+    return -1;
+  }
+  return ftello(file);
+}
+
+//
+//--- Measurements ---
+//
+
+static const char *io_mode_names[] = {"file", "mapped", "callback"};
+
+//Opens the file with ac_open_file, ac_open_mapped or ac_open with stdio callbacks
+//(mode 0, 1, 2). The file of the callbacks is returned in file.
+static int open_mode(lp_ac_instance inst, const char *path, int mode, FILE **file) {
+  *file = NULL;
+  if (mode == 0) {
+    return ac_open_file(inst, path, 0);
+  } else if (mode == 1) {
+    return ac_open_mapped(inst, path);
+  }
+  *file = fopen(path, "rb");
+  return *file != NULL ? ac_open(inst, *file, NULL, stdio_read, stdio_seek, NULL, NULL) : -1;
+}
+
+static lp_ac_decoder create_stream_decoder(lp_ac_instance inst, ac_stream_type type) {
+  int s;
+  for (s = 0; s < inst->stream_count; s++) {
+    ac_stream_info info;
+    ac_get_stream_info(inst, s, &info);
+    if (info.stream_type == type) {
+      return ac_create_decoder(inst, s);
+    }
+  }
+  return NULL;
+}
+
+static void close_mode(lp_ac_instance inst, lp_ac_decoder dec, FILE *file) {
+  close_decoder(inst, dec);
+  ac_free(inst);
+  if (file != NULL) {
+    fclose(file);
+  }
+}
+
+//Returns the median time in milliseconds opening the file in the given mode
+//takes until the stream decoder is created
+static double bench_open(const char *path, ac_stream_type type, int mode) {
+  int64_t times[BENCH_OPEN_RUNS];
+  int runs = 0;
+  int i;
+  for (i = 0; i < BENCH_OPEN_RUNS; i++) {
+    lp_ac_instance inst = create_instance();
+    FILE *file;
+    int64_t start = now_ns();
+
+    lp_ac_decoder dec = NULL;
+    if (open_mode(inst, path, mode, &file) >= 0) {
+      dec = create_stream_decoder(inst, type);
+    }
+    if (dec != NULL) {
+      times[runs++] = now_ns() - start;
+    }
+    close_mode(inst, dec, file);
+  }
+
+  if (runs == 0) {
+    return -1;
+  }
+  qsort(times, runs, sizeof(int64_t), compare_int64);
+  return percentile(times, runs, 50) / 1e6;
+}
+
+//Returns the throughput in MB/s of demuxing every package of the file in the
+//given mode, nothing is decoded
+static double bench_demux(const char *path, int mode) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return -1;
+  }
+
+  lp_ac_instance inst = create_instance();
+  FILE *file;
+  int64_t time = -1;
+  if (open_mode(inst, path, mode, &file) >= 0) {
+    int64_t start = now_ns();
+    lp_ac_package pkg;
+    while ((pkg = ac_read_package(inst)) != NULL) {
+      ac_free_package(pkg);
+    }
+    time = now_ns() - start;
+  }
+  close_mode(inst, NULL, file);
+
+  return time > 0 ? st.st_size * 1e3 / time : -1;
+}
+
+//Returns the median time in milliseconds of seeking to a random position in the
+//given mode and demuxing the first package after it. The positions are the
+//same on every run.
+static double bench_io_seek(const char *path, ac_stream_type type, int mode, int64_t duration) {
+  int64_t *times = (int64_t*)malloc(sizeof(int64_t) * (seek_count > 0 ? seek_count : 1));
+  int seeks = 0;
+  unsigned int rnd = 54321;
+
+  lp_ac_instance inst = create_instance();
+  FILE *file;
+  lp_ac_decoder dec = NULL;
+  if (open_mode(inst, path, mode, &file) >= 0) {
+    dec = create_stream_decoder(inst, type);
+  }
+  int i;
+  for (i = 0; dec != NULL && duration > 0 && i < seek_count; i++) {
+    rnd = rnd * 1103515245 + 12345;
+    int64_t target = (int64_t)((rnd >> 8) % (unsigned int)duration);
+
+    int64_t start = now_ns();
+    lp_ac_package pkg;
+    if (ac_seek(dec, -1, target) && (pkg = ac_read_package(inst)) != NULL) {
+      times[seeks++] = now_ns() - start;
+      ac_free_package(pkg);
+    }
+  }
+  close_mode(inst, dec, file);
+
+  qsort(times, seeks, sizeof(int64_t), compare_int64);
+  double result = percentile(times, seeks, 50) / 1e6;
+  free(times);
+  return result;
+}
+
+//Prints the open time, demux throughput and seek latency of every input mode
+//as JSON fields
+static void print_io(const char *path, ac_stream_type type, int64_t duration) {
+  int mode;
+  for (mode = 0; mode < 3; mode++) {
+    printf("\"open_%s_ms\": %.3f, \"demux_%s_mbps\": %.1f, \"io_seek_%s_ms\": %.3f, ",
+      io_mode_names[mode], bench_open(path, type, mode),
+      io_mode_names[mode], bench_demux(path, mode),
+      io_mode_names[mode], bench_io_seek(path, type, mode, duration));
+  }
+}
+
+static void bench_video(const bench_media *media) {
+  char path[1024];
+  media_path(path, sizeof(path), media->name);
+
+  if (!generate_media(media, BENCH_VIDEO_SECONDS)) {
+    printf("{\"media\": \"%s\", \"error\": \"generate\"}\n", media->name);
+    return;
+  }
+
+  lp_ac_instance inst = create_instance();
+  lp_ac_decoder dec = open_decoder(inst, path, AC_STREAM_TYPE_VIDEO);
+  if (dec == NULL) {
+    printf("{\"media\": \"%s\", \"error\": \"open\"}\n", media->name);
+    close_decoder(inst, dec);
+    ac_free(inst);
+    return;
+  }
+  int width = dec->stream_info.video_info.frame_width;
+  int height = dec->stream_info.video_info.frame_height;
+  int64_t duration = inst->info.duration;
+
+  //Decode and convert every frame
+  int frames = 0;
+  long alloc_start = allocs();
+  int64_t start = now_ns();
+  while (ac_get_frame(inst, dec)) {
+    frames++;
+  }
+  int64_t frame_time = now_ns() - start;
+  long frame_allocs = allocs() - alloc_start;
+  
+  //The decoder times the codec and swscale itself, in microseconds
+  ac_stats stats;
+  ac_get_stats(dec, &stats);
+  close_decoder(inst, dec);
+
+  //Decode every frame without converting it, in batches like when the
+  //playback catches up
+  dec = open_decoder(inst, path, AC_STREAM_TYPE_VIDEO);
+  start = now_ns();
+  while (dec != NULL && ac_skip_frames(inst, dec, BENCH_SKIP_BATCH)) {
+  }
+  int64_t skip_time = now_ns() - start;
+  close_decoder(inst, dec);
+
+  //Seek to random positions and decode the first frame after them. The
+  //positions are the same on every run.
+  int64_t *seek_times = (int64_t*)malloc(sizeof(int64_t) * (seek_count > 0 ? seek_count : 1));
+  int seeks = 0;
+  unsigned int rnd = 12345;
+  dec = open_decoder(inst, path, AC_STREAM_TYPE_VIDEO);
+  int i;
+  for (i = 0; dec != NULL && duration > 0 && i < seek_count; i++) {
+    rnd = rnd * 1103515245 + 12345;
+    int64_t target = (int64_t)((rnd >> 8) % (unsigned int)duration);
+
+    start = now_ns();
+    if (ac_seek(dec, -1, target) && ac_get_frame(inst, dec)) {
+      seek_times[seeks++] = now_ns() - start;
+    }
+  }
+  close_decoder(inst, dec);
+  ac_free(inst);
+  qsort(seek_times, seeks, sizeof(int64_t), compare_int64);
+
+  //Skipping leaves out the frames nobody refers to, so it is cheaper than
+  //decoding each frame
+  double frame_ns = frames > 0 ? (double)frame_time / frames : -1;
+  double decode_ns = stats.frames_decoded > 0 ? stats.decode_time * 1000.0 / stats.frames_decoded : -1;
+  double scale_ns = frames > 0 ? stats.convert_time * 1000.0 / frames : -1;
+  double skip_ns = frames > 0 ? (double)skip_time / frames : -1;
+
+  printf("{\"media\": \"%s\", \"type\": \"video\", \"width\": %d, \"height\": %d, \"duration_ms\": %lld, "
+    "\"frames\": %d, ",
+    media->name, width, height, (long long)duration,
+    frames);
+  print_io(path, AC_STREAM_TYPE_VIDEO, duration);
+  printf("\"decode_fps\": %.1f, \"frame_ns\": %.0f, \"decode_ns\": %.0f, \"swscale_ns\": %.0f, "
+    "\"skip_frame_ns\": %.0f, "
+    "\"seek_count\": %d, \"seek_min_ms\": %.3f, \"seek_p50_ms\": %.3f, \"seek_p90_ms\": %.3f, \"seek_max_ms\": %.3f, "
+    "\"allocs_per_frame\": %.2f}\n",
+    frame_time > 0 ? frames * 1e9 / frame_time : -1, frame_ns, decode_ns, scale_ns,
+    skip_ns,
+    seeks,
+    percentile(seek_times, seeks, 0) / 1e6, percentile(seek_times, seeks, 50) / 1e6,
+    percentile(seek_times, seeks, 90) / 1e6, percentile(seek_times, seeks, 100) / 1e6,
+    BENCH_COUNT_ALLOCS && frames > 0 ? (double)frame_allocs / frames : -1);
+  fflush(stdout);
+  free(seek_times);
+}
+
+static void bench_audio(const bench_media *media) {
+  char path[1024];
+  media_path(path, sizeof(path), media->name);
+
+  if (!generate_media(media, BENCH_AUDIO_SECONDS)) {
+    printf("{\"media\": \"%s\", \"error\": \"generate\"}\n", media->name);
+    return;
+  }
+
+  lp_ac_instance inst = create_instance();
+  lp_ac_decoder dec = open_decoder(inst, path, AC_STREAM_TYPE_AUDIO);
+  if (dec == NULL) {
+    printf("{\"media\": \"%s\", \"error\": \"open\"}\n", media->name);
+    close_decoder(inst, dec);
+    ac_free(inst);
+    return;
+  }
+
+  //Decode the whole file into S16 stereo at 44.1 kHz like the playback does
+  int channels = dec->stream_info.audio_info.channel_count;
+  int rate = dec->stream_info.audio_info.samples_per_second;
+  int64_t duration = inst->info.duration;
+  char *buffer = (char*)malloc(BENCH_AUDIO_FRAMES * channels * 2);
+
+  int64_t sample_frames = 0;
+  int calls = 0;
+  long alloc_start = allocs();
+  int64_t start = now_ns();
+  int count;
+  while ((count = ac_read_audio_frames(inst, dec, buffer, BENCH_AUDIO_FRAMES)) > 0) {
+    sample_frames += count;
+    calls++;
+  }
+  int64_t time = now_ns() - start;
+  long decode_allocs = allocs() - alloc_start;
+
+  free(buffer);
+  close_decoder(inst, dec);
+  ac_free(inst);
+
+  double seconds = rate > 0 ? (double)sample_frames / rate : 0;
+  printf("{\"media\": \"%s\", \"type\": \"audio\", \"sample_rate\": %d, \"channels\": %d, \"sample_frames\": %lld, ",
+    media->name, rate, channels, (long long)sample_frames);
+  print_io(path, AC_STREAM_TYPE_AUDIO, duration);
+  printf("\"realtime_factor\": %.1f, \"sample_frame_ns\": %.2f, \"allocs_per_call\": %.2f}\n",
+    time > 0 ? seconds * 1e9 / time : -1,
+    sample_frames > 0 ? (double)time / sample_frames : -1,
+    BENCH_COUNT_ALLOCS && calls > 0 ? (double)decode_allocs / calls : -1);
+  fflush(stdout);
+}
+
+//
+//--- Pitch analysis ---
+//
+
+static const char *pitch_kernel_names[] = {"auto", "scalar", "sse2", "avx2"};
+
+//The autocorrelation CBuffer.AnalyzeAutocorrelation computed before it was
+//moved into ac_analyze_pitch, all kernels have to return exactly its weights
+static double pitch_reference(const int16_t *samples, int sample_count, int lag) {
+  int64_t dist = 0;
+  int i;
+  for (i = 0; i < sample_count - lag; i++) {
+    int d = samples[i] - samples[i + lag];
+    dist += d < 0 ? -d : d;
+  }
+  return 1 - (double)dist / 32767 / sample_count;
+}
+
+//Fills the channels with noise, full scale square waves, silence and sines,
+//the square waves give the largest possible distances
+static void pitch_signal(int16_t *samples, int sample_count) {
+  int c, i;
+  for (c = 0; c < BENCH_PITCH_CHANNELS; c++) {
+    int16_t *channel = samples + c * sample_count;
+    for (i = 0; i < sample_count; i++) {
+      switch (c) {
+        case 0: channel[i] = (int16_t)(rand() & 0xFFFF); break;
+        case 1: channel[i] = (i / 40) % 2 ? 32767 : -32768; break;
+        case 2: channel[i] = 0; break;
+        default: channel[i] = (int16_t)(30000 * sin(i * 2 * M_PI * 110.0 * c / 44100)); break;
+      }
+    }
+  }
+}
+
+//Returns false if a kernel does not compute the reference weights
+static bool bench_pitch(void) {
+  //The lags of the 47 halftones from C2 on, like CBuffer uses them
+  int lags[BENCH_PITCH_TONES];
+  int i;
+  for (i = 0; i < BENCH_PITCH_TONES; i++) {
+    lags[i] = (int)lround(44100.0 / (65.4064 * pow(1.05946309436, i)));
+  }
+
+  //The window sizes of CBuffer, one with a remainder for the vector loops and
+  //one with blocks of more than 2^16 samples
+  static const int sizes[] = {4096, 8192, 4099, 70000};
+  bool exact = true;
+  int s, k;
+  for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+    int sample_count = sizes[s];
+    int16_t *samples = (int16_t*)malloc(sizeof(int16_t) * sample_count * BENCH_PITCH_CHANNELS);
+    double reference[BENCH_PITCH_CHANNELS * BENCH_PITCH_TONES];
+    double weights[BENCH_PITCH_CHANNELS * BENCH_PITCH_TONES];
+    pitch_signal(samples, sample_count);
+
+    int c, l;
+    for (c = 0; c < BENCH_PITCH_CHANNELS; c++) {
+      for (l = 0; l < BENCH_PITCH_TONES; l++) {
+        reference[c * BENCH_PITCH_TONES + l] = pitch_reference(samples + c * sample_count, sample_count, lags[l]);
+      }
+    }
+
+    for (k = AC_PITCH_SCALAR; k <= AC_PITCH_AVX2; k++) {
+      if (!ac_set_pitch_kernel((ac_pitch_kernel)k)) {
+        continue;
+      }
+
+      int64_t times[BENCH_PITCH_RUNS];
+      int run;
+      for (run = 0; run < BENCH_PITCH_RUNS; run++) {
+        int64_t start = now_ns();
+        ac_analyze_pitch(samples, sample_count, BENCH_PITCH_CHANNELS, lags, BENCH_PITCH_TONES, weights);
+        times[run] = now_ns() - start;
+      }
+      qsort(times, BENCH_PITCH_RUNS, sizeof(int64_t), compare_int64);
+
+      bool same = memcmp(weights, reference, sizeof(weights)) == 0;
+      exact = exact && same;
+      printf("{\"pitch_kernel\": \"%s\", \"samples\": %d, \"channels\": %d, \"exact\": %s, \"batch_us\": %.1f}\n",
+        pitch_kernel_names[k], sample_count, BENCH_PITCH_CHANNELS, same ? "true" : "false",
+        percentile(times, BENCH_PITCH_RUNS, 50) / 1000);
+    }
+    free(samples);
+  }
+  fflush(stdout);
+
+  ac_set_pitch_kernel(AC_PITCH_AUTO);
+  return exact;
+}
+
+int main(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+      work_dir = argv[++i];
+    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      ffmpeg_exe = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seek_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-q") == 0) {
+      quick = true;
+    } else if (strcmp(argv[i], "-p") == 0) {
+      pitch_only = true;
+    } else {
+      fprintf(stderr, "usage: acbench [-d work directory] [-f ffmpeg executable] [-s seek count] [-q] [-p]\n");
+      return 2;
+    }
+  }
+
+  if (pitch_only) {
+    return bench_pitch() ? 0 : 1;
+  }
+
+#ifdef _WIN32
+  mkdir(work_dir);
+#else
+  mkdir(work_dir, 0755);
+#endif
+
+  for (i = 0; i < (int)(sizeof(video_media) / sizeof(video_media[0])); i++) {
+    if (!quick || video_media[i].quick) {
+      bench_video(&video_media[i]);
+    }
+  }
+  for (i = 0; i < (int)(sizeof(audio_media) / sizeof(audio_media[0])); i++) {
+    if (!quick || audio_media[i].quick) {
+      bench_audio(&audio_media[i]);
+    }
+  }
+
+  return 0;
+}
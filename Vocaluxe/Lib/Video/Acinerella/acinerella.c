@@ -17,13 +17,36 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include "acinerella.h"
 #include <libavformat/avformat.h>
 #include <libavformat/avio.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
+#include <libavutil/audioconvert.h>
 #include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
 #include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+//The pitch analysis has vectorized kernels for x86 processors, the processor is
+//checked at runtime
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define AC_PITCH_X86 1
+#include <immintrin.h>
+#endif
 
 #define AUDIO_BUFFER_BASE_SIZE AVCODEC_MAX_AUDIO_FRAME_SIZE
 
@@ -35,6 +58,48 @@
 //It contains data needed by FFMpeg.
 
 #define AC_BUFSIZE 1024*64
+//The IO buffer of mapped files only stages small reads, larger reads are copied
+//from the mapping directly into ffmpeg's destination buffer
+#define AC_MAP_BUFSIZE 1024*4
+
+//Maximum number of threads a video decoder uses if the count is chosen automatically
+#define AC_MAX_AUTO_THREADS 4
+
+//Magic and version of the stream info cache entries
+#define AC_CACHE_MAGIC 0x43494341
+#define AC_CACHE_VERSION 2
+
+//Reference counts of pooled frames are changed by the decoding thread and the
+//threads which release the frames
+#define ac_atomic_inc(p) __sync_add_and_fetch((p), 1)
+#define ac_atomic_dec(p) __sync_sub_and_fetch((p), 1)
+
+//Number of frames the decode ahead skips at once if it falls behind
+#define AC_AHEAD_DROP_COUNT 3
+
+//Performance counters of a decoder, all decoder records start alike
+#define ac_decoder_stats(p) (&((lp_ac_decoder_data)(p))->stats)
+
+//Number of priority classes of the decode scheduler
+#define AC_PRIORITY_COUNT 3
+
+//States of a task of the decode scheduler
+#define AC_TASK_IDLE 0
+#define AC_TASK_QUEUED 1
+#define AC_TASK_RUNNING 2
+
+//States of the loop cache of a decode ahead
+#define AC_LOOP_CACHE_NONE 0
+#define AC_LOOP_CACHE_FILLING 1
+#define AC_LOOP_CACHE_COMPLETE 2
+#define AC_LOOP_CACHE_FAILED 3
+
+//Highest level of the automatic discard mode and the number of late or early
+//frames in a row after which the level is raised or lowered. Lowering is slow,
+//so the level does not flip back and forth while the decoder is at its limit.
+#define AC_DISCARD_MAX_LEVEL 3
+#define AC_DISCARD_RAISE_FRAMES 5
+#define AC_DISCARD_LOWER_FRAMES 100
 
 struct _ac_data {
   ac_instance instance;
@@ -48,6 +113,34 @@ struct _ac_data {
   ac_openclose_callback close_proc; 
 
   void* buffer; 
+  AVIOContext *pIo;
+  
+  //Package records which have been freed and are reused by ac_read_package
+  struct _ac_package_data *free_packages;
+  
+  //Per stream package queues of the shared demux mode, NULL until the first
+  //decoder is created. The mutex guards the queues, the free list and the
+  //format context as soon as the instance is shared.
+  struct _ac_package_queue *queues;
+  int queue_count;
+  pthread_mutex_t demux_mutex;
+  
+  //Native file input (ac_open_file), -1 if the callbacks are used
+  int fd;
+  int64_t file_size;
+  int64_t file_pos;
+  
+  //Memory mapped file input (ac_open_mapped), NULL if the file is not mapped
+  uint8_t *map;
+#ifdef _WIN32
+  HANDLE map_handle;
+#endif
+  
+  //Counters of the demuxer, only the read and queue fields are used
+  ac_stats stats;
+  
+  //Set by ac_open_async_cancel, lets the reads and ffmpeg give up
+  volatile int aborted;
 };
 
 typedef struct _ac_data ac_data;
@@ -57,20 +150,153 @@ struct _ac_decoder_data {
   ac_decoder decoder;
   int sought;
   double last_timecode;
+  ac_stats stats;
 };
 
 typedef struct _ac_decoder_data ac_decoder_data;
 typedef ac_decoder_data* lp_ac_decoder_data;
 
+//A frame of the frame pool. The pool itself holds one reference on each frame,
+//so a frame with a reference count of one is free for the decoder again.
+struct _ac_frame_data {
+  ac_frame frame;
+  volatile int refcount;
+  AVFrame *pPicture;
+};
+
+typedef struct _ac_frame_data ac_frame_data;
+typedef ac_frame_data* lp_ac_frame_data;
+
+//Keyframe of a video stream, the timestamp is in the time base of the stream
+//and the position is the byte offset in the file or -1 if unknown
+struct _ac_keyframe {
+  int64_t pts;
+  int64_t pos;
+};
+
+typedef struct _ac_keyframe ac_keyframe;
+
+//Does one unit of work of a task of the decode scheduler, returns nonzero if
+//there is more to do right away
+typedef int (*ac_task_proc)(void *param);
+
+//Task of the decode scheduler. All fields but param and proc are guarded by
+//the scheduler mutex.
+struct _ac_task {
+  ac_task_proc proc;
+  void *param;
+  int priority;
+  int state;
+  //Set if the task is scheduled again while it runs
+  int rerun;
+  int cancelled;
+  struct _ac_task *next;
+};
+
+typedef struct _ac_task ac_task;
+typedef ac_task* lp_ac_task;
+
+//One decoded frame in the ring of the decode ahead. The time includes
+//the length of the passes already played when looping.
+struct _ac_ahead_entry {
+  lp_ac_frame_data pFrame;
+  double time;
+  int generation;
+};
+
+typedef struct _ac_ahead_entry ac_ahead_entry;
+
+//State of the decode ahead of a video decoder. The ring is only written by the
+//task of the decode scheduler and only read by the thread calling
+//ac_get_frame_at. The mutex guards the seek requests, the task is scheduled
+//whenever there is something to do and stops while the ring is full.
+struct _ac_decode_ahead {
+  ac_task task;
+  pthread_mutex_t mutex;
+  
+  ac_ahead_entry *ring;
+  unsigned int ring_size;
+  volatile unsigned int head;
+  volatile unsigned int tail;
+  
+  //Frames of older generations have been decoded before the last seek
+  volatile int generation;
+  int decode_generation;
+  
+  volatile int terminated;
+  volatile int seek_pending;
+  double seek_time;
+  volatile int loop;
+  volatile int eof;
+  //Set if a whole pass did not return any frame, looping stops then
+  volatile int stalled;
+  int pass_frames;
+  
+  //Presentation time of the last ac_get_frame_at call, used to catch up
+  volatile double time;
+  double last_time;
+  //Frame found by the last seek, pushed as soon as the ring has space
+  lp_ac_frame pending;
+  double loop_offset;
+  double frame_duration;
+  
+  //Loop cache, holds a reference on each frame of a whole pass from the start
+  //of the video. Once it is complete, the following passes and seeks are
+  //played from it without reading or decoding anything.
+  int cache_state;
+  lp_ac_frame_data *cache;
+  int cache_count;
+  int cache_capacity;
+  int64_t cache_bytes;
+  //Set while the frames are taken from the cache, the next one to push
+  int replaying;
+  int replay_pos;
+};
+
+typedef struct _ac_decode_ahead ac_decode_ahead;
+typedef ac_decode_ahead* lp_ac_decode_ahead;
+
 struct _ac_video_decoder {
   ac_decoder decoder;
   int sought;
   double last_timecode;
+  ac_stats stats;
   AVCodec *pCodec;
   AVCodecContext *pCodecCtx;
   AVFrame *pFrame;
   AVFrame *pFrameRGB; 
   struct SwsContext *pSwsCtx;  
+  //Frame pool, only used if the instance has a frame_pool_size
+  int use_pool;
+  lp_ac_frame_data *pool;
+  int pool_count;
+  //The last converted frame, referenced by the decoder
+  lp_ac_frame_data current;
+  //Decode ahead thread, NULL if the decoder is used directly
+  lp_ac_decode_ahead ahead;
+  //Keyframe index, see ac_build_keyframe_index
+  ac_keyframe *keyframes;
+  int keyframe_count;
+  int keyframe_capacity;
+  int keyframes_built;
+  int keyframes_scanned;
+  //Frames which have been converted or handed out, the others were dropped
+  int64_t frames_converted;
+  //Discard levels set by ac_set_discard, the decoding thread applies them
+  //together with the automatic level and the catch up mode before each package
+  volatile int skip_frame;
+  volatile int skip_loop_filter;
+  volatile int skip_idct;
+  volatile int auto_discard;
+  int auto_level;
+  int late_count;
+  int early_count;
+  int catch_up;
+  //Budget of the loop cache set by ac_set_loop_cache, zero disables it
+  volatile int64_t loop_cache_size;
+  volatile double loop_cache_duration;
+  //Priority class of the decode ahead, see ac_set_decode_priority
+  int priority;
 };
 
 typedef struct _ac_video_decoder ac_video_decoder;
@@ -80,11 +306,28 @@ struct _ac_audio_decoder {
   ac_decoder decoder;
   int sought;
   double last_timecode;
-  uint8_t *tmp_data;
-  int tmp_data_length;
+  ac_stats stats;
   int max_buffer_size;
   AVCodec *pCodec;
   AVCodecContext *pCodecCtx;
+  AVFrame *pFrame;
+  //Conversion of the decoded samples into the output format, the resampler is
+  //(re)created when the format of the decoded samples changes
+  struct SwrContext *pSwrCtx;
+  enum AVSampleFormat in_fmt;
+  int in_rate;
+  int in_channels;
+  enum AVSampleFormat out_fmt;
+  int out_rate;
+  int out_channels;
+  //Decoded samples which have not been returned by ac_read_audio_frames yet
+  uint8_t *carry;
+  int carry_size;
+  int carry_pos;
+  int carry_capacity;
+  //Time of the first and behind the last sample in the carry buffer
+  double carry_time;
+  double carry_end;
 };
 
 typedef struct _ac_audio_decoder ac_audio_decoder;
@@ -94,11 +337,92 @@ struct _ac_package_data {
   ac_package package;
   AVPacket ffpackage;
   int pts;
+  //The instance whose free list the package returns to
+  struct _ac_data *owner;
+  struct _ac_package_data *next;
 };
 
 typedef struct _ac_package_data ac_package_data;
 typedef ac_package_data* lp_ac_package_data;
 
+//Packages of one stream which have been read while another stream was looked
+//for. Only streams with a decoder collect packages.
+struct _ac_package_queue {
+  lp_ac_package_data first;
+  lp_ac_package_data last;
+  int count;
+  int active;
+  //Dts of the last package handed to the decoder. When another decoder seeks,
+  //the packages up to it are dropped, so the stream continues where it was.
+  int64_t last_dts;
+  int64_t skip_until;
+  //Set when the queue overflowed, its packages are dropped until a keyframe
+  int resync;
+};
+
+//Most packages queued for one stream in the shared demux mode. A decoder which
+//does not read for a while loses its queue instead of filling the memory.
+#define AC_MAX_QUEUED_PACKAGES 512
+
+typedef struct _ac_package_queue ac_package_queue;
+
+//Allocator of the package records, see ac_set_package_allocator
+static ac_malloc_callback package_malloc = NULL;
+static ac_free_callback package_free = NULL;
+
+//Directory of the stream info cache, see ac_set_info_cache
+static char *info_cache_dir = NULL;
+
+//Header of a stream info cache entry. It is followed by the path of the media
+//file, one ac_cache_stream record per stream and the extradata of the streams.
+struct _ac_cache_header {
+  int magic;
+  int version;
+  int64_t file_size;
+  int64_t file_mtime;
+  int path_length;
+  int stream_count;
+  char format[32];
+  int64_t start_time;
+  int64_t duration;
+};
+
+typedef struct _ac_cache_header ac_cache_header;
+
+//What avformat_find_stream_info found out about a stream
+struct _ac_cache_stream {
+  int codec_type;
+  int codec_id;
+  AVRational time_base;
+  int64_t start_time;
+  int64_t duration;
+  int64_t nb_frames;
+  AVRational r_frame_rate;
+  AVRational avg_frame_rate;
+  int width;
+  int height;
+  int pix_fmt;
+  AVRational sample_aspect_ratio;
+  int sample_rate;
+  int channels;
+  int sample_fmt;
+  uint64_t channel_layout;
+  int bit_rate;
+  unsigned int codec_tag;
+  int has_b_frames;
+  int bits_per_coded_sample;
+  int block_align;
+  int frame_size;
+  int profile;
+  int level;
+  int extradata_size;
+};
+
+typedef struct _ac_cache_stream ac_cache_stream;
+
+//Largest extradata of a stream which is cached
+#define AC_CACHE_MAX_EXTRADATA (1<<20)
+
 //
 //--- Initialization and Stream opening---
 //
@@ -108,15 +432,41 @@ void init_info(lp_ac_file_info info)
   info->duration = -1;
 }
 
+//Lets ffmpeg guard the opening and closing of codecs, which may happen on
+//several threads at once
+static int ac_lock_manager(void **mutex, enum AVLockOp op)
+{
+  switch (op) {
+    case AV_LOCK_CREATE:
+      *mutex = av_malloc(sizeof(pthread_mutex_t));
+      if (*mutex == NULL) return 1;
+      pthread_mutex_init((pthread_mutex_t*)*mutex, NULL);
+      return 0;
+    case AV_LOCK_OBTAIN:
+      return pthread_mutex_lock((pthread_mutex_t*)*mutex) != 0;
+    case AV_LOCK_RELEASE:
+      return pthread_mutex_unlock((pthread_mutex_t*)*mutex) != 0;
+    case AV_LOCK_DESTROY:
+      pthread_mutex_destroy((pthread_mutex_t*)*mutex);
+      av_freep(mutex);
+      return 0;
+  }
+  return 1;
+}
+
 int av_initialized = 0;
+static pthread_mutex_t av_init_mutex = PTHREAD_MUTEX_INITIALIZER;
 void ac_init_ffmpeg()
 {
+  pthread_mutex_lock(&av_init_mutex);
   if(!av_initialized)
   {
     avcodec_register_all();
     av_register_all();
+    av_lockmgr_register(ac_lock_manager);
     av_initialized = 1;
   }
+  pthread_mutex_unlock(&av_init_mutex);
 }
 
 lp_ac_instance CALL_CONVT ac_init(void) { 
@@ -131,16 +481,30 @@ lp_ac_instance CALL_CONVT ac_init(void) {
   
   ptmp->instance.opened = 0;
   ptmp->instance.stream_count = 0;
+  ptmp->fd = -1;
   ptmp->instance.output_format = AC_OUTPUT_RGBA32;
+  ptmp->instance.thread_count = 0;
+  ptmp->instance.thread_type = AC_THREAD_AUTO;
+  ptmp->instance.frame_pool_size = 0;
+  ptmp->instance.shared_demux = 0;
+  ptmp->instance.audio_output_format = AC_AUDIO_S16;
+  ptmp->instance.audio_sample_rate = 0;
+  ptmp->instance.audio_channel_count = 0;
+  pthread_mutex_init(&ptmp->demux_mutex, NULL);
   init_info(&(ptmp->instance.info));
   return (lp_ac_instance)ptmp;  
 }
 
+static void ac_free_package_list(lp_ac_data self);
+static void ac_free_queues(lp_ac_data self);
+
 void CALL_CONVT ac_free(lp_ac_instance pacInstance) {
   //Close the decoder. If it is already closed, this won't be a problem as ac_close checks the streams state
   ac_close(pacInstance);
   
   if (pacInstance != NULL) {
+    ac_free_package_list((lp_ac_data)pacInstance);
+    pthread_mutex_destroy(&((lp_ac_data)pacInstance)->demux_mutex);
     av_free((lp_ac_data)pacInstance);
   }
 }
@@ -167,6 +531,481 @@ static int64_t io_seek(void *opaque, int64_t pos, int whence)
   return -1;
 }
 
+//
+//--- Native file input ---
+//
+
+static int file_open(const char *filename)
+{
+#ifdef _WIN32
+  //The filename is passed as UTF-8, the windows file API needs UTF-16
+  wchar_t wfilename[MAX_PATH];
+  if (MultiByteToWideChar(CP_UTF8, 0, filename, -1, wfilename, MAX_PATH) == 0) {
+    return -1;
+  }
+  return _wopen(wfilename, _O_RDONLY | _O_BINARY);
+#else
+  return open(filename, O_RDONLY);
+#endif
+}
+
+static int64_t file_get_size(int fd)
+{
+#ifdef _WIN32
+  struct _stati64 st;
+  if (_fstati64(fd, &st) < 0) return -1;
+#else
+  struct stat st;
+  if (fstat(fd, &st) < 0) return -1;
+#endif
+  return st.st_size;
+}
+
+static int file_pread(int fd, uint8_t *buf, int size, int64_t pos)
+{
+#ifdef _WIN32
+  if (_lseeki64(fd, pos, SEEK_SET) < 0) return -1;
+  return _read(fd, buf, size);
+#else
+  return pread(fd, buf, size, pos);
+#endif
+}
+
+static int64_t file_get_mtime(int fd)
+{
+#ifdef _WIN32
+  struct _stati64 st;
+  if (_fstati64(fd, &st) < 0) return -1;
+#else
+  struct stat st;
+  if (fstat(fd, &st) < 0) return -1;
+#endif
+  return (int64_t)st.st_mtime;
+}
+
+static void file_close(int fd)
+{
+#ifdef _WIN32
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+static int file_read(void *opaque, uint8_t *buf, int buf_size)
+{
+  lp_ac_data self = (lp_ac_data)opaque;
+  if (self->aborted) {
+    return AVERROR_EXIT;
+  }
+  
+  //Read at our own file position, so seeking never needs a system call
+  int read = file_pread(self->fd, buf, buf_size, self->file_pos);
+  if (read > 0) {
+    self->file_pos += read;
+  }
+  return read;
+}
+
+static int64_t file_seek(void *opaque, int64_t pos, int whence)
+{
+  lp_ac_data self = (lp_ac_data)opaque;
+  
+  switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET: self->file_pos = pos; break;
+    case SEEK_CUR: self->file_pos += pos; break;
+    case SEEK_END: self->file_pos = self->file_size + pos; break;
+    case AVSEEK_SIZE: return self->file_size;
+    default: return -1;
+  }
+  
+  return self->file_pos;
+}
+
+static uint8_t* file_map(lp_ac_data self)
+{
+  //Mapping huge files may exceed the address space of 32 bit builds
+  if ((self->file_size <= 0) || ((uint64_t)self->file_size > (uint64_t)SIZE_MAX)) {
+    return NULL;
+  }
+  
+#ifdef _WIN32
+  self->map_handle = CreateFileMapping((HANDLE)_get_osfhandle(self->fd),
+    NULL, PAGE_READONLY, 0, 0, NULL);
+  if (self->map_handle == NULL) return NULL;
+  
+  uint8_t *map = (uint8_t*)MapViewOfFile(self->map_handle, FILE_MAP_READ, 0, 0, 0);
+  if (map == NULL) {
+    CloseHandle(self->map_handle);
+    self->map_handle = NULL;
+  }
+  return map;
+#else
+  void *map = mmap(NULL, (size_t)self->file_size, PROT_READ, MAP_PRIVATE, self->fd, 0);
+  if (map == MAP_FAILED) return NULL;
+  return (uint8_t*)map;
+#endif
+}
+
+static void file_unmap(lp_ac_data self)
+{
+#ifdef _WIN32
+  UnmapViewOfFile(self->map);
+  CloseHandle(self->map_handle);
+  self->map_handle = NULL;
+#else
+  munmap(self->map, (size_t)self->file_size);
+#endif
+  self->map = NULL;
+}
+
+static int map_read(void *opaque, uint8_t *buf, int buf_size)
+{
+  lp_ac_data self = (lp_ac_data)opaque;
+  if (self->aborted) {
+    return AVERROR_EXIT;
+  }
+  
+  //Serve the data straight from the mapping, file_seek only moves the position
+  int64_t remaining = self->file_size - self->file_pos;
+  if (remaining <= 0) return 0;
+  if (buf_size > remaining) buf_size = (int)remaining;
+  
+  memcpy(buf, self->map + self->file_pos, buf_size);
+  self->file_pos += buf_size;
+  return buf_size;
+}
+
+//Seek callback of the zero copy mapping. The whole file is the buffer of the
+//IO-Context, so ffmpeg seeks inside the buffer and only asks for the size here.
+static int64_t map_seek(void *opaque, int64_t pos, int whence)
+{
+  lp_ac_data self = (lp_ac_data)opaque;
+  if (whence & AVSEEK_SIZE) {
+    return self->file_size;
+  }
+  
+  //Seeking outside of the file would make ffmpeg drop the buffer
+  return -1;
+}
+
+//Returns whether the IO-Context reads straight from the mapping
+static bool ac_io_is_mapped(lp_ac_data self)
+{
+  return self->map != NULL && self->pIo != NULL && self->pIo->buffer == self->map;
+}
+
+//Frees the IO-Context and its buffer. The buffer is taken from the IO-Context,
+//as ffmpeg may have replaced the buffer we gave it.
+static void ac_free_io(lp_ac_data self)
+{
+  if (self->pIo) {
+    if (!ac_io_is_mapped(self)) {
+      av_free(self->pIo->buffer);
+    }
+    av_free(self->pIo);
+    self->pIo = NULL;
+  } else if (self->buffer) {
+    av_free(self->buffer);
+  }
+  self->buffer = NULL;
+  
+  if (self->map) {
+    file_unmap(self);
+  }
+  if (self->fd >= 0) {
+    file_close(self->fd);
+    self->fd = -1;
+  }
+}
+
+//
+//--- Stream info cache ---
+//
+
+void CALL_CONVT ac_set_info_cache(const char *directory)
+{
+  av_freep(&info_cache_dir);
+  if (directory != NULL && directory[0] != 0) {
+    info_cache_dir = av_strdup(directory);
+  }
+}
+
+static FILE* cache_fopen(const char *filename, const wchar_t *wmode, const char *mode)
+{
+#ifdef _WIN32
+  wchar_t wfilename[MAX_PATH];
+  if (MultiByteToWideChar(CP_UTF8, 0, filename, -1, wfilename, MAX_PATH) == 0) {
+    return NULL;
+  }
+  return _wfopen(wfilename, wmode);
+#else
+  return fopen(filename, mode);
+#endif
+}
+
+static int cache_rename(const char *from, const char *to)
+{
+#ifdef _WIN32
+  wchar_t wfrom[MAX_PATH], wto[MAX_PATH];
+  if (MultiByteToWideChar(CP_UTF8, 0, from, -1, wfrom, MAX_PATH) == 0 ||
+      MultiByteToWideChar(CP_UTF8, 0, to, -1, wto, MAX_PATH) == 0) {
+    return -1;
+  }
+  return MoveFileExW(wfrom, wto, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+  return rename(from, to);
+#endif
+}
+
+//Returns the name of the cache entry of a media file, the entries are named
+//by a FNV-1a hash of the path
+static char* ac_cache_entry_name(const char *filename)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  const unsigned char *c;
+  for (c = (const unsigned char*)filename; *c; c++) {
+    hash ^= *c;
+    hash *= 1099511628211ULL;
+  }
+  
+  int length = strlen(info_cache_dir) + 32;
+  char *name = (char*)av_malloc(length);
+  if (name != NULL) {
+    snprintf(name, length, "%s/%08x%08x.acinfo", info_cache_dir,
+      (unsigned int)(hash >> 32), (unsigned int)hash);
+  }
+  return name;
+}
+
+//Reads the cache entry of the opened file. Returns NULL if there is none or if
+//the file has been changed since the entry was written. The extradata of the
+//streams follows the records in the returned memory.
+static ac_cache_stream* ac_cache_load(lp_ac_data self, const char *filename, ac_cache_header *header)
+{
+  char *name = ac_cache_entry_name(filename);
+  if (name == NULL) {
+    return NULL;
+  }
+  FILE *f = cache_fopen(name, L"rb", "rb");
+  av_free(name);
+  if (f == NULL) {
+    return NULL;
+  }
+  
+  ac_cache_stream *streams = NULL;
+  int path_length = strlen(filename);
+  if (fread(header, sizeof(ac_cache_header), 1, f) == 1 &&
+      header->magic == AC_CACHE_MAGIC &&
+      header->version == AC_CACHE_VERSION &&
+      header->file_size == self->file_size &&
+      header->file_mtime == file_get_mtime(self->fd) &&
+      header->path_length == path_length &&
+      header->stream_count > 0 && header->stream_count < 1024) {
+    //Another file with the same hash does not match the path
+    char *path = (char*)av_malloc(path_length);
+    streams = (ac_cache_stream*)av_malloc(header->stream_count * sizeof(ac_cache_stream));
+    if (path == NULL || streams == NULL ||
+        fread(path, path_length, 1, f) != 1 ||
+        memcmp(path, filename, path_length) != 0 ||
+        fread(streams, sizeof(ac_cache_stream), header->stream_count, f) != header->stream_count) {
+      av_freep(&streams);
+    }
+    av_free(path);
+    
+    //Append the extradata of all streams to the records
+    int64_t extradata_size = 0;
+    int i;
+    for (i = 0; streams != NULL && i < header->stream_count; i++) {
+      if (streams[i].extradata_size < 0 || streams[i].extradata_size > AC_CACHE_MAX_EXTRADATA) {
+        av_freep(&streams);
+      } else {
+        extradata_size += streams[i].extradata_size;
+      }
+    }
+    if (streams != NULL && extradata_size > 0) {
+      int records_size = header->stream_count * sizeof(ac_cache_stream);
+      ac_cache_stream *tmp = (ac_cache_stream*)av_realloc(streams, records_size + extradata_size);
+      if (tmp == NULL || fread((uint8_t*)tmp + records_size, extradata_size, 1, f) != 1) {
+        av_free(tmp != NULL ? tmp : streams);
+        tmp = NULL;
+      }
+      streams = tmp;
+    }
+  }
+  
+  fclose(f);
+  return streams;
+}
+
+//Writes what avformat_find_stream_info found out about the opened file into
+//its cache entry. The entry is written to a temporary file first, so readers
+//never see a partial entry.
+static void ac_cache_store(lp_ac_data self, const char *filename)
+{
+  //Streams of formats without a header are only found while reading, so only
+  //avformat_find_stream_info knows their codec parameters
+  AVFormatContext *ctx = self->pFormatCtx;
+  if (ctx->nb_streams == 0 || ctx->iformat == NULL || (ctx->ctx_flags & AVFMTCTX_NOHEADER) ||
+      strlen(ctx->iformat->name) >= sizeof(((ac_cache_header*)0)->format)) {
+    return;
+  }
+  
+  ac_cache_header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = AC_CACHE_MAGIC;
+  header.version = AC_CACHE_VERSION;
+  header.file_size = self->file_size;
+  header.file_mtime = file_get_mtime(self->fd);
+  header.path_length = strlen(filename);
+  header.stream_count = ctx->nb_streams;
+  strcpy(header.format, ctx->iformat->name);
+  header.start_time = ctx->start_time;
+  header.duration = ctx->duration;
+  
+  char *name = ac_cache_entry_name(filename);
+  if (name == NULL) {
+    return;
+  }
+  int length = strlen(name) + 32;
+  char *tmp_name = (char*)av_malloc(length);
+  if (tmp_name == NULL) {
+    av_free(name);
+    return;
+  }
+  snprintf(tmp_name, length, "%s.%p", name, (void*)self);
+  
+  FILE *f = cache_fopen(tmp_name, L"wb", "wb");
+  if (f != NULL) {
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+      fwrite(filename, header.path_length, 1, f) == 1;
+      
+    unsigned int i;
+    for (i = 0; ok && i < ctx->nb_streams; i++) {
+      AVStream *pStream = ctx->streams[i];
+      AVCodecContext *pCodecCtx = pStream->codec;
+      
+      ac_cache_stream stream;
+      memset(&stream, 0, sizeof(stream));
+      stream.codec_type = pCodecCtx->codec_type;
+      stream.codec_id = pCodecCtx->codec_id;
+      stream.time_base = pStream->time_base;
+      stream.start_time = pStream->start_time;
+      stream.duration = pStream->duration;
+      stream.nb_frames = pStream->nb_frames;
+      stream.r_frame_rate = pStream->r_frame_rate;
+      stream.avg_frame_rate = pStream->avg_frame_rate;
+      stream.width = pCodecCtx->width;
+      stream.height = pCodecCtx->height;
+      stream.pix_fmt = pCodecCtx->pix_fmt;
+      stream.sample_aspect_ratio = pCodecCtx->sample_aspect_ratio;
+      stream.sample_rate = pCodecCtx->sample_rate;
+      stream.channels = pCodecCtx->channels;
+      stream.sample_fmt = pCodecCtx->sample_fmt;
+      stream.channel_layout = pCodecCtx->channel_layout;
+      stream.bit_rate = pCodecCtx->bit_rate;
+      stream.codec_tag = pCodecCtx->codec_tag;
+      stream.has_b_frames = pCodecCtx->has_b_frames;
+      stream.bits_per_coded_sample = pCodecCtx->bits_per_coded_sample;
+      stream.block_align = pCodecCtx->block_align;
+      stream.frame_size = pCodecCtx->frame_size;
+      stream.profile = pCodecCtx->profile;
+      stream.level = pCodecCtx->level;
+      if (pCodecCtx->extradata != NULL && pCodecCtx->extradata_size > 0) {
+        stream.extradata_size = pCodecCtx->extradata_size;
+      }
+      
+      //Files with huge extradata are not worth caching
+      ok = stream.extradata_size <= AC_CACHE_MAX_EXTRADATA &&
+        fwrite(&stream, sizeof(stream), 1, f) == 1;
+    }
+    
+    for (i = 0; ok && i < ctx->nb_streams; i++) {
+      AVCodecContext *pCodecCtx = ctx->streams[i]->codec;
+      if (pCodecCtx->extradata != NULL && pCodecCtx->extradata_size > 0) {
+        ok = fwrite(pCodecCtx->extradata, pCodecCtx->extradata_size, 1, f) == 1;
+      }
+    }
+    
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || cache_rename(tmp_name, name) != 0) {
+      remove(tmp_name);
+    }
+  }
+  
+  av_free(tmp_name);
+  av_free(name);
+}
+
+//Restores the stream information of a cache entry after the file has been
+//opened with the cached input format. Returns false if the streams the
+//demuxer found do not match the entry.
+static bool ac_cache_apply(lp_ac_data self, ac_cache_header *header, ac_cache_stream *streams)
+{
+  AVFormatContext *ctx = self->pFormatCtx;
+  if (ctx->nb_streams != header->stream_count) {
+    return false;
+  }
+  
+  unsigned int i;
+  for (i = 0; i < ctx->nb_streams; i++) {
+    AVStream *pStream = ctx->streams[i];
+    if (pStream->codec->codec_type != streams[i].codec_type ||
+        pStream->time_base.num != streams[i].time_base.num ||
+        pStream->time_base.den != streams[i].time_base.den) {
+      return false;
+    }
+  }
+  
+  uint8_t *extradata = (uint8_t*)(streams + ctx->nb_streams);
+  for (i = 0; i < ctx->nb_streams; i++) {
+    AVStream *pStream = ctx->streams[i];
+    AVCodecContext *pCodecCtx = pStream->codec;
+    ac_cache_stream *stream = &streams[i];
+    
+    //Extradata the demuxer has read from the header is kept, otherwise it was
+    //found by avformat_find_stream_info
+    if (stream->extradata_size > 0 && pCodecCtx->extradata == NULL) {
+      pCodecCtx->extradata = (uint8_t*)av_mallocz(stream->extradata_size + FF_INPUT_BUFFER_PADDING_SIZE);
+      if (pCodecCtx->extradata == NULL) {
+        return false;
+      }
+      memcpy(pCodecCtx->extradata, extradata, stream->extradata_size);
+      pCodecCtx->extradata_size = stream->extradata_size;
+    }
+    extradata += stream->extradata_size;
+    if (pCodecCtx->codec_tag == 0) {
+      pCodecCtx->codec_tag = stream->codec_tag;
+    }
+    
+    pStream->start_time = stream->start_time;
+    pStream->duration = stream->duration;
+    pStream->nb_frames = stream->nb_frames;
+    pStream->r_frame_rate = stream->r_frame_rate;
+    pStream->avg_frame_rate = stream->avg_frame_rate;
+    pCodecCtx->codec_id = stream->codec_id;
+    pCodecCtx->width = stream->width;
+    pCodecCtx->height = stream->height;
+    pCodecCtx->pix_fmt = stream->pix_fmt;
+    pCodecCtx->sample_aspect_ratio = stream->sample_aspect_ratio;
+    pCodecCtx->sample_rate = stream->sample_rate;
+    pCodecCtx->channels = stream->channels;
+    pCodecCtx->sample_fmt = stream->sample_fmt;
+    pCodecCtx->channel_layout = stream->channel_layout;
+    pCodecCtx->bit_rate = stream->bit_rate;
+    pCodecCtx->has_b_frames = stream->has_b_frames;
+    pCodecCtx->bits_per_coded_sample = stream->bits_per_coded_sample;
+    pCodecCtx->block_align = stream->block_align;
+    pCodecCtx->frame_size = stream->frame_size;
+    pCodecCtx->profile = stream->profile;
+    pCodecCtx->level = stream->level;
+  }
+  
+  ctx->start_time = header->start_time;
+  ctx->duration = header->duration;
+  return true;
+}
+
 lp_ac_proberesult CALL_CONVT ac_probe_input_buffer(
   void* buf,
   int bufsize,
@@ -227,38 +1066,124 @@ AVInputFormat* ac_probe_input_stream(
        probe_size<<=1) {    
     int score = AVPROBE_SCORE_MAX / 4;
         
-    //Allocate some memory for the current probe buffer
-    void* tmp_buf = av_malloc(probe_size); //Unaligned memory would also be ok here
-	memset(tmp_buf, 0, probe_size); 
-        
-    //Copy the old data to the new buffer
-    if (*buf) {
-      memcpy(tmp_buf, *buf, *buf_read);      
-      //Free the old data memory
-      av_free(*buf);      
-    }    
-
-    //Read the new data 
+    //Grow the probe buffer, the bytes read before are kept
+    void* tmp_buf = av_realloc(*buf, probe_size); //Unaligned memory would also be ok here
+    if (!tmp_buf) {
+      break;
+    }
+    *buf = tmp_buf;
+
+    //Only read the new data 
     void* write_ptr = tmp_buf + *buf_read;
     int read_size = probe_size - *buf_read;
-    int size;
-    if (size = read_proc(sender, write_ptr, read_size) < read_size) {
+    int size = read_proc(sender, write_ptr, read_size);
+    if (size < read_size) {
       last_iteration = 1;
-      probe_size = *buf_read + size;
+      probe_size = *buf_read + (size > 0 ? size : 0);
     }
+    *buf_read = probe_size;
     
     //Probe it
     fmt = (AVInputFormat*)ac_probe_input_buffer(tmp_buf, probe_size, filename, &score);
-
-    //Set the new buffer
-    *buf = tmp_buf;
-    *buf_read = probe_size;
   }
   
   //Return the result
   return fmt;
 }
 
+//Probes the format of a mapped file with growing sizes, like ffmpeg does when
+//probing an IO-Context
+static AVInputFormat* ac_probe_mapping(lp_ac_data self, const char *filename)
+{
+  AVInputFormat *fmt = NULL;
+  int probe_size;
+  for (probe_size = PROBE_BUF_MIN; !fmt; probe_size <<= 1) {
+    bool last = probe_size >= PROBE_BUF_MAX || probe_size >= self->file_size;
+    int score = last ? 0 : AVPROBE_SCORE_MAX / 4;
+    int size = (int)FFMIN(probe_size, self->file_size);
+    fmt = (AVInputFormat*)ac_probe_input_buffer(self->map, size, (char*)filename, &score);
+    if (last) break;
+  }
+  return fmt;
+}
+
+//Lets ffmpeg stop probing and reading when an asynchronous open is cancelled
+static int ac_interrupt_proc(void *opaque)
+{
+  return ((lp_ac_data)opaque)->aborted;
+}
+
+//Opens the input stream which has been attached to the format context and
+//retrieves the stream information. Files opened by name use the stream info
+//cache, if it is enabled.
+static int ac_open_input(lp_ac_instance pacInstance, AVInputFormat *fmt, const char *filename)
+{
+  lp_ac_data self = (lp_ac_data)pacInstance;
+  self->pFormatCtx->interrupt_callback.callback = ac_interrupt_proc;
+  self->pFormatCtx->interrupt_callback.opaque = self;
+  
+  //A known file is opened with the cached format, so nothing has to be probed
+  ac_cache_header header;
+  ac_cache_stream *streams = NULL;
+  bool use_cache = info_cache_dir != NULL && self->fd >= 0 && filename[0] != 0;
+  if (use_cache && fmt == NULL) {
+    streams = ac_cache_load(self, filename, &header);
+    if (streams != NULL) {
+      fmt = av_find_input_format(header.format);
+    }
+  }
+  
+  //ffmpeg replaces the buffer of the IO-Context after probing it, which must not
+  //happen to the mapping, so mapped files are always opened with a known format
+  if (fmt == NULL && ac_io_is_mapped(self)) {
+    fmt = ac_probe_mapping(self, filename);
+    if (fmt == NULL) {
+      av_free(streams);
+      avformat_free_context(self->pFormatCtx);
+      self->pFormatCtx = NULL;
+      ac_free_io(self);
+      return -1;
+    }
+  }
+  
+  //Open the given input stream (the io structure) with the given format of the stream
+  //(fmt) and write the pointer to the new format context to the pFormatCtx variable.
+  //If no format is given, ffmpeg probes the stream itself.
+  if (avformat_open_input(
+    &(self->pFormatCtx),
+	filename,
+	fmt,
+	NULL) < 0)
+  {
+    av_free(streams);
+    ac_free_io(self);
+    return -1;
+  }   
+
+  //Retrieve stream information, the cache entry saves decoding the first frames
+  AVFormatContext *ctx = self->pFormatCtx;
+  bool cached = streams != NULL && ac_cache_apply(self, &header, streams);
+  av_free(streams);
+  
+  if (!cached) {
+    if (avformat_find_stream_info(ctx, NULL) < 0) {
+      avformat_close_input(&(self->pFormatCtx));
+      ac_free_io(self);
+      return -1;
+    }
+    if (use_cache) {
+      ac_cache_store(self, filename);
+    }
+  }
+  pacInstance->info.duration = ctx->duration * 1000 / AV_TIME_BASE;
+
+  //Set some information in the instance variable 
+  pacInstance->stream_count = self->pFormatCtx->nb_streams;
+  pacInstance->opened = pacInstance->stream_count > 0;  
+
+  return 0;
+}
+
 int CALL_CONVT ac_open(
   lp_ac_instance pacInstance,
   void *sender, 
@@ -285,17 +1210,19 @@ int CALL_CONVT ac_open(
   AVInputFormat* fmt = NULL;
   int probe_size = 0;
  
-  //Probe the input format, if no probe result is specified
-  if(proberesult == NULL)
+  //Probe the input format, if no probe result is specified. Seekable streams
+  //are probed by ffmpeg from the IO-Context, which keeps the probed bytes
+  //instead of reading them a second time.
+  if(proberesult != NULL)
   {
-    fmt = ac_probe_input_stream(sender, read_proc, "",
-    (void*)&((lp_ac_data)pacInstance)->buffer, &probe_size);         
+    fmt = (AVInputFormat*)proberesult;
   }
-  else
+  else if (!seek_proc)
   {
-    fmt = (AVInputFormat*)proberesult;
+    fmt = ac_probe_input_stream(sender, read_proc, "",
+    (void*)&((lp_ac_data)pacInstance)->buffer, &probe_size);         
+    if (!fmt) return -1;
   }
-  if (!fmt) return -1;
 
   ((lp_ac_data)pacInstance)->pFormatCtx = avformat_alloc_context();	
     
@@ -309,12 +1236,8 @@ int CALL_CONVT ac_open(
       ((lp_ac_data)pacInstance)->buffer + probe_size;
     ((lp_ac_data)pacInstance)->pFormatCtx->pb->pos = probe_size;    
   } else {
-    //If the stream is seekable, seek back to the beginning of the stream and
-    //let FFMpeg start from the beginning	
-	if (((lp_ac_data)pacInstance)->buffer)
-		av_free(((lp_ac_data)pacInstance)->buffer);    
-	
-    int64_t pos = seek_proc(sender, 0, SEEK_SET);
+    //If the stream is seekable, let FFMpeg start from the beginning
+    seek_proc(sender, 0, SEEK_SET);
 	
     //Reserve AC_BUFSIZE Bytes of memory
     ((lp_ac_data)pacInstance)->buffer = av_malloc(AC_BUFSIZE);       
@@ -323,31 +1246,92 @@ int CALL_CONVT ac_open(
       ((lp_ac_data)pacInstance)->buffer,
       AC_BUFSIZE, 0, pacInstance, io_read, 0, io_seek);
   }
+  ((lp_ac_data)pacInstance)->pIo = ((lp_ac_data)pacInstance)->pFormatCtx->pb;
   
-  //Open the given input stream (the io structure) with the given format of the stream
-  //(fmt) and write the pointer to the new format context to the pFormatCtx variable
-  if (avformat_open_input(
-    &(((lp_ac_data)pacInstance)->pFormatCtx),
-	"",
-	fmt,
-	NULL) < 0)
-  {
-    return -1;
-  }   
+  return ac_open_input(pacInstance, fmt, "");
+}
 
-  //Retrieve stream information
-  AVFormatContext *ctx = ((lp_ac_data)pacInstance)->pFormatCtx;  
-  if(avformat_find_stream_info(ctx, NULL) >= 0) {    
-    pacInstance->info.duration = ctx->duration * 1000 / AV_TIME_BASE;      
-  } else {
-    return -1;
+int CALL_CONVT ac_open_file(
+  lp_ac_instance pacInstance,
+  const char *filename,
+  int buffer_size)
+{
+  pacInstance->opened = 0;
+  
+  if (buffer_size <= 0) {
+    buffer_size = AC_BUFSIZE;
   }
+  
+  //Open the file, the callbacks are not used in this mode
+  lp_ac_data self = (lp_ac_data)pacInstance;
+  self->sender = NULL;
+  self->open_proc = NULL;
+  self->read_proc = NULL;
+  self->seek_proc = NULL;
+  self->close_proc = NULL;
+  
+  self->fd = file_open(filename);
+  if (self->fd < 0) return -1;
+  
+  self->file_size = file_get_size(self->fd);
+  self->file_pos = 0;
+  
+  //Let ffmpeg read the file directly through the native read and seek functions.
+  //The format is probed by ffmpeg from the IO-Context, so the probed bytes are
+  //only read once.
+  self->buffer = av_malloc(buffer_size);
+  self->pFormatCtx = avformat_alloc_context();
+  self->pFormatCtx->pb = avio_alloc_context(
+    self->buffer, buffer_size, 0, self, file_read, 0, file_seek);
+  self->pIo = self->pFormatCtx->pb;
+  
+  return ac_open_input(pacInstance, NULL, filename);
+}
 
-  //Set some information in the instance variable 
-  pacInstance->stream_count = ((lp_ac_data)pacInstance)->pFormatCtx->nb_streams;
-  pacInstance->opened = pacInstance->stream_count > 0;  
-
-  return 0;
+int CALL_CONVT ac_open_mapped(
+  lp_ac_instance pacInstance,
+  const char *filename)
+{
+  pacInstance->opened = 0;
+  
+  lp_ac_data self = (lp_ac_data)pacInstance;
+  self->sender = NULL;
+  self->open_proc = NULL;
+  self->read_proc = NULL;
+  self->seek_proc = NULL;
+  self->close_proc = NULL;
+  
+  self->fd = file_open(filename);
+  if (self->fd < 0) return -1;
+  
+  self->file_size = file_get_size(self->fd);
+  self->file_pos = 0;
+  
+  //Fall back to reading the file if it can not be mapped
+  self->map = file_map(self);
+  if (self->map == NULL) {
+    file_close(self->fd);
+    self->fd = -1;
+    return ac_open_file(pacInstance, filename, 0);
+  }
+  
+  self->pFormatCtx = avformat_alloc_context();
+  if (self->file_size <= INT_MAX) {
+    //The whole mapping is the buffer of the IO-Context, so ffmpeg reads the
+    //packets straight from it and never calls a read function
+    self->pFormatCtx->pb = avio_alloc_context(
+      self->map, (int)self->file_size, 0, self, NULL, 0, map_seek);
+    self->pFormatCtx->pb->buf_end = self->map + self->file_size;
+    self->pFormatCtx->pb->pos = self->file_size;
+  } else {
+    //The buffer size of an IO-Context is limited, so huge files are copied
+    self->buffer = av_malloc(AC_MAP_BUFSIZE);
+    self->pFormatCtx->pb = avio_alloc_context(
+      self->buffer, AC_MAP_BUFSIZE, 0, self, map_read, 0, file_seek);
+  }
+  self->pIo = self->pFormatCtx->pb;
+  
+  return ac_open_input(pacInstance, NULL, filename);
 }
 
 void CALL_CONVT ac_close(lp_ac_instance pacInstance) {
@@ -357,16 +1341,14 @@ void CALL_CONVT ac_close(lp_ac_instance pacInstance) {
       ((lp_ac_data)(pacInstance))->close_proc(((lp_ac_data)(pacInstance))->sender);
     }
    
+    ac_free_queues((lp_ac_data)pacInstance);
     avformat_close_input(&(((lp_ac_data)(pacInstance))->pFormatCtx));
     pacInstance->opened = 0;
 
-    //If the seek proc has not been specified, the input buffer is not automatically
-    //freed, as ffmpeg didn't get the original pointer to the buffer
-    if (!((lp_ac_data)(pacInstance))->seek_proc &&
-		((lp_ac_data)(pacInstance))->buffer) {
-      av_free(((lp_ac_data)(pacInstance))->buffer);
-    }
-
+    //ffmpeg does not free custom IO-Contexts, so free it and the input buffer here
+    ac_free_io((lp_ac_data)pacInstance);
+    
+    memset(&((lp_ac_data)pacInstance)->stats, 0, sizeof(ac_stats));
   }
 }
 
@@ -451,39 +1433,320 @@ void CALL_CONVT ac_get_stream_info(lp_ac_instance pacInstance, int nb, lp_ac_str
 //---Package management---
 //
 
-lp_ac_package CALL_CONVT ac_read_package(lp_ac_instance pacInstance) {
+void CALL_CONVT ac_set_package_allocator(ac_malloc_callback malloc_proc, ac_free_callback free_proc) {
+  package_malloc = malloc_proc;
+  package_free = free_proc;
+}
+
+//Takes a package record from the free list of the instance, a new one is only
+//allocated if the list is empty
+static lp_ac_package_data ac_get_package_record(lp_ac_data self)
+{
+  lp_ac_package_data pTmp = self->free_packages;
+  if (pTmp != NULL) {
+    self->free_packages = pTmp->next;
+  } else {
+    if (package_malloc != NULL) {
+      pTmp = (lp_ac_package_data)package_malloc(sizeof(ac_package_data));
+    } else {
+      pTmp = (lp_ac_package_data)av_malloc(sizeof(ac_package_data));
+    }
+    if (pTmp == NULL) {
+      return NULL;
+    }
+  }
+  
+  memset(pTmp, 0, sizeof(ac_package_data));
+  pTmp->owner = self;
+  return pTmp;
+}
+
+static void ac_free_package_record(lp_ac_package_data pTmp)
+{
+  if (package_free != NULL) {
+    package_free(pTmp);
+  } else {
+    av_free(pTmp);
+  }
+}
+
+static void ac_free_package_list(lp_ac_data self)
+{
+  while (self->free_packages != NULL) {
+    lp_ac_package_data pTmp = self->free_packages;
+    self->free_packages = pTmp->next;
+    ac_free_package_record(pTmp);
+  }
+}
+
+//Frees the data ffmpeg has allocated for the packet
+static void ac_release_packet(AVPacket *pkt)
+{
+  if (pkt->destruct) pkt->destruct(pkt);
+  pkt->data = NULL; pkt->size = 0;
+}
+
+int CALL_CONVT ac_read_package_to(lp_ac_instance pacInstance, lp_ac_package pPackage) {
+  lp_ac_package_data pTmp = (lp_ac_package_data)pPackage;
+  
+  //The data of the package read before is not needed anymore
+  ac_release_packet(&pTmp->ffpackage);
+  
   //Try to read package
+  lp_ac_stats pStats = &((lp_ac_data)pacInstance)->stats;
   AVPacket Package;  
-  if (av_read_frame(((lp_ac_data)(pacInstance))->pFormatCtx, &Package) >= 0) {
-    //Reserve memory
-    lp_ac_package_data pTmp = (lp_ac_package_data)(av_malloc(sizeof(ac_package_data)));
-	memset(pTmp, 0, sizeof(ac_package_data));
-    
-    //Set package data
-    pTmp->package.stream_index = Package.stream_index;
-    pTmp->ffpackage = Package;
+  int64_t start = av_gettime();
+  int res = av_read_frame(((lp_ac_data)(pacInstance))->pFormatCtx, &Package);
+  pStats->read_time += av_gettime() - start;
+  if (res < 0) {
+    return 0;
+  }
+  
+  pStats->packets_read++;
+  pStats->bytes_read += Package.size;
+  if (Package.size > pStats->max_package_size) {
+    pStats->max_package_size = Package.size;
+  }
+  
+  //Set package data
+  pTmp->package.stream_index = Package.stream_index;
+  pTmp->ffpackage = Package;
+  pTmp->pts = 0;
 	
-	if (Package.dts != AV_NOPTS_VALUE) {
-		pTmp->pts = Package.dts;
-	}
-    
-    return (lp_ac_package)(pTmp);
-  } else {
+  if (Package.dts != AV_NOPTS_VALUE) {
+    pTmp->pts = Package.dts;
+  }
+  
+  return 1;
+}
+
+lp_ac_package CALL_CONVT ac_alloc_package(lp_ac_instance pacInstance) {
+  return (lp_ac_package)ac_get_package_record((lp_ac_data)pacInstance);
+}
+
+lp_ac_package CALL_CONVT ac_read_package(lp_ac_instance pacInstance) {
+  lp_ac_package_data pTmp = ac_get_package_record((lp_ac_data)pacInstance);
+  if (pTmp == NULL) {
+    return NULL;
+  }
+  
+  if (!ac_read_package_to(pacInstance, &pTmp->package)) {
+    ac_free_package(&pTmp->package);
     return NULL;
   }
+  
+  return (lp_ac_package)(pTmp);
 }
 
-//Frees the currently loaded package
+//Frees the currently loaded package, the record is kept by the instance for the
+//next package
 void CALL_CONVT ac_free_package(lp_ac_package pPackage) {
   //Free the packet
   if (pPackage != NULL) {        
-    AVPacket* pkt = &((lp_ac_package_data)pPackage)->ffpackage;
-    if (pkt) {
-      if (pkt->destruct) pkt->destruct(pkt);
-      pkt->data = NULL; pkt->size = 0;
-    }     
-    av_free((lp_ac_package_data)pPackage);
+    lp_ac_package_data pTmp = (lp_ac_package_data)pPackage;
+    lp_ac_data self = pTmp->owner;
+    ac_release_packet(&pTmp->ffpackage);
+    
+    if (self->instance.shared_demux) {
+      pthread_mutex_lock(&self->demux_mutex);
+    }
+    pTmp->next = self->free_packages;
+    self->free_packages = pTmp;
+    if (self->instance.shared_demux) {
+      pthread_mutex_unlock(&self->demux_mutex);
+    }
+  }
+}
+
+//
+//--- Shared demux ---
+//
+
+static void ac_queue_push(ac_package_queue *pQueue, lp_ac_package_data pTmp)
+{
+  pTmp->next = NULL;
+  if (pQueue->last != NULL) {
+    pQueue->last->next = pTmp;
+  } else {
+    pQueue->first = pTmp;
+  }
+  pQueue->last = pTmp;
+  pQueue->count++;
+}
+
+static lp_ac_package_data ac_queue_pop(ac_package_queue *pQueue)
+{
+  lp_ac_package_data pTmp = pQueue->first;
+  if (pTmp != NULL) {
+    pQueue->first = pTmp->next;
+    if (pQueue->first == NULL) {
+      pQueue->last = NULL;
+    }
+    pQueue->count--;
+    pTmp->next = NULL;
+  }
+  return pTmp;
+}
+
+//Puts all queued packages back on the free list, the demux mutex has to be held
+static void ac_queue_flush(lp_ac_data self, ac_package_queue *pQueue)
+{
+  lp_ac_package_data pTmp;
+  while ((pTmp = ac_queue_pop(pQueue)) != NULL) {
+    ac_release_packet(&pTmp->ffpackage);
+    pTmp->next = self->free_packages;
+    self->free_packages = pTmp;
+  }
+}
+
+static void ac_free_queues(lp_ac_data self)
+{
+  int i;
+  for (i = 0; i < self->queue_count; i++) {
+    ac_queue_flush(self, &self->queues[i]);
+  }
+  av_free(self->queues);
+  self->queues = NULL;
+  self->queue_count = 0;
+}
+
+//Lets the given stream collect its packages in the shared demux mode
+static void ac_set_stream_active(lp_ac_data self, int stream_index, int active)
+{
+  if (!self->instance.shared_demux) {
+    return;
+  }
+  
+  pthread_mutex_lock(&self->demux_mutex);
+  if (self->queues == NULL && active) {
+    self->queue_count = self->pFormatCtx->nb_streams;
+    self->queues = (ac_package_queue*)av_malloc(self->queue_count * sizeof(ac_package_queue));
+    if (self->queues != NULL) {
+      memset(self->queues, 0, self->queue_count * sizeof(ac_package_queue));
+      int i;
+      for (i = 0; i < self->queue_count; i++) {
+        self->queues[i].last_dts = AV_NOPTS_VALUE;
+        self->queues[i].skip_until = AV_NOPTS_VALUE;
+      }
+    } else {
+      self->queue_count = 0;
+    }
+  }
+  if (stream_index >= 0 && stream_index < self->queue_count) {
+    ac_package_queue *pQueue = &self->queues[stream_index];
+    pQueue->active = active;
+    pQueue->last_dts = AV_NOPTS_VALUE;
+    pQueue->skip_until = AV_NOPTS_VALUE;
+    pQueue->resync = 0;
+    if (!active) {
+      ac_queue_flush(self, pQueue);
+    }
+  }
+  pthread_mutex_unlock(&self->demux_mutex);
+}
+
+//Returns whether a package read for the stream of the queue is passed on. The
+//demux mutex has to be held.
+static int ac_queue_accepts(ac_package_queue *pQueue, AVPacket *pkt)
+{
+  if (pQueue->skip_until != AV_NOPTS_VALUE) {
+    if (pkt->dts != AV_NOPTS_VALUE && pkt->dts <= pQueue->skip_until) {
+      return 0;
+    }
+    pQueue->skip_until = AV_NOPTS_VALUE;
+  }
+  if (pQueue->resync) {
+    if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+      return 0;
+    }
+    pQueue->resync = 0;
+  }
+  return 1;
+}
+
+//Queues a package for the decoder of another stream. A full queue is dropped
+//and collects again from the next keyframe on. The demux mutex has to be held.
+static void ac_queue_add(lp_ac_data self, ac_package_queue *pQueue, lp_ac_package_data pTmp)
+{
+  if (pQueue->count >= AC_MAX_QUEUED_PACKAGES) {
+    ac_queue_flush(self, pQueue);
+    pQueue->resync = 1;
+  }
+  if (!ac_queue_accepts(pQueue, &pTmp->ffpackage)) {
+    ac_release_packet(&pTmp->ffpackage);
+    pTmp->next = self->free_packages;
+    self->free_packages = pTmp;
+    return;
   }
+  
+  ac_queue_push(pQueue, pTmp);
+  if (pQueue->count > self->stats.max_queued_packages) {
+    self->stats.max_queued_packages = pQueue->count;
+  }
+}
+
+//Returns the next package for the stream of the given decoder. Without the
+//shared demux mode the packages of other streams are dropped, otherwise they
+//are queued for their decoders.
+static lp_ac_package ac_next_package(lp_ac_decoder pDec)
+{
+  lp_ac_instance pacInstance = pDec->pacInstance;
+  lp_ac_data self = (lp_ac_data)pacInstance;
+  int stream_index = pDec->stream_index;
+  lp_ac_stats pStats = ac_decoder_stats(pDec);
+  if (!pacInstance->shared_demux) {
+    lp_ac_package pPackage;
+    while ((pPackage = ac_read_package(pacInstance)) != NULL &&
+           pPackage->stream_index != stream_index) {
+      pStats->packets_discarded++;
+      ac_free_package(pPackage);
+    }
+    return pPackage;
+  }
+  
+  pthread_mutex_lock(&self->demux_mutex);
+  
+  lp_ac_package_data pTmp = NULL;
+  ac_package_queue *pOwn = NULL;
+  if (stream_index >= 0 && stream_index < self->queue_count) {
+    pOwn = &self->queues[stream_index];
+    pTmp = ac_queue_pop(pOwn);
+  }
+  
+  while (pTmp == NULL) {
+    pTmp = ac_get_package_record(self);
+    if (pTmp == NULL) {
+      break;
+    }
+    if (!ac_read_package_to(pacInstance, &pTmp->package)) {
+      pTmp->next = self->free_packages;
+      self->free_packages = pTmp;
+      pTmp = NULL;
+      break;
+    }
+    
+    int nb = pTmp->package.stream_index;
+    if (nb == stream_index && (pOwn == NULL || ac_queue_accepts(pOwn, &pTmp->ffpackage))) {
+      break;
+    }
+    
+    if (nb != stream_index && nb >= 0 && nb < self->queue_count && self->queues[nb].active) {
+      ac_queue_add(self, &self->queues[nb], pTmp);
+    } else {
+      pStats->packets_discarded++;
+      ac_release_packet(&pTmp->ffpackage);
+      pTmp->next = self->free_packages;
+      self->free_packages = pTmp;
+    }
+    pTmp = NULL;
+  }
+  
+  if (pTmp != NULL && pOwn != NULL && pTmp->ffpackage.dts != AV_NOPTS_VALUE) {
+    pOwn->last_dts = pTmp->ffpackage.dts;
+  }
+  
+  pthread_mutex_unlock(&self->demux_mutex);
+  return (lp_ac_package)pTmp;
 }
 
 //
@@ -496,19 +1759,250 @@ enum PixelFormat convert_pix_format(ac_output_format fmt) {
     case AC_OUTPUT_BGR24: return PIX_FMT_BGR24;
     case AC_OUTPUT_RGBA32: return PIX_FMT_RGB32;
     case AC_OUTPUT_BGRA32: return PIX_FMT_BGR32;        
+    case AC_OUTPUT_YUV420P: return PIX_FMT_YUV420P;
+    case AC_OUTPUT_NV12: return PIX_FMT_NV12;
   }
   return PIX_FMT_RGB32;
 }
 
+static int ac_cpu_count(void)
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int)count : 1;
+#endif
+}
+
+static void ac_setup_video_threads(AVCodecContext *pCodecCtx, lp_ac_instance pacInstance)
+{
+  int count = pacInstance->thread_count;
+  
+  //Every frame thread adds one frame of delay and holds its own frame, so
+  //the automatic thread count is limited
+  if (count <= 0) {
+    count = ac_cpu_count();
+    if (count > AC_MAX_AUTO_THREADS) count = AC_MAX_AUTO_THREADS;
+  }
+  pCodecCtx->thread_count = count;
+  
+  switch (pacInstance->thread_type) {
+    case AC_THREAD_FRAME: pCodecCtx->thread_type = FF_THREAD_FRAME; break;
+    case AC_THREAD_SLICE: pCodecCtx->thread_type = FF_THREAD_SLICE; break;
+    default: pCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  }
+}
+
+//Calculates the size the video frames are converted to
+static void ac_get_output_size(lp_ac_instance pacInstance, int width, int height,
+  int *out_width, int *out_height)
+{
+  *out_width = width;
+  *out_height = height;
+  
+  if (width <= 0 || height <= 0) return;
+  
+  if (pacInstance->output_width > 0 && pacInstance->output_height > 0) {
+    *out_width = pacInstance->output_width;
+    *out_height = pacInstance->output_height;
+  } else if (pacInstance->output_width > 0) {
+    *out_width = pacInstance->output_width;
+    *out_height = (int)((int64_t)height * pacInstance->output_width / width);
+  } else if (pacInstance->output_height > 0) {
+    *out_width = (int)((int64_t)width * pacInstance->output_height / height);
+    *out_height = pacInstance->output_height;
+  }
+  
+  int max_size = pacInstance->output_max_size;
+  if (max_size > 0 && (*out_width > max_size || *out_height > max_size)) {
+    if (*out_width >= *out_height) {
+      *out_height = (int)((int64_t)*out_height * max_size / *out_width);
+      *out_width = max_size;
+    } else {
+      *out_width = (int)((int64_t)*out_width * max_size / *out_height);
+      *out_height = max_size;
+    }
+  }
+  
+  if (*out_width < 1) *out_width = 1;
+  if (*out_height < 1) *out_height = 1;
+}
+
+//Chooses the largest lowres level which still decodes at least the output size
+static int ac_get_lowres(AVCodec *pCodec, int width, int height, int out_width, int out_height)
+{
+  int lowres = 0;
+  while ((lowres < pCodec->max_lowres) &&
+         ((width >> (lowres + 1)) >= out_width) &&
+         ((height >> (lowres + 1)) >= out_height)) {
+    lowres++;
+  }
+  return lowres;
+}
+
+//Stores the plane pointers and sizes of a frame in the given output format
+static void ac_fill_planes(ac_output_format format, int height, uint8_t **data, int *linesize,
+  char **planes, int *strides, int *plane_sizes)
+{
+  int chroma_height = (height + 1) / 2;
+  int count = 1;
+  
+  switch (format) {
+    case AC_OUTPUT_YUV420P: count = 3; break;
+    case AC_OUTPUT_NV12: count = 2; break;
+    default: count = 1;
+  }
+  
+  int i;
+  for (i = 0; i < AC_MAX_PLANES; i++) {
+    if (i < count) {
+      planes[i] = (char*)data[i];
+      strides[i] = linesize[i];
+      plane_sizes[i] = linesize[i] * (i == 0 ? height : chroma_height);
+    } else {
+      planes[i] = NULL;
+      strides[i] = 0;
+      plane_sizes[i] = 0;
+    }
+  }
+}
+
+//Stores the plane pointers and sizes of the output frame in the decoder
+static void ac_set_video_planes(lp_ac_video_decoder pDecoder, uint8_t **data, int *linesize)
+{
+  ac_fill_planes(pDecoder->decoder.pacInstance->output_format, pDecoder->decoder.output_height,
+    data, linesize, pDecoder->decoder.planes, pDecoder->decoder.strides, pDecoder->decoder.plane_sizes);
+}
+
+//
+//--- Frame pool ---
+//
+
+//Allocates a new frame for the frame pool of the decoder
+static lp_ac_frame_data ac_alloc_pool_frame(lp_ac_video_decoder pDecoder)
+{
+  lp_ac_frame_data pFrame = (lp_ac_frame_data)av_malloc(sizeof(ac_frame_data));
+  if (pFrame == NULL) {
+    return NULL;
+  }
+  memset(pFrame, 0, sizeof(ac_frame_data));
+  
+  ac_output_format format = pDecoder->decoder.pacInstance->output_format;
+  pFrame->frame.width = pDecoder->decoder.output_width;
+  pFrame->frame.height = pDecoder->decoder.output_height;
+  pFrame->frame.buffer_size = pDecoder->decoder.buffer_size;
+  pFrame->frame.pBuffer = (char*)av_malloc(pFrame->frame.buffer_size);
+  pFrame->pPicture = avcodec_alloc_frame();
+  if (pFrame->frame.pBuffer == NULL || pFrame->pPicture == NULL) {
+    av_free(pFrame->frame.pBuffer);
+    av_free(pFrame->pPicture);
+    av_free(pFrame);
+    return NULL;
+  }
+  
+  avpicture_fill((AVPicture*)(pFrame->pPicture), (uint8_t*)pFrame->frame.pBuffer,
+    convert_pix_format(format), pFrame->frame.width, pFrame->frame.height);
+  ac_fill_planes(format, pFrame->frame.height, pFrame->pPicture->data, pFrame->pPicture->linesize,
+    pFrame->frame.planes, pFrame->frame.strides, pFrame->frame.plane_sizes);
+    
+  //The reference of the pool
+  pFrame->refcount = 1;
+  
+  return pFrame;
+}
+
+static void ac_free_pool_frame(lp_ac_frame_data pFrame)
+{
+  av_free(pFrame->frame.pBuffer);
+  av_free(pFrame->pPicture);
+  av_free(pFrame);
+}
+
+//Returns a frame of the pool which is not referenced by anyone but the pool.
+//Only the decoding thread adds references to frames which are not the current
+//one, so a free frame can not be taken by another thread in the meantime.
+static lp_ac_frame_data ac_get_pool_frame(lp_ac_video_decoder pDecoder)
+{
+  int i;
+  for (i = 0; i < pDecoder->pool_count; i++) {
+    if (pDecoder->pool[i] != pDecoder->current && pDecoder->pool[i]->refcount == 1) {
+      return pDecoder->pool[i];
+    }
+  }
+  
+  //All frames are in use, so the pool grows
+  lp_ac_frame_data *pool = (lp_ac_frame_data*)av_realloc(pDecoder->pool,
+    (pDecoder->pool_count + 1) * sizeof(lp_ac_frame_data));
+  if (pool == NULL) {
+    return NULL;
+  }
+  pDecoder->pool = pool;
+  
+  lp_ac_frame_data pFrame = ac_alloc_pool_frame(pDecoder);
+  if (pFrame == NULL) {
+    return NULL;
+  }
+  pDecoder->pool[pDecoder->pool_count++] = pFrame;
+  
+  return pFrame;
+}
+
+//Makes the given frame the one which is returned by ac_get_video_frame
+static void ac_set_current_frame(lp_ac_video_decoder pDecoder, lp_ac_frame_data pFrame)
+{
+  ac_atomic_inc(&pFrame->refcount);
+  if (pDecoder->current != NULL) {
+    ac_atomic_dec(&pDecoder->current->refcount);
+  }
+  pDecoder->current = pFrame;
+  
+  pDecoder->decoder.pBuffer = pFrame->frame.pBuffer;
+  memcpy(pDecoder->decoder.planes, pFrame->frame.planes, sizeof(pFrame->frame.planes));
+  memcpy(pDecoder->decoder.strides, pFrame->frame.strides, sizeof(pFrame->frame.strides));
+  memcpy(pDecoder->decoder.plane_sizes, pFrame->frame.plane_sizes, sizeof(pFrame->frame.plane_sizes));
+}
+
+lp_ac_frame CALL_CONVT ac_get_video_frame(lp_ac_decoder pDecoder) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return NULL;
+  }
+  
+  lp_ac_frame_data pFrame = ((lp_ac_video_decoder)pDecoder)->current;
+  if (pFrame == NULL) {
+    return NULL;
+  }
+  
+  ac_atomic_inc(&pFrame->refcount);
+  return &pFrame->frame;
+}
+
+void CALL_CONVT ac_release_frame(lp_ac_frame pFrame) {
+  if (pFrame == NULL) {
+    return;
+  }
+  
+  //Only reaches zero if the decoder has already been freed
+  if (ac_atomic_dec(&((lp_ac_frame_data)pFrame)->refcount) == 0) {
+    ac_free_pool_frame((lp_ac_frame_data)pFrame);
+  }
+}
+
 //Init a video decoder
 void* ac_create_video_decoder(lp_ac_instance pacInstance, lp_ac_stream_info info, int nb) {
   //Allocate memory for a new decoder instance
   lp_ac_video_decoder pDecoder;  
   pDecoder = (lp_ac_video_decoder)(av_malloc(sizeof(ac_video_decoder)));
+  if (pDecoder == NULL) {
+    return NULL;
+  }
   memset(pDecoder, 0, sizeof(ac_video_decoder));
   
   //Set a few properties
   pDecoder->decoder.pacInstance = pacInstance;
+  pDecoder->priority = AC_PRIORITY_PREVIEW;
   pDecoder->decoder.type = AC_DECODER_TYPE_VIDEO;
   pDecoder->decoder.stream_index = nb;
   pDecoder->pCodecCtx = ((lp_ac_data)(pacInstance))->pFormatCtx->streams[nb]->codec;
@@ -516,14 +2010,31 @@ void* ac_create_video_decoder(lp_ac_instance pacInstance, lp_ac_stream_info info
   
   //Find correspondenting codec
   if (!(pDecoder->pCodec = avcodec_find_decoder(pDecoder->pCodecCtx->codec_id))) {
+    av_free(pDecoder);
     return NULL; //Codec could not have been found
   }
 
-  pDecoder->pCodecCtx->thread_count = 1; //this is for HT CPUs, it should be
-										// tested if there is a better solution
+  //Setup multithreaded decoding, this has to be done before opening the codec
+  ac_setup_video_threads(pDecoder->pCodecCtx, pacInstance);
+  
+  //The frames are scaled to the output size while they are converted
+  ac_get_output_size(pacInstance, pDecoder->pCodecCtx->width, pDecoder->pCodecCtx->height,
+    &pDecoder->decoder.output_width, &pDecoder->decoder.output_height);
+    
+  //Let the codec skip the details which would be scaled away anyway
+  if (pacInstance->allow_lowres) {
+    pDecoder->pCodecCtx->lowres = ac_get_lowres(pDecoder->pCodec,
+      pDecoder->pCodecCtx->width, pDecoder->pCodecCtx->height,
+      pDecoder->decoder.output_width, pDecoder->decoder.output_height);
+    if (pDecoder->pCodecCtx->lowres > 0) {
+      pDecoder->pCodecCtx->flags |= CODEC_FLAG_EMU_EDGE;
+    }
+  }
 
   //Open codec
   if (avcodec_open2(pDecoder->pCodecCtx, pDecoder->pCodec, NULL) < 0) {
+    avcodec_close(pDecoder->pCodecCtx);
+    av_free(pDecoder);
     return NULL; //Codec could not have been opened
   }
   
@@ -535,14 +2046,31 @@ void* ac_create_video_decoder(lp_ac_instance pacInstance, lp_ac_stream_info info
   
   //Reserve buffer memory
   pDecoder->decoder.buffer_size = avpicture_get_size(convert_pix_format(pacInstance->output_format), 
-    pDecoder->pCodecCtx->width, pDecoder->pCodecCtx->height);
+    pDecoder->decoder.output_width, pDecoder->decoder.output_height);
+    
+  //With a frame pool, the frames are converted into the pooled frames and the
+  //buffer of the decoder points on the current one
+  if (pacInstance->frame_pool_size > 0) {
+    pDecoder->use_pool = 1;
+    pDecoder->pool = (lp_ac_frame_data*)av_malloc(pacInstance->frame_pool_size * sizeof(lp_ac_frame_data));
+    while (pDecoder->pool != NULL && pDecoder->pool_count < pacInstance->frame_pool_size) {
+      lp_ac_frame_data pFrame = ac_alloc_pool_frame(pDecoder);
+      if (pFrame == NULL) {
+        break;
+      }
+      pDecoder->pool[pDecoder->pool_count++] = pFrame;
+    }
+    return (void*)pDecoder;
+  }
+  
   pDecoder->decoder.pBuffer = (uint8_t*)av_malloc(pDecoder->decoder.buffer_size);
 
   //Link decoder to buffer
   avpicture_fill(
     (AVPicture*)(pDecoder->pFrameRGB), 
     pDecoder->decoder.pBuffer, convert_pix_format(pacInstance->output_format),
-    pDecoder->pCodecCtx->width, pDecoder->pCodecCtx->height);
+    pDecoder->decoder.output_width, pDecoder->decoder.output_height);
+  ac_set_video_planes(pDecoder, pDecoder->pFrameRGB->data, pDecoder->pFrameRGB->linesize);
     
   return (void*)pDecoder;
 }
@@ -552,6 +2080,9 @@ void* ac_create_audio_decoder(lp_ac_instance pacInstance, lp_ac_stream_info info
   //Allocate memory for a new decoder instance
   lp_ac_audio_decoder pDecoder;
   pDecoder = (lp_ac_audio_decoder)(av_malloc(sizeof(ac_audio_decoder)));
+  if (pDecoder == NULL) {
+    return NULL;
+  }
   memset(pDecoder, 0, sizeof(ac_audio_decoder));
   
   //Set a few properties
@@ -567,11 +2098,14 @@ void* ac_create_audio_decoder(lp_ac_instance pacInstance, lp_ac_stream_info info
   
   //Find correspondenting codec
   if (!(pDecoder->pCodec = avcodec_find_decoder(pCodecCtx->codec_id))) {
+    av_free(pDecoder);
     return NULL;
   }
   
   //Open codec
   if (avcodec_open2(pCodecCtx, pDecoder->pCodec, NULL) < 0) {
+    avcodec_close(pCodecCtx);
+    av_free(pDecoder);
     return NULL;
   }
 
@@ -580,8 +2114,17 @@ void* ac_create_audio_decoder(lp_ac_instance pacInstance, lp_ac_stream_info info
   pDecoder->decoder.buffer_size = 0;
   pDecoder->max_buffer_size = 0;
   
-  pDecoder->tmp_data = NULL;
-  pDecoder->tmp_data_length = 0;
+  //Choose the output format, the stream info describes it from now on
+  pDecoder->out_fmt = pacInstance->audio_output_format == AC_AUDIO_F32 ?
+    AV_SAMPLE_FMT_FLT : AV_SAMPLE_FMT_S16;
+  pDecoder->out_rate = pacInstance->audio_sample_rate > 0 ?
+    pacInstance->audio_sample_rate : pCodecCtx->sample_rate;
+  pDecoder->out_channels = pacInstance->audio_channel_count > 0 ?
+    pacInstance->audio_channel_count : pCodecCtx->channels;
+    
+  pDecoder->decoder.stream_info.audio_info.samples_per_second = pDecoder->out_rate;
+  pDecoder->decoder.stream_info.audio_info.channel_count = pDecoder->out_channels;
+  pDecoder->decoder.stream_info.audio_info.bit_depth = av_get_bytes_per_sample(pDecoder->out_fmt) * 8;
   
   return (void*)pDecoder;
 }
@@ -592,7 +2135,7 @@ lp_ac_decoder CALL_CONVT ac_create_decoder(lp_ac_instance pacInstance, int nb) {
   ac_stream_info info;
   ac_get_stream_info(pacInstance, nb, &info);
   
-  lp_ac_decoder result;
+  lp_ac_decoder result = NULL;
   
   if (info.stream_type == AC_STREAM_TYPE_VIDEO) {
     result = ac_create_video_decoder(pacInstance, &info, nb);
@@ -601,14 +2144,21 @@ lp_ac_decoder CALL_CONVT ac_create_decoder(lp_ac_instance pacInstance, int nb) {
     result = ac_create_audio_decoder(pacInstance, &info, nb);  
   }
   
+  //The codec is not supported or could not be opened
+  if (result == NULL) {
+    return NULL;
+  }
+  
   ((lp_ac_decoder_data)result)->last_timecode = 0;
   ((lp_ac_decoder_data)result)->sought = 1;
   result->video_clock = 0;
   
+  ac_set_stream_active((lp_ac_data)pacInstance, nb, 1);
+  
   return result;
 }
 
-double ac_sync_video(lp_ac_package pPackage, lp_ac_decoder pDec, AVFrame *src_frame, double pts){
+double ac_sync_video(lp_ac_decoder pDec, AVFrame *src_frame, double pts){
   double frame_delay;
   
   if(pts != 0){
@@ -617,19 +2167,70 @@ double ac_sync_video(lp_ac_package pPackage, lp_ac_decoder pDec, AVFrame *src_fr
     pts = pDec->video_clock;
   }
   
-  frame_delay = av_q2d(((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->time_base);
+  frame_delay = av_q2d(((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pDec->stream_index]->time_base);
   frame_delay += src_frame->repeat_pict * (frame_delay * 0.5);
   pDec->video_clock += frame_delay;
   return pts;
 }
 
-int ac_decode_video_package(lp_ac_package pPackage, lp_ac_video_decoder pDecoder, lp_ac_decoder pDec)
-{
+static enum AVDiscard convert_discard(int discard) {
+  switch (discard) {
+    case AC_DISCARD_NONREF: return AVDISCARD_NONREF;
+    case AC_DISCARD_BIDIR: return AVDISCARD_BIDIR;
+    case AC_DISCARD_NONKEY: return AVDISCARD_NONKEY;
+    case AC_DISCARD_ALL: return AVDISCARD_ALL;
+  }
+  return AVDISCARD_DEFAULT;
+}
+
+//Sets the discard levels of the codec. The automatic levels first stop
+//deblocking the frames nobody refers to, then all frames, which disturbs the
+//picture slightly up to the next keyframe, and finally skip the frames nobody
+//refers to.
+static void ac_apply_discard(lp_ac_video_decoder pDecoder)
+{
+  static const int auto_levels[AC_DISCARD_MAX_LEVEL + 1][3] = {
+    {AC_DISCARD_NONE, AC_DISCARD_NONE, AC_DISCARD_NONE},
+    {AC_DISCARD_NONE, AC_DISCARD_NONREF, AC_DISCARD_NONE},
+    {AC_DISCARD_NONE, AC_DISCARD_ALL, AC_DISCARD_NONREF},
+    {AC_DISCARD_NONREF, AC_DISCARD_ALL, AC_DISCARD_NONREF}
+  };
+  
+  int level = pDecoder->auto_discard ? pDecoder->auto_level : 0;
+  int skip_frame = FFMAX(pDecoder->skip_frame, auto_levels[level][0]);
+  int skip_loop_filter = FFMAX(pDecoder->skip_loop_filter, auto_levels[level][1]);
+  int skip_idct = FFMAX(pDecoder->skip_idct, auto_levels[level][2]);
+  if (pDecoder->catch_up) {
+    skip_frame = FFMAX(skip_frame, AC_DISCARD_NONREF);
+  }
+  
+  pDecoder->pCodecCtx->skip_frame = convert_discard(skip_frame);
+  pDecoder->pCodecCtx->skip_loop_filter = convert_discard(skip_loop_filter);
+  pDecoder->pCodecCtx->skip_idct = convert_discard(skip_idct);
+}
+
+//Decodes the given packet into the frame of the video decoder. Returns 1 if a
+//frame has been finished. An empty packet returns the frames which are still
+//delayed inside the codec.
+static int ac_decode_video_frame(lp_ac_video_decoder pDecoder, AVPacket *pkt)
+{
   int finished = 0;
-  double pts = 0;
   int len = 0;
+  int64_t start = av_gettime();
   
-  AVPacket pkt_tmp = ((lp_ac_package_data)pPackage)->ffpackage;
+  AVPacket pkt_tmp = *pkt;
+  
+  //Catching up ends at the next keyframe, from there on the frames are needed
+  if (pDecoder->catch_up == 2 && (pkt_tmp.flags & AV_PKT_FLAG_KEY)) {
+    pDecoder->catch_up = 0;
+  }
+  ac_apply_discard(pDecoder);
+  
+  if (pkt_tmp.size == 0) {
+    if (avcodec_decode_video2(pDecoder->pCodecCtx, pDecoder->pFrame, &finished, &pkt_tmp) < 0) {
+      finished = 0;
+    }
+  }
   
   while (pkt_tmp.size > 0) {
     len = avcodec_decode_video2(
@@ -637,147 +2238,308 @@ int ac_decode_video_package(lp_ac_package pPackage, lp_ac_video_decoder pDecoder
 	  &finished, &pkt_tmp);
             
 	if (len < 0) {
-	  return 0;
+	  finished = 0;
+	  break;
     }
 
 	pkt_tmp.size -= len;
     pkt_tmp.data += len;
   }
   
-  /*
-  avcodec_decode_video2(
-    pDecoder->pCodecCtx, pDecoder->pFrame, &finished, 
-    &(((lp_ac_package_data)pPackage)->ffpackage));
-  */
-  
-  if (finished != 0) {
-    pDecoder->pSwsCtx = sws_getCachedContext(pDecoder->pSwsCtx,
-        pDecoder->pCodecCtx->width, pDecoder->pCodecCtx->height, pDecoder->pCodecCtx->pix_fmt,
-        pDecoder->pCodecCtx->width, pDecoder->pCodecCtx->height, convert_pix_format(pDecoder->decoder.pacInstance->output_format),
-                                  SWS_FAST_BILINEAR, NULL, NULL, NULL);
-                                  
-      sws_scale(
-        pDecoder->pSwsCtx,
-        (const uint8_t* const*)(pDecoder->pFrame->data),
-        pDecoder->pFrame->linesize,
-        0, //?
-        pDecoder->pCodecCtx->height, 
-        pDecoder->pFrameRGB->data, 
-        pDecoder->pFrameRGB->linesize);
-		
-	
-    if(pkt_tmp.dts == AV_NOPTS_VALUE &&
-	  *(uint64_t*)pDecoder->pFrame->opaque != AV_NOPTS_VALUE ){
-	  pts = *(uint64_t*)pDecoder->pFrame->opaque;
-    } else if(pkt_tmp.dts != AV_NOPTS_VALUE){
-      pts = pkt_tmp.dts;
+  pDecoder->stats.decode_time += av_gettime() - start;
+  if (finished) {
+    pDecoder->stats.frames_decoded++;
+  }
+  
+  return finished != 0;
+}
+
+//Converts the decoded frame into the output buffer, scaling it to the output
+//size in the same pass
+static void ac_convert_video_frame(lp_ac_video_decoder pDecoder, double timecode)
+{
+  int width = pDecoder->pCodecCtx->width;
+  int height = pDecoder->pCodecCtx->height;
+  enum PixelFormat format = convert_pix_format(pDecoder->decoder.pacInstance->output_format);
+  AVFrame *pDest = pDecoder->pFrameRGB;
+  lp_ac_frame_data pPoolFrame = NULL;
+  
+  //Pooled frames have to keep their data, so they are always converted
+  if (pDecoder->use_pool) {
+    pPoolFrame = ac_get_pool_frame(pDecoder);
+    if (pPoolFrame == NULL) {
+      return;
     }
-	
-	if(((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->start_time != AV_NOPTS_VALUE){
-      pts -= ((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->start_time;
-	}
+    pDest = pPoolFrame->pPicture;
+  }
+  
+  //If the codec already decodes to the requested YUV format and size, the
+  //planes of the decoded frame are handed out without any conversion. Packed
+  //formats are always copied, as they are read from the buffer.
+  else if ((format == PIX_FMT_YUV420P || format == PIX_FMT_NV12) &&
+      format == pDecoder->pCodecCtx->pix_fmt &&
+      width == pDecoder->decoder.output_width && height == pDecoder->decoder.output_height) {
+    ac_set_video_planes(pDecoder, pDecoder->pFrame->data, pDecoder->pFrame->linesize);
+    pDecoder->frames_converted++;
+    return;
+  }
+  
+  //Fast bilinear scaling aliases badly when shrinking the frames. Shrinking
+  //them to less than half of their size, like images which are turned into
+  //thumbnails, has to average all source pixels.
+  int flags = SWS_FAST_BILINEAR;
+  if (width >= 2 * pDecoder->decoder.output_width && height >= 2 * pDecoder->decoder.output_height) {
+    flags = SWS_AREA;
+  } else if (width != pDecoder->decoder.output_width || height != pDecoder->decoder.output_height) {
+    flags = SWS_BILINEAR;
+  }
+  
+  pDecoder->pSwsCtx = sws_getCachedContext(pDecoder->pSwsCtx,
+      width, height, pDecoder->pCodecCtx->pix_fmt,
+      pDecoder->decoder.output_width, pDecoder->decoder.output_height,
+      format, flags, NULL, NULL, NULL);
+                                
+  int64_t start = av_gettime();
+  sws_scale(
+    pDecoder->pSwsCtx,
+    (const uint8_t* const*)(pDecoder->pFrame->data),
+    pDecoder->pFrame->linesize,
+    0,
+    height,
+    pDest->data, 
+    pDest->linesize);
+  pDecoder->stats.convert_time += av_gettime() - start;
+  pDecoder->frames_converted++;
+    
+  if (pPoolFrame != NULL) {
+    pPoolFrame->frame.timecode = timecode;
+    ac_set_current_frame(pDecoder, pPoolFrame);
+  } else {
+    ac_set_video_planes(pDecoder, pDest->data, pDest->linesize);
+  }
+}
 
-    pts *= av_q2d(((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->time_base);
-	
-    pts = ac_sync_video(pPackage, pDec, pDecoder->pFrame, pts);
-	pDec->timecode = pts;
+//Returns the timecode of the decoded frame in seconds. The timestamp is taken
+//from the frame and not from the last packet, as multithreaded decoders return
+//their frames a few packets later.
+static double ac_video_frame_pts(lp_ac_video_decoder pDecoder, lp_ac_decoder pDec)
+{
+  AVStream *pStream = ((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pDec->stream_index];
+  int64_t timestamp = pDecoder->pFrame->best_effort_timestamp;
+  double pts = 0;
+  
+  if (timestamp == AV_NOPTS_VALUE) {
+    timestamp = pDecoder->pFrame->pkt_dts;
+  }
+  
+  if (timestamp != AV_NOPTS_VALUE) {
+    pts = timestamp;
+    if (pStream->start_time != AV_NOPTS_VALUE) {
+      pts -= pStream->start_time;
+    }
+    pts *= av_q2d(pStream->time_base);
+  }
+  
+  return ac_sync_video(pDec, pDecoder->pFrame, pts);
+}
+
+//Returns the frames which are still delayed in the codec once the end of the
+//file has been reached
+static int ac_drain_video_decoder(lp_ac_video_decoder pDecoder, lp_ac_decoder pDec, int convert)
+{
+  if (!(pDecoder->pCodec->capabilities & CODEC_CAP_DELAY) &&
+      !(pDecoder->pCodecCtx->active_thread_type & FF_THREAD_FRAME)) {
+    return 0;
+  }
+  
+  AVPacket pkt;
+  av_init_packet(&pkt);
+  pkt.data = NULL;
+  pkt.size = 0;
+  
+  if (!ac_decode_video_frame(pDecoder, &pkt)) {
+    return 0;
+  }
+  
+  pDec->timecode = ac_video_frame_pts(pDecoder, pDec);
+  if (convert) {
+    ac_convert_video_frame(pDecoder, pDec->timecode);
+  }
+  
+  return 1;
+}
+
+int ac_decode_video_package(lp_ac_package pPackage, lp_ac_video_decoder pDecoder, lp_ac_decoder pDec)
+{
+  if (ac_decode_video_frame(pDecoder, &((lp_ac_package_data)pPackage)->ffpackage)) {
+	pDec->timecode = ac_video_frame_pts(pDecoder, pDec);
+    ac_convert_video_frame(pDecoder, pDec->timecode);
 		   
     return 1;
   }
   return 0;
 }
 
-int ac_decode_audio_package(lp_ac_package pPackage, lp_ac_audio_decoder pDecoder, lp_ac_decoder pDec) {
-  double pts;
-  //Variables describing the destination buffer
-  int dest_buffer_pos = pDecoder->decoder.buffer_size;
+//Size of one sample frame, the samples of all channels, in bytes
+static int ac_audio_frame_bytes(lp_ac_audio_decoder pDecoder)
+{
+  return pDecoder->out_channels * av_get_bytes_per_sample(pDecoder->out_fmt);
+}
+
+static int64_t ac_audio_channel_layout(int channels, uint64_t layout)
+{
+  if (layout != 0 && av_get_channel_layout_nb_channels(layout) == channels) {
+    return layout;
+  }
+  return av_get_default_channel_layout(channels);
+}
+
+//Creates the resampler for the current format of the decoded samples. Returns
+//false if the samples can be copied as they are.
+static bool ac_update_resampler(lp_ac_audio_decoder pDecoder)
+{
+  AVCodecContext *pCodecCtx = pDecoder->pCodecCtx;
+  
+  if (pDecoder->pSwrCtx != NULL &&
+      pDecoder->in_fmt == pCodecCtx->sample_fmt &&
+      pDecoder->in_rate == pCodecCtx->sample_rate &&
+      pDecoder->in_channels == pCodecCtx->channels) {
+    return true;
+  }
+  
+  pDecoder->in_fmt = pCodecCtx->sample_fmt;
+  pDecoder->in_rate = pCodecCtx->sample_rate;
+  pDecoder->in_channels = pCodecCtx->channels;
+  swr_free(&pDecoder->pSwrCtx);
+  
+  if (pDecoder->in_fmt == pDecoder->out_fmt &&
+      pDecoder->in_rate == pDecoder->out_rate &&
+      pDecoder->in_channels == pDecoder->out_channels) {
+    return false;
+  }
+  
+  pDecoder->pSwrCtx = swr_alloc_set_opts(NULL,
+    av_get_default_channel_layout(pDecoder->out_channels), pDecoder->out_fmt, pDecoder->out_rate,
+    ac_audio_channel_layout(pDecoder->in_channels, pCodecCtx->channel_layout),
+    pDecoder->in_fmt, pDecoder->in_rate, 0, NULL);
+  if (pDecoder->pSwrCtx != NULL && swr_init(pDecoder->pSwrCtx) < 0) {
+    swr_free(&pDecoder->pSwrCtx);
+  }
+  return true;
+}
+
+//Converts the samples of a decoded frame into the output format and appends
+//them to the given buffer at offset, which is grown when needed. Returns the
+//number of bytes appended.
+static int ac_convert_audio(lp_ac_audio_decoder pDecoder, AVFrame *pFrame,
+  uint8_t **buffer, int *capacity, int offset)
+{
+  int frame_bytes = ac_audio_frame_bytes(pDecoder);
+  bool resample = ac_update_resampler(pDecoder);
+  if (resample && pDecoder->pSwrCtx == NULL) {
+    return 0;
+  }
+  
+  //Upper bound of the samples the resampler returns, including the ones it
+  //buffered before
+  int out_samples = pFrame->nb_samples;
+  if (resample) {
+    out_samples = (int)av_rescale_rnd(swr_get_delay(pDecoder->pSwrCtx, pDecoder->in_rate) +
+      pFrame->nb_samples, pDecoder->out_rate, pDecoder->in_rate, AV_ROUND_UP);
+  }
+  if (out_samples <= 0 || frame_bytes <= 0) {
+    return 0;
+  }
+  
+  if (offset + out_samples * frame_bytes > *capacity) {
+    uint8_t *tmp = (uint8_t*)av_realloc(*buffer, offset + out_samples * frame_bytes);
+    if (tmp == NULL) {
+      return 0;
+    }
+    *buffer = tmp;
+    *capacity = offset + out_samples * frame_bytes;
+  }
+  
+  uint8_t *out = *buffer + offset;
+  if (!resample) {
+    memcpy(out, pFrame->data[0], out_samples * frame_bytes);
+    return out_samples * frame_bytes;
+  }
   
+  //Planar formats keep each channel in its own plane of extended_data
+  int64_t start = av_gettime();
+  int count = swr_convert(pDecoder->pSwrCtx, &out, out_samples,
+    (const uint8_t**)pFrame->extended_data, pFrame->nb_samples);
+  pDecoder->stats.convert_time += av_gettime() - start;
+  return count > 0 ? count * frame_bytes : 0;
+}
+
+//Decodes the next frame of the packet into the frame of the audio decoder
+static int ac_decode_audio_frame(lp_ac_audio_decoder pDecoder, AVPacket *pkt, int *got_frame)
+{
+  int64_t start = av_gettime();
+  int len = avcodec_decode_audio4(pDecoder->pCodecCtx, pDecoder->pFrame, got_frame, pkt);
+  pDecoder->stats.decode_time += av_gettime() - start;
+  if (len >= 0 && *got_frame) {
+    pDecoder->stats.frames_decoded++;
+  }
+  return len;
+}
+
+int ac_decode_audio_package(lp_ac_package pPackage, lp_ac_audio_decoder pDecoder, lp_ac_decoder pDec) {
   //Make a copy of the package read by avformat, so that we can move the data pointers around
   AVPacket pkt_tmp = ((lp_ac_package_data)pPackage)->ffpackage;
   
-  AVFrame *decoded_frame = NULL;
-			
-  if (pDecoder->tmp_data_length > 0)
-  {
-	pkt_tmp.data = av_realloc(pkt_tmp.data, pkt_tmp.size + pDecoder->tmp_data_length);
-	pkt_tmp.size = pkt_tmp.size + pDecoder->tmp_data_length;
-	memcpy(pkt_tmp.data + pDecoder->tmp_data_length, &pkt_tmp.data, pkt_tmp.size);
-	memcpy(&pkt_tmp.data, pDecoder->tmp_data, pDecoder->tmp_data_length);
-  }  
+  if (pDecoder->pFrame == NULL && (pDecoder->pFrame = avcodec_alloc_frame()) == NULL) {
+    return 0;
+  }
   
-  while (pkt_tmp.size > 0) {  
+  int size = pDecoder->decoder.buffer_size;
   
-	if (!decoded_frame) {
-		if (!(decoded_frame = avcodec_alloc_frame())) {
-            return 0;
-        }
-    } else
-        avcodec_get_frame_defaults(decoded_frame);
-			
-	int got_frame = 0;
-	
-	int len1 = avcodec_decode_audio4(pDecoder->pCodecCtx, decoded_frame, &got_frame, &pkt_tmp);
-
-	
-    //If an error occured, skip the frame
-    if (len1 < 0){
-      return 0;    
+  //A package may contain several frames
+  while (pkt_tmp.size > 0) {
+    int got_frame = 0;
+    avcodec_get_frame_defaults(pDecoder->pFrame);
+    int len = ac_decode_audio_frame(pDecoder, &pkt_tmp, &got_frame);
+    
+    //If an error occured, skip the rest of the package
+    if (len < 0) {
+      break;
     }
-	    
-    //Increment the source buffer pointers     
-	pkt_tmp.size -= len1;
-	pkt_tmp.data += len1;
+    pkt_tmp.size -= len;
+    pkt_tmp.data += len;
     
-	if (got_frame){
-	  
-	  int data_size = av_samples_get_buffer_size(NULL, (pDecoder->pCodecCtx)->channels,
-                                                       decoded_frame->nb_samples,
-                                                       (pDecoder->pCodecCtx)->sample_fmt, 1);
-													   
-      //Reserve enough memory for coping the result data
-	  if (dest_buffer_pos + data_size > pDecoder->max_buffer_size) {
-	    pDecoder->decoder.pBuffer = av_realloc(pDecoder->decoder.pBuffer, dest_buffer_pos + data_size);
-		pDecoder->max_buffer_size = dest_buffer_pos + data_size;
-	  }
-	  memcpy(pDecoder->decoder.pBuffer + dest_buffer_pos, decoded_frame->data[0], data_size);
-	  
-      //Increment the destination buffer pointers, copy the result to the output buffer
-      dest_buffer_pos += data_size;
-      pDecoder->decoder.buffer_size += data_size;
-	  
-	  
-	  pts=0;
-	  
-	  if(((lp_ac_package_data)pPackage)->ffpackage.dts != AV_NOPTS_VALUE){
-		pts = ((lp_ac_package_data)pPackage)->ffpackage.dts * av_q2d(((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->time_base);
-	  
-		pDec->video_clock = pts;
-	  } else {
-		pts = pDec->video_clock;
-	  }
-	  
-	  double bytes_per_second = 2 * pDec->stream_info.audio_info.samples_per_second * pDec->stream_info.audio_info.channel_count;
-	  if (bytes_per_second > 0)
-		pDec->video_clock += data_size / bytes_per_second;
-		
-	  pDec->timecode = pts;
-	  
-	  if (pkt_tmp.size > 0)
-	  {
-		pDecoder->tmp_data = av_malloc(pkt_tmp.size);
-		memcpy(pDecoder->tmp_data, &pkt_tmp.data, pkt_tmp.size);
-	  } else {
-	    av_free(pDecoder->tmp_data);
-        pDecoder->tmp_data_length = 0;		
-	  }
-	  
-	  return 1;
-    }	  
+    if (got_frame) {
+      pDecoder->decoder.buffer_size += ac_convert_audio(pDecoder, pDecoder->pFrame,
+        (uint8_t**)&pDecoder->decoder.pBuffer, &pDecoder->max_buffer_size,
+        pDecoder->decoder.buffer_size);
+    }
   }
   
-  av_free(pDecoder->tmp_data);
-  pDecoder->tmp_data_length;
-  return 0;
+  int data_size = pDecoder->decoder.buffer_size - size;
+  if (data_size <= 0) {
+    return 0;
+  }
+  
+  double pts;
+  if (((lp_ac_package_data)pPackage)->ffpackage.dts != AV_NOPTS_VALUE) {
+    pts = ((lp_ac_package_data)pPackage)->ffpackage.dts * av_q2d(((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->time_base);
+    pDec->video_clock = pts;
+  } else {
+    pts = pDec->video_clock;
+  }
+  
+  double bytes_per_second = (double)ac_audio_frame_bytes(pDecoder) * pDecoder->out_rate;
+  if (bytes_per_second > 0) {
+    pDec->video_clock += data_size / bytes_per_second;
+  }
+  
+  //The timecode belongs to the first package in the buffer
+  if (size == 0) {
+    pDec->timecode = pts;
+  }
+  
+  return 1;
 }
 
 int CALL_CONVT ac_decode_package(lp_ac_package pPackage, lp_ac_decoder pDecoder) {
@@ -797,46 +2559,9 @@ int CALL_CONVT ac_drop_decode_package(lp_ac_package pPackage, lp_ac_decoder pDec
 }
 
 int ac_drop_decode_video_package(lp_ac_package pPackage, lp_ac_video_decoder pDecoder, lp_ac_decoder pDec) {
-  int finished;
-  double pts;
-  int len = 0;
-
-  AVPacket pkt_tmp = ((lp_ac_package_data)pPackage)->ffpackage;
-  
-  while (pkt_tmp.size > 0) {
-    len = avcodec_decode_video2(
-	  pDecoder->pCodecCtx, pDecoder->pFrame,
-	  &finished, &pkt_tmp);
-            
-	if (len < 0) {
-	  return 0;
-    }
-
-	pkt_tmp.size -= len;
-    pkt_tmp.data += len;
-  }
-  
-  if (finished) {
-	pts=0;
-    //global_video_pkt_pts = ((lp_ac_package_data)pPackage)->ffpackage.pts;
-	
-    if(((lp_ac_package_data)pPackage)->ffpackage.dts == AV_NOPTS_VALUE &&
-	  *(uint64_t*)pDecoder->pFrame->opaque != AV_NOPTS_VALUE ){
-	  pts = *(uint64_t*)pDecoder->pFrame->opaque;
-    } else if(((lp_ac_package_data)pPackage)->ffpackage.dts != AV_NOPTS_VALUE){
-      pts = ((lp_ac_package_data)pPackage)->ffpackage.dts;
-    } else {
-	  pts = 0;
-    }
-	
-	if(((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->start_time != AV_NOPTS_VALUE){
-      pts -= ((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->start_time;
-	}
-
-    pts *= av_q2d(((lp_ac_data)pDec->pacInstance)->pFormatCtx->streams[pPackage->stream_index]->time_base);
-	
-    pts = ac_sync_video(pPackage, pDec, pDecoder->pFrame, pts);
-	pDec->timecode = pts;
+  //The frame is decoded to keep the codec state intact, but not converted
+  if (ac_decode_video_frame(pDecoder, &((lp_ac_package_data)pPackage)->ffpackage)) {
+	pDec->timecode = ac_video_frame_pts(pDecoder, pDec);
 
     return 1;
   }
@@ -845,7 +2570,7 @@ int ac_drop_decode_video_package(lp_ac_package pPackage, lp_ac_video_decoder pDe
 
 int CALL_CONVT ac_get_audio_frame(lp_ac_instance pacInstance, lp_ac_decoder pDecoder) {
 
-	lp_ac_package pPackage = ac_read_package(pacInstance);
+	lp_ac_package pPackage = ac_next_package(pDecoder);
 	((lp_ac_audio_decoder)pDecoder)->decoder.buffer_size = 0;
 	
 	int done = 0;
@@ -859,10 +2584,10 @@ int CALL_CONVT ac_get_audio_frame(lp_ac_instance pacInstance, lp_ac_decoder pDec
 				done = 0;
 				
 			if (done == 0)
-				pPackage = ac_read_package(pacInstance);
+				pPackage = ac_next_package(pDecoder);
 		} else {
 			ac_free_package(pPackage);
-			pPackage = ac_read_package(pacInstance);
+			pPackage = ac_next_package(pDecoder);
 		}
 	}
 	
@@ -872,9 +2597,108 @@ int CALL_CONVT ac_get_audio_frame(lp_ac_instance pacInstance, lp_ac_decoder pDec
 		return 1;
 }
 
+//Decodes the next package of the audio stream into the carry buffer, which has
+//to be used up. Returns 0 at the end of the file.
+static int ac_fill_audio_carry(lp_ac_instance pacInstance, lp_ac_audio_decoder pDecoder)
+{
+  lp_ac_decoder pDec = &pDecoder->decoder;
+  AVStream *pStream = ((lp_ac_data)pacInstance)->pFormatCtx->streams[pDec->stream_index];
+  
+  pDecoder->carry_size = 0;
+  pDecoder->carry_pos = 0;
+  
+  if (pDecoder->pFrame == NULL && (pDecoder->pFrame = avcodec_alloc_frame()) == NULL) {
+    return 0;
+  }
+  
+  lp_ac_package pPackage;
+  while (pDecoder->carry_size == 0 &&
+         (pPackage = ac_next_package(pDec)) != NULL) {
+    if (pPackage->stream_index == pDec->stream_index) {
+      AVPacket pkt_tmp = ((lp_ac_package_data)pPackage)->ffpackage;
+      
+      //The samples continue where the last ones ended, unless the package knows
+      //its time
+      double time = pDecoder->carry_end;
+      if (pkt_tmp.dts != AV_NOPTS_VALUE) {
+        time = pkt_tmp.dts * av_q2d(pStream->time_base);
+      }
+      
+      //A package may contain several frames
+      while (pkt_tmp.size > 0) {
+        int got_frame = 0;
+        avcodec_get_frame_defaults(pDecoder->pFrame);
+        int len = ac_decode_audio_frame(pDecoder, &pkt_tmp, &got_frame);
+        if (len < 0) {
+          break;
+        }
+        pkt_tmp.size -= len;
+        pkt_tmp.data += len;
+        
+        if (got_frame) {
+          pDecoder->carry_size += ac_convert_audio(pDecoder, pDecoder->pFrame,
+            &pDecoder->carry, &pDecoder->carry_capacity, pDecoder->carry_size);
+        }
+      }
+      
+      if (pDecoder->carry_size > 0) {
+        pDecoder->carry_time = time;
+        pDecoder->carry_end = time;
+        if (pDecoder->out_rate > 0) {
+          pDecoder->carry_end += (double)(pDecoder->carry_size / ac_audio_frame_bytes(pDecoder)) /
+            pDecoder->out_rate;
+        }
+      }
+    }
+    ac_free_package(pPackage);
+  }
+  
+  return pDecoder->carry_size > 0;
+}
+
+int CALL_CONVT ac_read_audio_frames(lp_ac_instance pacInstance, lp_ac_decoder pDecoder, char *buffer, int frame_count) {
+  if (pDecoder->type != AC_DECODER_TYPE_AUDIO || frame_count <= 0) {
+    return 0;
+  }
+  
+  lp_ac_audio_decoder pAudioDecoder = (lp_ac_audio_decoder)pDecoder;
+  int frame_bytes = ac_audio_frame_bytes(pAudioDecoder);
+  if (frame_bytes <= 0) {
+    return 0;
+  }
+  
+  int wanted = frame_count * frame_bytes;
+  int written = 0;
+  while (written < wanted) {
+    if (pAudioDecoder->carry_pos >= pAudioDecoder->carry_size &&
+        !ac_fill_audio_carry(pacInstance, pAudioDecoder)) {
+      break;
+    }
+    
+    //The timecode belongs to the first sample in the buffer
+    if (written == 0) {
+      pDecoder->timecode = pAudioDecoder->carry_time;
+      if (pAudioDecoder->out_rate > 0) {
+        pDecoder->timecode += (double)(pAudioDecoder->carry_pos / frame_bytes) /
+          pAudioDecoder->out_rate;
+      }
+    }
+    
+    int count = pAudioDecoder->carry_size - pAudioDecoder->carry_pos;
+    if (count > wanted - written) {
+      count = wanted - written;
+    }
+    memcpy(buffer + written, pAudioDecoder->carry + pAudioDecoder->carry_pos, count);
+    pAudioDecoder->carry_pos += count;
+    written += count;
+  }
+  
+  return written / frame_bytes;
+}
+
 int CALL_CONVT ac_get_frame(lp_ac_instance pacInstance, lp_ac_decoder pDecoder) {
 
-	lp_ac_package pPackage = ac_read_package(pacInstance);
+	lp_ac_package pPackage = ac_next_package(pDecoder);
 	int done = 0;
 	int pcount = 0;
 	while(done == 0 && pPackage != NULL){		
@@ -883,12 +2707,18 @@ int CALL_CONVT ac_get_frame(lp_ac_instance pacInstance, lp_ac_decoder pDecoder)
 			ac_free_package(pPackage);
 			pcount++;
 			if (done == 0)
-				pPackage = ac_read_package(pacInstance);
+				pPackage = ac_next_package(pDecoder);
 		} else {
 			ac_free_package(pPackage);
-			pPackage = ac_read_package(pacInstance);
+			pPackage = ac_next_package(pDecoder);
 		}
 	}
+	
+	//At the end of the file, return the frames the decoder still holds
+	if (done == 0 && pDecoder->type == AC_DECODER_TYPE_VIDEO) {
+		done = ac_drain_video_decoder((lp_ac_video_decoder)pDecoder, pDecoder, 1);
+		pcount++;
+	}
 
 	if (done == 0)
 		return 0;
@@ -896,30 +2726,38 @@ int CALL_CONVT ac_get_frame(lp_ac_instance pacInstance, lp_ac_decoder pDecoder)
 		return pcount;
 }
 
-int CALL_CONVT ac_skip_frames(lp_ac_instance pacInstance, lp_ac_decoder pDecoder, int num) {
+//Skips the given number of frames without converting them
+static int ac_skip_decoded_frames(lp_ac_instance pacInstance, lp_ac_decoder pDecoder, int num) {
 
-	lp_ac_package pPackage = ac_read_package(pacInstance);
+	lp_ac_package pPackage = ac_next_package(pDecoder);
+	
+	//Video frames nobody refers to are not decoded at all while skipping, so
+	//each package of the stream counts as a frame
+	int count_packages = pDecoder->type == AC_DECODER_TYPE_VIDEO;
 	
 	int done = 0;
 	int i;
 	for(i=0; i<num; i++){
 		if (i>0)
-			pPackage = ac_read_package(pacInstance);
+			pPackage = ac_next_package(pDecoder);
 			
 		done = 0;
 		while(done == 0 && pPackage != NULL){		
 			if (((lp_ac_package_data)pPackage)->package.stream_index == pDecoder->stream_index){
-				done = ac_drop_decode_package(pPackage, pDecoder);
+				done = ac_drop_decode_package(pPackage, pDecoder) || count_packages;
 				ac_free_package(pPackage);
 				
 				if (done == 0)
-					pPackage = ac_read_package(pacInstance);
+					pPackage = ac_next_package(pDecoder);
 			} else {
 				ac_free_package(pPackage);
-				pPackage = ac_read_package(pacInstance);
+				pPackage = ac_next_package(pDecoder);
 			}
 		}
 		
+		if (done == 0 && pDecoder->type == AC_DECODER_TYPE_VIDEO)
+			done = ac_drain_video_decoder((lp_ac_video_decoder)pDecoder, pDecoder, 0);
+		
 		if (done == 0)
 			return 0;
 	}
@@ -930,10 +2768,94 @@ int CALL_CONVT ac_skip_frames(lp_ac_instance pacInstance, lp_ac_decoder pDecoder
 		return 1;
 }
 
+int CALL_CONVT ac_skip_frames(lp_ac_instance pacInstance, lp_ac_decoder pDecoder, int num) {
+	if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+		return ac_skip_decoded_frames(pacInstance, pDecoder, num);
+	}
+	
+	//The skipped frames are not shown, so the ones nobody refers to can be
+	//left out
+	lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+	int catch_up = pVideoDecoder->catch_up;
+	pVideoDecoder->catch_up = 1;
+	int result = ac_skip_decoded_frames(pacInstance, pDecoder, num);
+	pVideoDecoder->catch_up = catch_up;
+	return result;
+}
+
+
+
+//Seeks the file to the given timestamp in the time base of the stream of the
+//decoder and drops the data the decoder still holds
+static int ac_seek_stream(lp_ac_decoder pDecoder, int64_t timestamp, int flags)
+{
+  //A seek moves all streams of a shared instance, the queued packages of the
+  //other decoders are outdated then. The other streams drop the packages they
+  //have already got, an audio stream also those before its seek target.
+  lp_ac_data self = (lp_ac_data)pDecoder->pacInstance;
+  int shared = self->instance.shared_demux;
+  if (shared) {
+    pthread_mutex_lock(&self->demux_mutex);
+  }
+  int sought = av_seek_frame(self->pFormatCtx, pDecoder->stream_index, timestamp, flags) >= 0;
+  if (shared) {
+    if (sought) {
+      int i;
+      for (i = 0; i < self->queue_count; i++) {
+        ac_package_queue *pQueue = &self->queues[i];
+        ac_queue_flush(self, pQueue);
+        if (i != pDecoder->stream_index) {
+          pQueue->skip_until = pQueue->last_dts;
+        } else {
+          bool audio = pDecoder->type == AC_DECODER_TYPE_AUDIO && !(flags & AVSEEK_FLAG_BYTE);
+          pQueue->last_dts = audio ? timestamp - 1 : AV_NOPTS_VALUE;
+          pQueue->skip_until = AV_NOPTS_VALUE;
+          pQueue->resync = 0;
+        }
+      }
+    }
+    pthread_mutex_unlock(&self->demux_mutex);
+  }
+  
+  if (!sought) {
+    return 0;
+  }
+	
+  if (pDecoder->type == AC_DECODER_TYPE_AUDIO)
+  {
+	if (((lp_ac_audio_decoder)pDecoder)->pCodecCtx->codec->flush != NULL)
+		avcodec_flush_buffers(((lp_ac_audio_decoder)pDecoder)->pCodecCtx);
+	
+	//Drop the samples buffered by the resampler
+	swr_free(&((lp_ac_audio_decoder)pDecoder)->pSwrCtx);
+	((lp_ac_audio_decoder)pDecoder)->carry_size = 0;
+	((lp_ac_audio_decoder)pDecoder)->carry_pos = 0;
+	((lp_ac_audio_decoder)pDecoder)->carry_end = pDecoder->timecode;
+  }
+  else if (pDecoder->type == AC_DECODER_TYPE_VIDEO)
+  {
+	//Drop the frames which are still in flight, otherwise frames from before
+	//the seek would be returned
+	avcodec_flush_buffers(((lp_ac_video_decoder)pDecoder)->pCodecCtx);
+  }
+  return 1;
+}
 
+//Counts a seek which has been started at the given time
+static void ac_stats_seek(lp_ac_decoder pDecoder, int64_t start)
+{
+  lp_ac_stats pStats = ac_decoder_stats(pDecoder);
+  int64_t time = av_gettime() - start;
+  pStats->seek_count++;
+  pStats->seek_time += time;
+  if (time > pStats->seek_time_max) {
+    pStats->seek_time_max = time;
+  }
+}
 
 //Seek function
 int CALL_CONVT ac_seek(lp_ac_decoder pDecoder, int dir, int64_t target_pos) {
+  int64_t start = av_gettime();
   AVRational timebase = 
     ((lp_ac_data)pDecoder->pacInstance)->pFormatCtx->streams[pDecoder->stream_index]->time_base;
   
@@ -942,57 +2864,924 @@ int CALL_CONVT ac_seek(lp_ac_decoder pDecoder, int dir, int64_t target_pos) {
   int64_t pos = av_rescale(target_pos, AV_TIME_BASE, 1000);
   
   ((lp_ac_decoder_data)pDecoder)->sought = 100;
-  pDecoder->timecode = target_pos / 1000;
-  
-  if (av_seek_frame(((lp_ac_data)pDecoder->pacInstance)->pFormatCtx, pDecoder->stream_index, 
-      av_rescale_q(pos, AV_TIME_BASE_Q, timebase), flags) >= 0) {
-	
-	if (pDecoder->type == AC_DECODER_TYPE_AUDIO)
-	{
-		if (((lp_ac_audio_decoder)pDecoder)->pCodecCtx->codec->flush != NULL)
-			avcodec_flush_buffers(((lp_ac_audio_decoder)pDecoder)->pCodecCtx);
-	
-		av_free(((lp_ac_audio_decoder)pDecoder)->tmp_data);
-		((lp_ac_audio_decoder)pDecoder)->tmp_data_length = 0;
-	}
-    return 1;
-  }
+  pDecoder->timecode = target_pos / 1000.0;
   
-  return 0;  
+  int result = ac_seek_stream(pDecoder, av_rescale_q(pos, AV_TIME_BASE_Q, timebase), flags);
+  ac_stats_seek(pDecoder, start);
+  return result;
 }
 
-//Free video decoder
-void ac_free_video_decoder(lp_ac_video_decoder pDecoder) {  
-  av_free(pDecoder->pFrame);
-  av_free(pDecoder->pFrameRGB);    
-  if (pDecoder->pSwsCtx != NULL) {
-    sws_freeContext(pDecoder->pSwsCtx);
+//
+//--- Keyframe index ---
+//
+
+static void ac_add_keyframe(lp_ac_video_decoder pDecoder, int64_t pts, int64_t pos)
+{
+  if (pts == AV_NOPTS_VALUE) {
+    return;
   }
-  avcodec_close(pDecoder->pCodecCtx);
   
-  //Free reserved memory for the buffer
-  av_free(pDecoder->decoder.pBuffer);
+  if (pDecoder->keyframe_count == pDecoder->keyframe_capacity) {
+    int capacity = pDecoder->keyframe_capacity > 0 ? pDecoder->keyframe_capacity * 2 : 64;
+    ac_keyframe *keyframes = (ac_keyframe*)av_realloc(pDecoder->keyframes, capacity * sizeof(ac_keyframe));
+    if (keyframes == NULL) {
+      return;
+    }
+    pDecoder->keyframes = keyframes;
+    pDecoder->keyframe_capacity = capacity;
+  }
   
-  //Free reserved memory for decoder record
-  av_free(pDecoder);
+  pDecoder->keyframes[pDecoder->keyframe_count].pts = pts;
+  pDecoder->keyframes[pDecoder->keyframe_count].pos = pos;
+  pDecoder->keyframe_count++;
 }
 
-//Free video decoder
-void ac_free_audio_decoder(lp_ac_audio_decoder pDecoder) {
-//  av_free(pDecoder->decoder.pBuffer);
-  avcodec_close(pDecoder->pCodecCtx);
+static int ac_compare_keyframes(const void *a, const void *b)
+{
+  int64_t pts_a = ((const ac_keyframe*)a)->pts;
+  int64_t pts_b = ((const ac_keyframe*)b)->pts;
+  return pts_a < pts_b ? -1 : (pts_a > pts_b ? 1 : 0);
+}
+
+//Returns the last keyframe at or before the given timestamp, -1 if there is none
+static int ac_find_keyframe(lp_ac_video_decoder pDecoder, int64_t timestamp)
+{
+  int lo = 0;
+  int hi = pDecoder->keyframe_count - 1;
+  int result = -1;
+  
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (pDecoder->keyframes[mid].pts <= timestamp) {
+      result = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  
+  return result;
+}
+
+int CALL_CONVT ac_build_keyframe_index(lp_ac_decoder pDecoder, bool scan) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return 0;
+  }
+  
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  lp_ac_data self = (lp_ac_data)pDecoder->pacInstance;
+  AVStream *pStream = self->pFormatCtx->streams[pDecoder->stream_index];
+  
+  pVideoDecoder->keyframe_count = 0;
+  pVideoDecoder->keyframes_scanned = 0;
+  pVideoDecoder->keyframes_built = 1;
+  
+  //Most containers have an index which the demuxer has read while opening
+  int i;
+  for (i = 0; i < pStream->nb_index_entries; i++) {
+    if (pStream->index_entries[i].flags & AVINDEX_KEYFRAME) {
+      ac_add_keyframe(pVideoDecoder, pStream->index_entries[i].timestamp, pStream->index_entries[i].pos);
+    }
+  }
+  
+  if (pVideoDecoder->keyframe_count > 1 || !scan) {
+    return pVideoDecoder->keyframe_count;
+  }
+  
+  //Otherwise all packages of the file are read once
+  pVideoDecoder->keyframe_count = 0;
+  if (!ac_seek_stream(pDecoder, 0, AVSEEK_FLAG_BACKWARD)) {
+    return 0;
+  }
+  
+  if (self->instance.shared_demux) {
+    pthread_mutex_lock(&self->demux_mutex);
+  }
+  AVPacket pkt;
+  while (av_read_frame(self->pFormatCtx, &pkt) >= 0) {
+    if (pkt.stream_index == pDecoder->stream_index && (pkt.flags & AV_PKT_FLAG_KEY)) {
+      ac_add_keyframe(pVideoDecoder, pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts, pkt.pos);
+    }
+    ac_release_packet(&pkt);
+  }
+  if (self->instance.shared_demux) {
+    pthread_mutex_unlock(&self->demux_mutex);
+  }
+  
+  qsort(pVideoDecoder->keyframes, pVideoDecoder->keyframe_count, sizeof(ac_keyframe), ac_compare_keyframes);
+  pVideoDecoder->keyframes_scanned = 1;
+  
+  ac_seek_stream(pDecoder, 0, AVSEEK_FLAG_BACKWARD);
+  
+  return pVideoDecoder->keyframe_count;
+}
+
+//Decodes the frames up to the given time without converting them, the first
+//frame at the time is converted
+static int ac_decode_video_to(lp_ac_video_decoder pDecoder, lp_ac_decoder pDec, double time)
+{
+  //A frame which is shown at the target time is good enough
+  double tolerance = 0.02;
+  if (pDec->stream_info.video_info.frames_per_second > 0) {
+    tolerance = 0.5 / pDec->stream_info.video_info.frames_per_second;
+  }
+  
+  lp_ac_package pPackage;
+  while ((pPackage = ac_next_package(pDec)) != NULL) {
+    int done = 0;
+    if (pPackage->stream_index == pDec->stream_index) {
+      done = ac_decode_video_frame(pDecoder, &((lp_ac_package_data)pPackage)->ffpackage);
+    }
+    ac_free_package(pPackage);
+    
+    if (done) {
+      pDec->timecode = ac_video_frame_pts(pDecoder, pDec);
+      if (pDec->timecode >= time - tolerance) {
+        ac_convert_video_frame(pDecoder, pDec->timecode);
+        return 1;
+      }
+      pDecoder->stats.frames_sought++;
+    }
+  }
+  
+  //At the end of the file, the frames the codec still holds
+  while (ac_drain_video_decoder(pDecoder, pDec, 0)) {
+    if (pDec->timecode >= time - tolerance) {
+      ac_convert_video_frame(pDecoder, pDec->timecode);
+      return 1;
+    }
+    pDecoder->stats.frames_sought++;
+  }
+  
+  return 0;
+}
+
+int CALL_CONVT ac_seek_accurate(lp_ac_decoder pDecoder, double time) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return ac_seek(pDecoder, -1, (int64_t)(time * 1000.0));
+  }
+  
+  int64_t start = av_gettime();
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  lp_ac_data self = (lp_ac_data)pDecoder->pacInstance;
+  AVStream *pStream = self->pFormatCtx->streams[pDecoder->stream_index];
+  
+  if (time < 0) {
+    time = 0;
+  }
+  
+  int64_t timestamp = (int64_t)(time / av_q2d(pStream->time_base));
+  if (pStream->start_time != AV_NOPTS_VALUE) {
+    timestamp += pStream->start_time;
+  }
+  
+  if (!pVideoDecoder->keyframes_built) {
+    ac_build_keyframe_index(pDecoder, 0);
+  }
+  
+  //Jump to the keyframe before the target. Keyframes found by scanning the file
+  //are reached by their position, the demuxer may not be able to find them by
+  //their timestamp.
+  int sought;
+  int nb = ac_find_keyframe(pVideoDecoder, timestamp);
+  if (nb >= 0 && pVideoDecoder->keyframes_scanned && pVideoDecoder->keyframes[nb].pos >= 0 &&
+      !(self->pFormatCtx->iformat->flags & AVFMT_NO_BYTE_SEEK)) {
+    sought = ac_seek_stream(pDecoder, pVideoDecoder->keyframes[nb].pos, AVSEEK_FLAG_BYTE);
+  } else {
+    sought = ac_seek_stream(pDecoder, nb >= 0 ? pVideoDecoder->keyframes[nb].pts : timestamp,
+      AVSEEK_FLAG_BACKWARD);
+  }
+  
+  if (!sought) {
+    ac_stats_seek(pDecoder, start);
+    return 0;
+  }
+  
+  ((lp_ac_decoder_data)pDecoder)->sought = 100;
+  pDecoder->video_clock = 0;
+  
+  int result = ac_decode_video_to(pVideoDecoder, pDecoder, time);
+  ac_stats_seek(pDecoder, start);
+  return result;
+}
+
+//
+//--- Decode scheduler ---
+//
+
+//The decode ahead of all video decoders runs on one pool of worker threads.
+//Each priority class has a queue of the tasks which have work, a worker always
+//takes the first task of the highest class and does one unit of it. A task
+//with more work goes to the end of its queue again, so the tasks of a class
+//take turns and a higher class never waits for more than one unit per worker.
+static pthread_mutex_t ac_sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ac_sched_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ac_sched_done = PTHREAD_COND_INITIALIZER;
+static lp_ac_task ac_sched_head[AC_PRIORITY_COUNT];
+static lp_ac_task ac_sched_tail[AC_PRIORITY_COUNT];
+static int ac_sched_workers = 0;
+
+//Appends a task to the queue of its class, the scheduler mutex has to be held
+static void ac_sched_push(lp_ac_task pTask)
+{
+  int priority = pTask->priority;
+  pTask->next = NULL;
+  if (ac_sched_tail[priority] != NULL) {
+    ac_sched_tail[priority]->next = pTask;
+  } else {
+    ac_sched_head[priority] = pTask;
+  }
+  ac_sched_tail[priority] = pTask;
+  pTask->state = AC_TASK_QUEUED;
+  pthread_cond_signal(&ac_sched_work);
+}
+
+//Removes a queued task from the queue of its class, the scheduler mutex has to
+//be held
+static void ac_sched_remove(lp_ac_task pTask)
+{
+  int priority = pTask->priority;
+  lp_ac_task pPrev = NULL;
+  lp_ac_task pCur = ac_sched_head[priority];
+  while (pCur != NULL && pCur != pTask) {
+    pPrev = pCur;
+    pCur = pCur->next;
+  }
+  if (pCur == NULL) {
+    return;
+  }
+  
+  if (pPrev != NULL) {
+    pPrev->next = pTask->next;
+  } else {
+    ac_sched_head[priority] = pTask->next;
+  }
+  if (ac_sched_tail[priority] == pTask) {
+    ac_sched_tail[priority] = pPrev;
+  }
+  pTask->next = NULL;
+  pTask->state = AC_TASK_IDLE;
+}
+
+static void* ac_sched_worker(void *param)
+{
+  pthread_mutex_lock(&ac_sched_mutex);
+  while (1) {
+    lp_ac_task pTask = NULL;
+    int i;
+    for (i = 0; i < AC_PRIORITY_COUNT && pTask == NULL; i++) {
+      pTask = ac_sched_head[i];
+    }
+    if (pTask == NULL) {
+      pthread_cond_wait(&ac_sched_work, &ac_sched_mutex);
+      continue;
+    }
+    
+    ac_sched_remove(pTask);
+    pTask->state = AC_TASK_RUNNING;
+    pTask->rerun = 0;
+    pthread_mutex_unlock(&ac_sched_mutex);
+    
+    int more = pTask->proc(pTask->param);
+    
+    pthread_mutex_lock(&ac_sched_mutex);
+    if ((more || pTask->rerun) && !pTask->cancelled) {
+      ac_sched_push(pTask);
+    } else {
+      pTask->state = AC_TASK_IDLE;
+    }
+    pthread_cond_broadcast(&ac_sched_done);
+  }
+  
+  return NULL;
+}
+
+//Starts the workers with the first task. One core is left to the threads which
+//render and play the audio. Returns 0 if no worker could be started.
+static int ac_sched_start(void)
+{
+  pthread_mutex_lock(&ac_sched_mutex);
+  if (ac_sched_workers == 0) {
+    int count = FFMAX(ac_cpu_count() - 1, 1);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    
+    pthread_t thread;
+    while (ac_sched_workers < count &&
+           pthread_create(&thread, &attr, ac_sched_worker, NULL) == 0) {
+      ac_sched_workers++;
+    }
+    pthread_attr_destroy(&attr);
+  }
+  int started = ac_sched_workers > 0;
+  pthread_mutex_unlock(&ac_sched_mutex);
+  
+  return started;
+}
+
+static void ac_task_init(lp_ac_task pTask, ac_task_proc proc, void *param)
+{
+  memset(pTask, 0, sizeof(ac_task));
+  pTask->proc = proc;
+  pTask->param = param;
+  pTask->priority = AC_PRIORITY_PREVIEW;
+}
+
+//Lets a worker run the task, or run it once more if it is running right now
+static void ac_task_schedule(lp_ac_task pTask)
+{
+  pthread_mutex_lock(&ac_sched_mutex);
+  if (!pTask->cancelled) {
+    if (pTask->state == AC_TASK_IDLE) {
+      ac_sched_push(pTask);
+    } else if (pTask->state == AC_TASK_RUNNING) {
+      pTask->rerun = 1;
+    }
+  }
+  pthread_mutex_unlock(&ac_sched_mutex);
+}
+
+static void ac_task_set_priority(lp_ac_task pTask, int priority)
+{
+  if (priority < 0 || priority >= AC_PRIORITY_COUNT) {
+    return;
+  }
+  
+  pthread_mutex_lock(&ac_sched_mutex);
+  if (pTask->state == AC_TASK_QUEUED) {
+    ac_sched_remove(pTask);
+    pTask->priority = priority;
+    ac_sched_push(pTask);
+  } else {
+    pTask->priority = priority;
+  }
+  pthread_mutex_unlock(&ac_sched_mutex);
+}
+
+//Takes the task off the scheduler and waits until no worker runs it anymore
+static void ac_task_cancel(lp_ac_task pTask)
+{
+  pthread_mutex_lock(&ac_sched_mutex);
+  pTask->cancelled = 1;
+  if (pTask->state == AC_TASK_QUEUED) {
+    ac_sched_remove(pTask);
+  }
+  while (pTask->state != AC_TASK_IDLE) {
+    pthread_cond_wait(&ac_sched_done, &ac_sched_mutex);
+  }
+  pthread_mutex_unlock(&ac_sched_mutex);
+}
+
+//
+//--- Decode ahead ---
+//
+
+//Gives the references of the loop cache back
+static void ac_loop_cache_clear(lp_ac_decode_ahead pAhead, int state)
+{
+  int i;
+  for (i = 0; i < pAhead->cache_count; i++) {
+    ac_release_frame(&pAhead->cache[i]->frame);
+  }
+  pAhead->cache_count = 0;
+  pAhead->cache_bytes = 0;
+  pAhead->cache_state = state;
+  pAhead->replaying = 0;
+}
+
+//Starts to fill the loop cache with the pass which begins at the start of the
+//video, if the video loops and its frames fit into the budget
+static void ac_loop_cache_begin(lp_ac_decoder pDecoder, lp_ac_decode_ahead pAhead)
+{
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  if (pAhead->cache_state == AC_LOOP_CACHE_FAILED) {
+    return;
+  }
+  ac_loop_cache_clear(pAhead, AC_LOOP_CACHE_NONE);
+  
+  if (!pAhead->loop || pVideoDecoder->loop_cache_size <= 0) {
+    return;
+  }
+  
+  double duration = pDecoder->pacInstance->info.duration / 1000.0;
+  if (duration <= 0 || duration > pVideoDecoder->loop_cache_duration ||
+      duration / pAhead->frame_duration * pDecoder->buffer_size > pVideoDecoder->loop_cache_size) {
+    pAhead->cache_state = AC_LOOP_CACHE_FAILED;
+    return;
+  }
+  
+  pAhead->cache_state = AC_LOOP_CACHE_FILLING;
+}
+
+//Keeps a reference on a frame of the pass which fills the loop cache
+static void ac_loop_cache_add(lp_ac_decoder pDecoder, lp_ac_decode_ahead pAhead, lp_ac_frame pFrame)
+{
+  if (pAhead->cache_state != AC_LOOP_CACHE_FILLING) {
+    return;
+  }
+  
+  //Frames decoded with a lower quality are not kept for all following passes
+  AVCodecContext *pCodecCtx = ((lp_ac_video_decoder)pDecoder)->pCodecCtx;
+  if (pCodecCtx->skip_frame != AVDISCARD_DEFAULT || pCodecCtx->skip_loop_filter != AVDISCARD_DEFAULT ||
+      pCodecCtx->skip_idct != AVDISCARD_DEFAULT) {
+    ac_loop_cache_clear(pAhead, AC_LOOP_CACHE_NONE);
+    return;
+  }
+  
+  //The duration of the file may have been wrong
+  if (pAhead->cache_bytes + pFrame->buffer_size > ((lp_ac_video_decoder)pDecoder)->loop_cache_size) {
+    ac_loop_cache_clear(pAhead, AC_LOOP_CACHE_FAILED);
+    return;
+  }
+  
+  if (pAhead->cache_count >= pAhead->cache_capacity) {
+    int capacity = pAhead->cache_capacity > 0 ? pAhead->cache_capacity * 2 : 64;
+    lp_ac_frame_data *cache = (lp_ac_frame_data*)av_realloc(pAhead->cache,
+      capacity * sizeof(lp_ac_frame_data));
+    if (cache == NULL) {
+      ac_loop_cache_clear(pAhead, AC_LOOP_CACHE_FAILED);
+      return;
+    }
+    pAhead->cache = cache;
+    pAhead->cache_capacity = capacity;
+  }
+  
+  ac_atomic_inc(&((lp_ac_frame_data)pFrame)->refcount);
+  pAhead->cache[pAhead->cache_count++] = (lp_ac_frame_data)pFrame;
+  pAhead->cache_bytes += pFrame->buffer_size;
+}
+
+//Seeks to the requested position, called by the decode ahead task
+static void ac_decode_ahead_do_seek(lp_ac_decoder pDecoder, lp_ac_decode_ahead pAhead, double time)
+{
+  ac_release_frame(pAhead->pending);
+  pAhead->pending = NULL;
+  
+  if (pAhead->cache_state == AC_LOOP_CACHE_COMPLETE) {
+    //Continue with the first cached frame which is shown at the time
+    double tolerance = pAhead->frame_duration / 2;
+    pAhead->replay_pos = 0;
+    while (pAhead->replay_pos < pAhead->cache_count - 1 &&
+           pAhead->cache[pAhead->replay_pos]->frame.timecode < time - tolerance) {
+      pAhead->replay_pos++;
+    }
+    pAhead->replaying = 1;
+  } else {
+    //The frames up to the target are decoded without converting them
+    if (ac_seek_accurate(pDecoder, time)) {
+      pAhead->pending = ac_get_video_frame(pDecoder);
+    } else {
+      ac_seek(pDecoder, -1, (int64_t)(time * 1000.0));
+    }
+    
+    //Only a pass from the start of the video can be replayed
+    if (time <= 0) {
+      ac_loop_cache_begin(pDecoder, pAhead);
+    } else if (pAhead->cache_state == AC_LOOP_CACHE_FILLING) {
+      ac_loop_cache_clear(pAhead, AC_LOOP_CACHE_NONE);
+    }
+  }
+  pAhead->last_time = time;
+  pAhead->loop_offset = 0;
+  pAhead->eof = 0;
+  pAhead->stalled = 0;
+  pAhead->pass_frames = 0;
+  
+  //The lateness before the seek says nothing about the new position
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  pVideoDecoder->catch_up = 0;
+  pVideoDecoder->late_count = 0;
+  pVideoDecoder->early_count = 0;
+}
+
+//Raises the automatic discard level if the decoding lags behind the
+//presentation for several frames and lowers it if the decoding stays ahead
+static void ac_update_auto_discard(lp_ac_video_decoder pDecoder, double late_frames)
+{
+  if (!pDecoder->auto_discard) {
+    return;
+  }
+  
+  if (late_frames >= 2) {
+    pDecoder->early_count = 0;
+    if (++pDecoder->late_count >= AC_DISCARD_RAISE_FRAMES && pDecoder->auto_level < AC_DISCARD_MAX_LEVEL) {
+      pDecoder->auto_level++;
+      pDecoder->late_count = 0;
+    }
+  } else if (late_frames <= 0) {
+    pDecoder->late_count = 0;
+    if (++pDecoder->early_count >= AC_DISCARD_LOWER_FRAMES && pDecoder->auto_level > 0) {
+      pDecoder->auto_level--;
+      pDecoder->early_count = 0;
+    }
+  } else {
+    pDecoder->late_count = 0;
+  }
+  pDecoder->stats.discard_level = pDecoder->auto_level;
+}
+
+//Appends a referenced frame to the ring, which must have space for it
+static void ac_decode_ahead_push(lp_ac_decoder pDecoder, lp_ac_decode_ahead pAhead, lp_ac_frame pFrame)
+{
+  ac_loop_cache_add(pDecoder, pAhead, pFrame);
+  
+  ac_ahead_entry *pEntry = &pAhead->ring[pAhead->head % pAhead->ring_size];
+  pEntry->pFrame = (lp_ac_frame_data)pFrame;
+  pEntry->time = pAhead->loop_offset + pFrame->timecode;
+  pEntry->generation = pAhead->decode_generation;
+  pAhead->last_time = pEntry->time;
+  pAhead->pass_frames++;
+  
+  //The entry has to be complete before the reader sees it
+  __sync_synchronize();
+  pAhead->head++;
+}
+
+//Does one step of the decode ahead on a worker of the decode scheduler, which
+//pushes at most one frame. Returns 0 if there is nothing to do until a frame
+//slot gets free or something is requested.
+static int ac_decode_ahead_step(void *arg)
+{
+  lp_ac_decoder pDecoder = (lp_ac_decoder)arg;
+  lp_ac_decode_ahead pAhead = ((lp_ac_video_decoder)pDecoder)->ahead;
+  
+  pthread_mutex_lock(&pAhead->mutex);
+  
+  if (pAhead->terminated || (!pAhead->seek_pending &&
+      (pAhead->head - pAhead->tail >= pAhead->ring_size || (pAhead->eof && (!pAhead->loop || pAhead->stalled))))) {
+    pthread_mutex_unlock(&pAhead->mutex);
+    return 0;
+  }
+  
+  int seek = pAhead->seek_pending;
+  double seek_time = pAhead->seek_time;
+  pAhead->seek_pending = 0;
+  if (seek) {
+    pAhead->decode_generation = pAhead->generation;
+  }
+  
+  pthread_mutex_unlock(&pAhead->mutex);
+  
+  if (seek) {
+    ac_decode_ahead_do_seek(pDecoder, pAhead, seek_time);
+    return 1;
+  }
+  
+  //At the end of the file the video starts over, the timecodes of the next
+  //pass continue where the last one ended
+  if (pAhead->eof) {
+    double offset = pAhead->last_time + pAhead->frame_duration;
+    if (pAhead->cache_state == AC_LOOP_CACHE_FILLING && pAhead->cache_count > 0) {
+      pAhead->cache_state = AC_LOOP_CACHE_COMPLETE;
+    }
+    ac_decode_ahead_do_seek(pDecoder, pAhead, 0);
+    pAhead->loop_offset = offset;
+    pAhead->last_time = offset;
+    return 1;
+  }
+  
+  if (pAhead->pending != NULL) {
+    ac_decode_ahead_push(pDecoder, pAhead, pAhead->pending);
+    pAhead->pending = NULL;
+    return 1;
+  }
+  
+  if (pAhead->replaying) {
+    if (pAhead->replay_pos < pAhead->cache_count) {
+      lp_ac_frame_data pCached = pAhead->cache[pAhead->replay_pos++];
+      ac_atomic_inc(&pCached->refcount);
+      ac_decode_ahead_push(pDecoder, pAhead, &pCached->frame);
+    } else {
+      pAhead->eof = 1;
+    }
+    return 1;
+  }
+  
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  double late_frames = (pAhead->time - pAhead->last_time) / pAhead->frame_duration;
+  ac_update_auto_discard(pVideoDecoder, late_frames);
+  
+  //Skip frames without converting them if the presentation time is ahead.
+  //The frames nobody refers to are left out until the next keyframe or until
+  //the decoding has caught up.
+  int done = 1;
+  if (late_frames >= AC_AHEAD_DROP_COUNT) {
+    done = ac_skip_frames(pDecoder->pacInstance, pDecoder, AC_AHEAD_DROP_COUNT);
+    
+    //A pass with gaps is not cached, the next one may be decoded in time
+    if (pAhead->cache_state == AC_LOOP_CACHE_FILLING) {
+      ac_loop_cache_clear(pAhead, AC_LOOP_CACHE_NONE);
+    }
+    if (pVideoDecoder->auto_discard) {
+      pVideoDecoder->catch_up = 2;
+    }
+  } else if (late_frames < 1 && pVideoDecoder->catch_up == 2) {
+    pVideoDecoder->catch_up = 0;
+  }
+  if (done) {
+    done = ac_get_frame(pDecoder->pacInstance, pDecoder);
+  }
+  
+  lp_ac_frame pFrame = done ? ac_get_video_frame(pDecoder) : NULL;
+  if (pFrame == NULL) {
+    pAhead->stalled = pAhead->pass_frames == 0;
+    pAhead->eof = 1;
+    return 1;
+  }
+  ac_decode_ahead_push(pDecoder, pAhead, pFrame);
+  return 1;
+}
+
+int CALL_CONVT ac_start_decode_ahead(lp_ac_decoder pDecoder, int frame_count, bool loop) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO || frame_count <= 0) {
+    return 0;
+  }
+  
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  if (!pVideoDecoder->use_pool || pVideoDecoder->ahead != NULL) {
+    return 0;
+  }
+  
+  lp_ac_decode_ahead pAhead = (lp_ac_decode_ahead)av_malloc(sizeof(ac_decode_ahead));
+  if (pAhead == NULL) {
+    return 0;
+  }
+  memset(pAhead, 0, sizeof(ac_decode_ahead));
+  
+  pAhead->ring_size = frame_count;
+  pAhead->ring = (ac_ahead_entry*)av_malloc(frame_count * sizeof(ac_ahead_entry));
+  if (pAhead->ring == NULL) {
+    av_free(pAhead);
+    return 0;
+  }
+  
+  pAhead->loop = loop;
+  pAhead->frame_duration = 0.04;
+  if (pDecoder->stream_info.video_info.frames_per_second > 0) {
+    pAhead->frame_duration = 1.0 / pDecoder->stream_info.video_info.frames_per_second;
+  }
+  pAhead->last_time = pDecoder->timecode;
+  pAhead->time = pDecoder->timecode;
+  
+  if (!ac_sched_start()) {
+    av_free(pAhead->ring);
+    av_free(pAhead);
+    return 0;
+  }
+  
+  pthread_mutex_init(&pAhead->mutex, NULL);
+  ac_task_init(&pAhead->task, ac_decode_ahead_step, pDecoder);
+  ac_task_set_priority(&pAhead->task, pVideoDecoder->priority);
+  
+  pVideoDecoder->ahead = pAhead;
+  if (pAhead->last_time <= 0) {
+    ac_loop_cache_begin(pDecoder, pAhead);
+  }
+  ac_task_schedule(&pAhead->task);
+  
+  return 1;
+}
+
+void CALL_CONVT ac_stop_decode_ahead(lp_ac_decoder pDecoder) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return;
+  }
+  
+  lp_ac_decode_ahead pAhead = ((lp_ac_video_decoder)pDecoder)->ahead;
+  if (pAhead == NULL) {
+    return;
+  }
+  
+  pthread_mutex_lock(&pAhead->mutex);
+  pAhead->terminated = 1;
+  pthread_mutex_unlock(&pAhead->mutex);
+  ac_task_cancel(&pAhead->task);
+  ac_release_frame(pAhead->pending);
+  ac_loop_cache_clear(pAhead, AC_LOOP_CACHE_NONE);
+  av_free(pAhead->cache);
+  
+  //Release the frames nobody has asked for
+  while (pAhead->tail != pAhead->head) {
+    ac_release_frame(&pAhead->ring[pAhead->tail % pAhead->ring_size].pFrame->frame);
+    pAhead->tail++;
+  }
+  
+  pthread_mutex_destroy(&pAhead->mutex);
+  av_free(pAhead->ring);
+  av_free(pAhead);
+  ((lp_ac_video_decoder)pDecoder)->ahead = NULL;
+}
+
+void CALL_CONVT ac_decode_ahead_seek(lp_ac_decoder pDecoder, double time) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return;
+  }
+  
+  lp_ac_decode_ahead pAhead = ((lp_ac_video_decoder)pDecoder)->ahead;
+  if (pAhead == NULL) {
+    return;
+  }
+  
+  pthread_mutex_lock(&pAhead->mutex);
+  pAhead->generation++;
+  pAhead->seek_pending = 1;
+  pAhead->seek_time = time;
+  pAhead->time = time;
+  pthread_mutex_unlock(&pAhead->mutex);
+  ac_task_schedule(&pAhead->task);
+}
+
+void CALL_CONVT ac_decode_ahead_loop(lp_ac_decoder pDecoder, bool loop) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return;
+  }
+  
+  lp_ac_decode_ahead pAhead = ((lp_ac_video_decoder)pDecoder)->ahead;
+  if (pAhead == NULL) {
+    return;
+  }
+  
+  pthread_mutex_lock(&pAhead->mutex);
+  pAhead->loop = loop;
+  pthread_mutex_unlock(&pAhead->mutex);
+  ac_task_schedule(&pAhead->task);
+}
+
+lp_ac_frame CALL_CONVT ac_get_frame_at(lp_ac_decoder pDecoder, double time) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return NULL;
+  }
+  
+  lp_ac_decode_ahead pAhead = ((lp_ac_video_decoder)pDecoder)->ahead;
+  if (pAhead == NULL) {
+    return NULL;
+  }
+  
+  pAhead->time = time;
+  
+  //Take all frames which are due, only the latest of them is returned. Frames
+  //decoded before the last seek are thrown away.
+  lp_ac_frame_data pResult = NULL;
+  int generation = pAhead->generation;
+  int popped = 0;
+  while (pAhead->tail != pAhead->head) {
+    __sync_synchronize();
+    ac_ahead_entry *pEntry = &pAhead->ring[pAhead->tail % pAhead->ring_size];
+    
+    if (pEntry->generation == generation) {
+      if (pEntry->time > time) {
+        break;
+      }
+      if (pResult != NULL) {
+        ac_release_frame(&pResult->frame);
+        ac_decoder_stats(pDecoder)->frames_late++;
+      }
+      pResult = pEntry->pFrame;
+    } else {
+      ac_release_frame(&pEntry->pFrame->frame);
+    }
+    
+    __sync_synchronize();
+    pAhead->tail++;
+    popped = 1;
+  }
+  
+  //Continue the decode ahead, there is space in the ring again
+  if (popped) {
+    ac_task_schedule(&pAhead->task);
+  }
+  
+  return pResult != NULL ? &pResult->frame : NULL;
+}
+
+void CALL_CONVT ac_get_stats(lp_ac_decoder pDecoder, lp_ac_stats stats) {
+  lp_ac_data self = (lp_ac_data)pDecoder->pacInstance;
+  *stats = *ac_decoder_stats(pDecoder);
+  
+  //The reading is done for the whole instance
+  stats->packets_read = self->stats.packets_read;
+  stats->bytes_read = self->stats.bytes_read;
+  stats->read_time = self->stats.read_time;
+  stats->max_package_size = self->stats.max_package_size;
+  stats->max_queued_packages = self->stats.max_queued_packages;
+  
+  //The output buffers only grow
+  if (pDecoder->type == AC_DECODER_TYPE_VIDEO) {
+    lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+    stats->frames_dropped = stats->frames_decoded - stats->frames_sought - pVideoDecoder->frames_converted;
+    stats->max_buffer_size = pDecoder->buffer_size;
+  } else if (pDecoder->type == AC_DECODER_TYPE_AUDIO) {
+    lp_ac_audio_decoder pAudioDecoder = (lp_ac_audio_decoder)pDecoder;
+    stats->max_buffer_size = FFMAX(pAudioDecoder->max_buffer_size, pAudioDecoder->carry_capacity);
+  }
+}
+
+void CALL_CONVT ac_set_discard(lp_ac_decoder pDecoder, ac_discard skip_frame,
+  ac_discard skip_loop_filter, ac_discard skip_idct) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return;
+  }
+  
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  pVideoDecoder->skip_frame = skip_frame;
+  pVideoDecoder->skip_loop_filter = skip_loop_filter;
+  pVideoDecoder->skip_idct = skip_idct;
+}
+
+void CALL_CONVT ac_set_loop_cache(lp_ac_decoder pDecoder, int64_t max_size, double max_duration) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return;
+  }
+  
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  pVideoDecoder->loop_cache_size = max_size;
+  pVideoDecoder->loop_cache_duration = max_duration;
+}
+
+void CALL_CONVT ac_set_auto_discard(lp_ac_decoder pDecoder, bool enabled) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return;
+  }
+  
+  ((lp_ac_video_decoder)pDecoder)->auto_discard = enabled;
+}
+
+bool CALL_CONVT ac_decode_ahead_finished(lp_ac_decoder pDecoder) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return 0;
+  }
+  
+  lp_ac_decode_ahead pAhead = ((lp_ac_video_decoder)pDecoder)->ahead;
+  if (pAhead == NULL) {
+    return 0;
+  }
+  
+  return pAhead->eof && (!pAhead->loop || pAhead->stalled) && !pAhead->seek_pending &&
+    pAhead->tail == pAhead->head;
+}
+
+void CALL_CONVT ac_set_decode_priority(lp_ac_decoder pDecoder, ac_priority priority) {
+  if (pDecoder->type != AC_DECODER_TYPE_VIDEO) {
+    return;
+  }
+  
+  lp_ac_video_decoder pVideoDecoder = (lp_ac_video_decoder)pDecoder;
+  pVideoDecoder->priority = priority;
+  if (pVideoDecoder->ahead != NULL) {
+    ac_task_set_priority(&pVideoDecoder->ahead->task, priority);
+  }
+}
+
+//Free video decoder
+void ac_free_video_decoder(lp_ac_video_decoder pDecoder) {  
+  ac_stop_decode_ahead(&pDecoder->decoder);
+  av_free(pDecoder->keyframes);
+  av_free(pDecoder->pFrame);
+  av_free(pDecoder->pFrameRGB);    
+  if (pDecoder->pSwsCtx != NULL) {
+    sws_freeContext(pDecoder->pSwsCtx);
+  }
+  avcodec_close(pDecoder->pCodecCtx);
+  
+  //Free reserved memory for the buffer. Pooled frames which are still
+  //referenced are freed when they are released.
+  if (pDecoder->use_pool) {
+    if (pDecoder->current != NULL) {
+      ac_release_frame(&pDecoder->current->frame);
+    }
+    int i;
+    for (i = 0; i < pDecoder->pool_count; i++) {
+      ac_release_frame(&pDecoder->pool[i]->frame);
+    }
+    av_free(pDecoder->pool);
+  } else {
+    av_free(pDecoder->decoder.pBuffer);
+  }
+  
+  //Free reserved memory for decoder record
+  av_free(pDecoder);
+}
+
+//Free video decoder
+void ac_free_audio_decoder(lp_ac_audio_decoder pDecoder) {
+//  av_free(pDecoder->decoder.pBuffer);
+  avcodec_close(pDecoder->pCodecCtx);
   
   //Free reserved memory for the buffer
   av_free(pDecoder->decoder.pBuffer);
   
-  //Free the memory reserved for the temporary audio buffer
-  av_free(pDecoder->tmp_data);
+  swr_free(&pDecoder->pSwrCtx);
+  av_free(pDecoder->carry);
+  av_free(pDecoder->pFrame);
 
   //Free reserved memory for decoder record
   av_free(pDecoder);
 }
 
 void CALL_CONVT ac_free_decoder(lp_ac_decoder pDecoder) {
+  ac_set_stream_active((lp_ac_data)pDecoder->pacInstance, pDecoder->stream_index, 0);
+  
   if (pDecoder->type == AC_DECODER_TYPE_VIDEO) {
     ac_free_video_decoder((lp_ac_video_decoder)pDecoder);
   }
@@ -1000,3 +3789,503 @@ void CALL_CONVT ac_free_decoder(lp_ac_decoder pDecoder) {
     ac_free_audio_decoder((lp_ac_audio_decoder)pDecoder);  
   }  
 }
+
+//
+//--- Batch jobs ---
+//
+
+//Processes the items of a batch job, the items are handed out one by one to
+//the workers
+typedef void (*ac_batch_proc)(void *param, int index);
+
+struct _ac_batch {
+  int count;
+  volatile int next;
+  ac_batch_proc proc;
+  void *param;
+};
+
+typedef struct _ac_batch ac_batch;
+typedef ac_batch* lp_ac_batch;
+
+static void* ac_batch_worker(void *param)
+{
+  lp_ac_batch batch = (lp_ac_batch)param;
+  
+  int index;
+  while ((index = __sync_fetch_and_add(&batch->next, 1)) < batch->count) {
+    batch->proc(batch->param, index);
+  }
+  return NULL;
+}
+
+//Calls proc for each of the count items on up to thread_count threads, the
+//calling thread is one of them. Returns when all items are done.
+static void ac_run_batch(int count, int thread_count, ac_batch_proc proc, void *param)
+{
+  ac_init_ffmpeg();
+  
+  ac_batch batch;
+  batch.count = count;
+  batch.next = 0;
+  batch.proc = proc;
+  batch.param = param;
+  
+  //Opening files mostly waits for the disk, so all cores are used
+  if (thread_count <= 0) {
+    thread_count = ac_cpu_count();
+  }
+  if (thread_count > count) {
+    thread_count = count;
+  }
+  
+  pthread_t *threads = NULL;
+  int started = 0;
+  if (thread_count > 1) {
+    threads = (pthread_t*)av_malloc((thread_count - 1) * sizeof(pthread_t));
+    while (threads != NULL && started < thread_count - 1 &&
+           pthread_create(&threads[started], NULL, ac_batch_worker, &batch) == 0) {
+      started++;
+    }
+  }
+  
+  ac_batch_worker(&batch);
+  
+  int i;
+  for (i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  av_free(threads);
+}
+
+//
+//--- Batch scanning ---
+//
+
+struct _ac_scan_job {
+  const char **filenames;
+  int playable;
+  void *sender;
+  ac_scan_callback callback;
+  pthread_mutex_t mutex;
+};
+
+typedef struct _ac_scan_job ac_scan_job;
+typedef ac_scan_job* lp_ac_scan_job;
+
+static void ac_scan_codec_name(char *dest, int size, AVCodecContext *pCodecCtx, bool *has_decoder)
+{
+  AVCodec *pCodec = avcodec_find_decoder(pCodecCtx->codec_id);
+  *has_decoder = pCodec != NULL;
+  snprintf(dest, size, "%s", pCodec != NULL ? pCodec->name : avcodec_get_name(pCodecCtx->codec_id));
+}
+
+static void ac_scan_file(const char *filename, lp_ac_scan_result result)
+{
+  result->error = AC_SCAN_OPEN_FAILED;
+  result->duration = -1;
+  
+  lp_ac_instance pacInstance = ac_init();
+  if (ac_open_file(pacInstance, filename, 0) < 0 || !pacInstance->opened) {
+    ac_free(pacInstance);
+    return;
+  }
+  
+  AVFormatContext *ctx = ((lp_ac_data)pacInstance)->pFormatCtx;
+  snprintf(result->container, sizeof(result->container), "%s", ctx->iformat->name);
+  result->duration = pacInstance->info.duration;
+  
+  //The first stream of each type which can be decoded is reported, or the first
+  //one if there is none
+  unsigned int i;
+  for (i = 0; i < ctx->nb_streams; i++) {
+    AVCodecContext *pCodecCtx = ctx->streams[i]->codec;
+    if (pCodecCtx->codec_type == CODEC_TYPE_AUDIO && !result->audio_decoder) {
+      result->has_audio = true;
+      ac_scan_codec_name(result->audio_codec, sizeof(result->audio_codec), pCodecCtx, &result->audio_decoder);
+    } else if (pCodecCtx->codec_type == CODEC_TYPE_VIDEO && !result->video_decoder) {
+      result->has_video = true;
+      ac_scan_codec_name(result->video_codec, sizeof(result->video_codec), pCodecCtx, &result->video_decoder);
+    }
+  }
+  
+  //A file is not rejected for a stream which is not needed, like the cover of
+  //an audio file
+  if (!result->has_audio && !result->has_video) {
+    result->error = AC_SCAN_NO_STREAMS;
+  } else if (!result->audio_decoder && !result->video_decoder) {
+    result->error = AC_SCAN_NO_DECODER;
+  } else {
+    result->error = AC_SCAN_OK;
+  }
+  
+  ac_close(pacInstance);
+  ac_free(pacInstance);
+}
+
+static void ac_scan_proc(void *param, int index)
+{
+  lp_ac_scan_job job = (lp_ac_scan_job)param;
+  
+  ac_scan_result result;
+  memset(&result, 0, sizeof(result));
+  result.index = index;
+  ac_scan_file(job->filenames[index], &result);
+  
+  pthread_mutex_lock(&job->mutex);
+  if (result.error == AC_SCAN_OK) {
+    job->playable++;
+  }
+  if (job->callback != NULL) {
+    job->callback(job->sender, &result);
+  }
+  pthread_mutex_unlock(&job->mutex);
+}
+
+int CALL_CONVT ac_scan_files(const char **filenames, int count, int thread_count,
+  void *sender, ac_scan_callback callback)
+{
+  if (filenames == NULL || count <= 0) {
+    return 0;
+  }
+  
+  ac_scan_job job;
+  job.filenames = filenames;
+  job.playable = 0;
+  job.sender = sender;
+  job.callback = callback;
+  pthread_mutex_init(&job.mutex, NULL);
+  
+  ac_run_batch(count, thread_count, ac_scan_proc, &job);
+  
+  pthread_mutex_destroy(&job.mutex);
+  return job.playable;
+}
+
+//
+//--- Thumbnails ---
+//
+
+lp_ac_image CALL_CONVT ac_get_thumbnail(const char *filename, double time, int max_size,
+  ac_output_format format)
+{
+  lp_ac_image pImage = NULL;
+  
+  //The frame is scaled to the thumbnail size while it is converted, so no
+  //buffer of the full size is allocated. JPEG images are even decoded at a
+  //reduced resolution. One thumbnail uses one thread, batches run several of
+  //them at once.
+  lp_ac_instance pacInstance = ac_init();
+  pacInstance->output_format = format;
+  pacInstance->output_max_size = max_size;
+  pacInstance->allow_lowres = true;
+  pacInstance->thread_count = 1;
+  
+  if (ac_open_file(pacInstance, filename, 0) < 0 || !pacInstance->opened) {
+    ac_free(pacInstance);
+    return NULL;
+  }
+  
+  AVFormatContext *ctx = ((lp_ac_data)pacInstance)->pFormatCtx;
+  unsigned int i;
+  for (i = 0; i < ctx->nb_streams; i++) {
+    if (ctx->streams[i]->codec->codec_type == CODEC_TYPE_VIDEO) {
+      break;
+    }
+  }
+  
+  lp_ac_decoder pDecoder = NULL;
+  if (i < ctx->nb_streams) {
+    pDecoder = ac_create_decoder(pacInstance, i);
+  }
+  if (pDecoder != NULL) {
+    //Short videos show a frame from their middle
+    double duration = pacInstance->info.duration / 1000.0;
+    if (duration > 0 && time >= duration) {
+      time = duration / 2;
+    }
+    
+    //The frame is taken from the keyframe before the time, which is the first
+    //frame decoded after the seek. Images only have one frame.
+    if (time > 0 && duration > 0) {
+      ac_seek(pDecoder, -1, (int64_t)(time * 1000));
+    }
+    
+    if (ac_get_frame(pacInstance, pDecoder)) {
+      pImage = (lp_ac_image)av_malloc(sizeof(ac_image) + pDecoder->buffer_size);
+      if (pImage != NULL) {
+        pImage->width = pDecoder->output_width;
+        pImage->height = pDecoder->output_height;
+        pImage->buffer_size = pDecoder->buffer_size;
+        pImage->pBuffer = (char*)(pImage + 1);
+        memcpy(pImage->pBuffer, pDecoder->pBuffer, pDecoder->buffer_size);
+      }
+    }
+    ac_free_decoder(pDecoder);
+  }
+  
+  ac_close(pacInstance);
+  ac_free(pacInstance);
+  return pImage;
+}
+
+void CALL_CONVT ac_free_image(lp_ac_image pImage) {
+  av_free(pImage);
+}
+
+struct _ac_thumbnail_job {
+  const char **filenames;
+  double time;
+  int max_size;
+  ac_output_format format;
+  int count;
+  void *sender;
+  ac_thumbnail_callback callback;
+  pthread_mutex_t mutex;
+};
+
+typedef struct _ac_thumbnail_job ac_thumbnail_job;
+typedef ac_thumbnail_job* lp_ac_thumbnail_job;
+
+static void ac_thumbnail_proc(void *param, int index)
+{
+  lp_ac_thumbnail_job job = (lp_ac_thumbnail_job)param;
+  
+  lp_ac_image pImage = ac_get_thumbnail(job->filenames[index], job->time, job->max_size, job->format);
+  
+  pthread_mutex_lock(&job->mutex);
+  if (pImage != NULL) {
+    job->count++;
+  }
+  if (job->callback != NULL) {
+    job->callback(job->sender, index, pImage);
+  }
+  pthread_mutex_unlock(&job->mutex);
+  
+  ac_free_image(pImage);
+}
+
+int CALL_CONVT ac_get_thumbnails(const char **filenames, int count, double time, int max_size,
+  ac_output_format format, int thread_count, void *sender, ac_thumbnail_callback callback)
+{
+  if (filenames == NULL || count <= 0) {
+    return 0;
+  }
+  
+  ac_thumbnail_job job;
+  job.filenames = filenames;
+  job.time = time;
+  job.max_size = max_size;
+  job.format = format;
+  job.count = 0;
+  job.sender = sender;
+  job.callback = callback;
+  pthread_mutex_init(&job.mutex, NULL);
+  
+  ac_run_batch(count, thread_count, ac_thumbnail_proc, &job);
+  
+  pthread_mutex_destroy(&job.mutex);
+  return job.count;
+}
+
+//
+//--- Asynchronous opening ---
+//
+
+struct _ac_open_job {
+  lp_ac_instance pacInstance;
+  char *filename;
+  bool mapped;
+  pthread_t thread;
+  volatile int done;
+  int result;
+};
+
+static void* ac_open_job_proc(void *param)
+{
+  lp_ac_open_job job = (lp_ac_open_job)param;
+  
+  if (job->mapped) {
+    job->result = ac_open_mapped(job->pacInstance, job->filename);
+  } else {
+    job->result = ac_open_file(job->pacInstance, job->filename, 0);
+  }
+  
+  //The result has to be complete before the job is seen as done
+  __sync_synchronize();
+  job->done = 1;
+  return NULL;
+}
+
+lp_ac_open_job CALL_CONVT ac_open_async(lp_ac_instance pacInstance, const char *filename, bool mapped) {
+  lp_ac_open_job job = (lp_ac_open_job)av_mallocz(sizeof(ac_open_job));
+  if (job == NULL) {
+    return NULL;
+  }
+  
+  job->pacInstance = pacInstance;
+  job->filename = av_strdup(filename);
+  job->mapped = mapped;
+  job->result = -1;
+  ((lp_ac_data)pacInstance)->aborted = 0;
+  
+  if (job->filename == NULL ||
+      pthread_create(&job->thread, NULL, ac_open_job_proc, job) != 0) {
+    av_free(job->filename);
+    av_free(job);
+    return NULL;
+  }
+  
+  return job;
+}
+
+bool CALL_CONVT ac_open_async_ready(lp_ac_open_job job) {
+  return job->done;
+}
+
+int CALL_CONVT ac_open_async_wait(lp_ac_open_job job) {
+  pthread_join(job->thread, NULL);
+  int result = job->result;
+  
+  av_free(job->filename);
+  av_free(job);
+  return result;
+}
+
+void CALL_CONVT ac_open_async_cancel(lp_ac_open_job job) {
+  lp_ac_instance pacInstance = job->pacInstance;
+  
+  ((lp_ac_data)pacInstance)->aborted = 1;
+  pthread_join(job->thread, NULL);
+  ((lp_ac_data)pacInstance)->aborted = 0;
+  
+  ac_close(pacInstance);
+  av_free(job->filename);
+  av_free(job);
+}
+
+//
+//--- Pitch analysis ---
+//
+
+//Returns the sum of the absolute differences of the first count samples and
+//the samples lag samples after them
+typedef int64_t (*ac_pitch_dist_proc)(const int16_t *samples, int count, int lag);
+
+static int64_t ac_pitch_dist_scalar(const int16_t *samples, int count, int lag)
+{
+  int64_t sum = 0;
+  int i;
+  for (i = 0; i < count; i++) {
+    int dist = samples[i] - samples[i + lag];
+    sum += dist < 0 ? -dist : dist;
+  }
+  return sum;
+}
+
+#ifdef AC_PITCH_X86
+//The difference of two 16 bit samples is at most 65535, so max - min is exact
+//as an unsigned 16 bit value. The 32 bit lanes are added up to 64 bits before
+//they may overflow.
+#define AC_PITCH_BLOCK 8192
+
+__attribute__((target("sse2")))
+static int64_t ac_pitch_dist_sse2(const int16_t *samples, int count, int lag)
+{
+  const __m128i zero = _mm_setzero_si128();
+  int64_t sum = 0;
+  int i = 0;
+  while (count - i >= 8) {
+    int n = FFMIN((count - i) / 8, AC_PITCH_BLOCK);
+    __m128i acc = _mm_setzero_si128();
+    int k;
+    for (k = 0; k < n; k++, i += 8) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(samples + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(samples + i + lag));
+      __m128i dist = _mm_sub_epi16(_mm_max_epi16(a, b), _mm_min_epi16(a, b));
+      acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(dist, zero));
+      acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(dist, zero));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    sum += (int64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+  return sum + ac_pitch_dist_scalar(samples + i, count - i, lag);
+}
+
+__attribute__((target("avx2")))
+static int64_t ac_pitch_dist_avx2(const int16_t *samples, int count, int lag)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  int64_t sum = 0;
+  int i = 0;
+  while (count - i >= 16) {
+    int n = FFMIN((count - i) / 16, AC_PITCH_BLOCK);
+    __m256i acc = _mm256_setzero_si256();
+    int k;
+    for (k = 0; k < n; k++, i += 16) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(samples + i));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(samples + i + lag));
+      __m256i dist = _mm256_sub_epi16(_mm256_max_epi16(a, b), _mm256_min_epi16(a, b));
+      acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(dist, zero));
+      acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(dist, zero));
+    }
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    int j;
+    for (j = 0; j < 8; j++) {
+      sum += lanes[j];
+    }
+  }
+  return sum + ac_pitch_dist_scalar(samples + i, count - i, lag);
+}
+#endif
+
+static ac_pitch_dist_proc pitch_dist = NULL;
+
+bool CALL_CONVT ac_set_pitch_kernel(ac_pitch_kernel kernel)
+{
+#ifdef AC_PITCH_X86
+  __builtin_cpu_init();
+  if (kernel == AC_PITCH_AUTO) {
+    kernel = __builtin_cpu_supports("avx2") ? AC_PITCH_AVX2 :
+      (__builtin_cpu_supports("sse2") ? AC_PITCH_SSE2 : AC_PITCH_SCALAR);
+  }
+  if (kernel == AC_PITCH_AVX2 && __builtin_cpu_supports("avx2")) {
+    pitch_dist = ac_pitch_dist_avx2;
+    return true;
+  }
+  if (kernel == AC_PITCH_SSE2 && __builtin_cpu_supports("sse2")) {
+    pitch_dist = ac_pitch_dist_sse2;
+    return true;
+  }
+#else
+  if (kernel == AC_PITCH_AUTO) {
+    kernel = AC_PITCH_SCALAR;
+  }
+#endif
+  if (kernel == AC_PITCH_SCALAR) {
+    pitch_dist = ac_pitch_dist_scalar;
+    return true;
+  }
+  return false;
+}
+
+void CALL_CONVT ac_analyze_pitch(const int16_t *samples, int sample_count, int channel_count,
+  const int *lags, int lag_count, double *weights)
+{
+  if (pitch_dist == NULL) {
+    ac_set_pitch_kernel(AC_PITCH_AUTO);
+  }
+  
+  //The distances are exact integers, so every kernel yields the same weights
+  int c, l;
+  for (c = 0; c < channel_count; c++) {
+    const int16_t *channel = samples + (int64_t)c * sample_count;
+    for (l = 0; l < lag_count; l++) {
+      int lag = lags[l];
+      int64_t dist = lag > 0 && lag < sample_count ? pitch_dist(channel, sample_count - lag, lag) : 0;
+      weights[c * lag_count + l] = 1 - (double)dist / 32767 / sample_count;
+    }
+  }
+}
@@ -60,11 +60,87 @@ enum _ac_output_format {
   AC_OUTPUT_RGB24 = 0,
   AC_OUTPUT_BGR24 = 1,
   AC_OUTPUT_RGBA32 = 2,
-  AC_OUTPUT_BGRA32 = 3
+  AC_OUTPUT_BGRA32 = 3,
+  /*Planar YUV 4:2:0, the Y plane is followed by the U and V planes with half
+   the width and height.*/
+  AC_OUTPUT_YUV420P = 4,
+  /*YUV 4:2:0 with a Y plane followed by one plane of interleaved U and V
+   samples.*/
+  AC_OUTPUT_NV12 = 5
 };
 
+/*Maximum number of planes a frame in one of the output formats has.*/
+#define AC_MAX_PLANES 3
+
 typedef enum _ac_output_format ac_output_format;
 
+/*Defines how video decoders use multiple threads*/
+enum _ac_thread_type {
+  /*Use frame and slice threading, depending on what the codec supports.*/
+  AC_THREAD_AUTO = 0,
+  /*Decode multiple frames at once. Each thread delays the output by one frame.*/
+  AC_THREAD_FRAME = 1,
+  /*Decode multiple slices of one frame at once.*/
+  AC_THREAD_SLICE = 2
+};
+
+typedef enum _ac_thread_type ac_thread_type;
+
+/*Defines the format audio data is outputted in. The samples of all channels
+ are interleaved.*/
+enum _ac_audio_format {
+  /*Signed 16 bit integer samples*/
+  AC_AUDIO_S16 = 0,
+  /*32 bit floating point samples in the range of -1 to 1*/
+  AC_AUDIO_F32 = 1
+};
+
+typedef enum _ac_audio_format ac_audio_format;
+
+/*Defines which frames a video decoder skips parts of the decoding for, see
+ ac_set_discard. Each level includes the frames of the levels before it.*/
+enum _ac_discard {
+  /*Decode all frames completely.*/
+  AC_DISCARD_NONE = 0,
+  /*Frames no other frame refers to. Skipping them does not affect other frames.*/
+  AC_DISCARD_NONREF = 1,
+  /*Bidirectionally predicted frames.*/
+  AC_DISCARD_BIDIR = 2,
+  /*All frames but keyframes. Skipping reference frames disturbs the following
+   frames up to the next keyframe.*/
+  AC_DISCARD_NONKEY = 3,
+  /*All frames.*/
+  AC_DISCARD_ALL = 4
+};
+
+typedef enum _ac_discard ac_discard;
+
+/*Priority classes of the decode scheduler which runs the decode ahead of all
+ video decoders, see ac_set_decode_priority. A class is only served while no
+ decoder of a higher class has work.*/
+enum _ac_priority {
+  /*The video of the song being sung.*/
+  AC_PRIORITY_SONG = 0,
+  /*Videos shown with the background music.*/
+  AC_PRIORITY_BACKGROUND = 1,
+  /*Song previews and theme videos, the default.*/
+  AC_PRIORITY_PREVIEW = 2
+};
+
+typedef enum _ac_priority ac_priority;
+
+/*Implementations of ac_analyze_pitch, see ac_set_pitch_kernel. All of them
+ return identical results.*/
+enum _ac_pitch_kernel {
+  /*The fastest implementation the processor supports, the default.*/
+  AC_PITCH_AUTO = 0,
+  AC_PITCH_SCALAR = 1,
+  AC_PITCH_SSE2 = 2,
+  AC_PITCH_AVX2 = 3
+};
+
+typedef enum _ac_pitch_kernel ac_pitch_kernel;
+
 /*Contains information about the whole file/stream that has been opened. Default values are "" 
 for strings and -1 for integer values.*/
 struct _ac_file_info { 
@@ -88,6 +164,45 @@ struct _ac_instance {
   ac_output_format output_format;
   /*Contains information about the opened stream/file*/
   ac_file_info info;  
+  /*Set this value to change the number of threads video decoders use. Zero
+   chooses the count by the number of processor cores, one decodes in the
+   calling thread only. Takes effect when the decoder is created.*/
+  int thread_count;
+  /*Set this value to change how video decoders use their threads*/
+  ac_thread_type thread_type;
+  /*Set these values to scale the video frames to the given size while they are
+   converted. If only one of them is set, the other one is chosen by the aspect
+   ratio. Zero keeps the size of the video.*/
+  int output_width;
+  int output_height;
+  /*Set this value to limit the larger side of the video frames to the given
+   size, the aspect ratio is kept. Zero disables the limit.*/
+  int output_max_size;
+  /*If true, codecs which support it decode the frames at a reduced resolution
+   when the output size is small enough.*/
+  bool allow_lowres;
+  /*Set this value to let video decoders convert their frames into a pool of
+   reference counted frames, see ac_get_video_frame. The value is the number of
+   frames allocated in advance, the pool grows if all of them are in use. Zero
+   disables the pool. Takes effect when the decoder is created.*/
+  int frame_pool_size;
+  /*If true, the packages read for one decoder which belong to the stream of
+   another decoder of this instance are queued for that decoder instead of
+   being dropped. This allows e.g. an audio and a video decoder to share one
+   opened file, the decoders may run in different threads then. A seek moves
+   all streams of the instance, the other decoders continue after the last
+   package they got. A decoder which does not read while the others do loses
+   its queued packages and continues at a later keyframe. Must not be combined
+   with ac_read_package.*/
+  bool shared_demux;
+  /*Set these values to change the sample format, sample rate and channel count
+   audio decoders output. The samples are converted and resampled while they
+   are decoded. Zero keeps the sample rate or channel count of the stream. Takes
+   effect when the decoder is created, the stream info of the decoder describes
+   the output.*/
+  ac_audio_format audio_output_format;
+  int audio_sample_rate;
+  int audio_channel_count;
 };
 
 typedef struct _ac_instance ac_instance;
@@ -110,7 +225,7 @@ typedef struct _ac_video_stream_info ac_video_stream_info;
 struct _ac_audio_stream_info {
   /*Samples per second. Default values are 44100 or 48000.*/
   int samples_per_second;
-  /*Bits per sample. Can be 8 or 16 Bit.*/
+  /*Bits per sample. Can be 8, 16 or 32 Bit.*/
   int bit_depth;
   /*Count of channels in the audio stream.*/
   int channel_count;
@@ -151,12 +266,53 @@ struct _ac_decoder {
   char *pBuffer;  
   /*Size of the data in the buffer.*/  
   int buffer_size;  
+  
+  /*The size of the frames in the buffer of a video decoder. May differ from
+   the size of the video if the output is scaled.*/
+  int output_width;
+  int output_height;
+  
+  /*Pointers on the planes of the frame. The packed RGB formats only use the
+   first plane, YUV420P uses three and NV12 two planes. If the video is
+   decoded in the requested YUV format and not scaled, the planes point
+   directly into the decoded frame instead of the buffer. In both cases they
+   are valid until the next frame is decoded.*/
+  char *planes[AC_MAX_PLANES];
+  /*Size of one line of each plane in bytes.*/
+  int strides[AC_MAX_PLANES];
+  /*Size of each plane in bytes.*/
+  int plane_sizes[AC_MAX_PLANES];
 };
 
 typedef struct _ac_decoder ac_decoder;
 /*Pointer on TAc_decoder.*/
 typedef ac_decoder* lp_ac_decoder;
 
+/*Contains a frame from the frame pool of a video decoder. The data of the frame
+ stays valid until the frame is released, no matter how many frames the decoder
+ decodes in the meantime.*/
+struct _ac_frame {
+  /*The timecode of the frame in seconds*/
+  double timecode;
+  /*The size of the frame in pixels*/
+  int width;
+  int height;
+  /*Pointer to the buffer which contains the frame.*/
+  char *pBuffer;
+  /*Size of the data in the buffer.*/
+  int buffer_size;
+  /*Pointers on the planes of the frame, see TAc_decoder.*/
+  char *planes[AC_MAX_PLANES];
+  /*Size of one line of each plane in bytes.*/
+  int strides[AC_MAX_PLANES];
+  /*Size of each plane in bytes.*/
+  int plane_sizes[AC_MAX_PLANES];
+};
+
+typedef struct _ac_frame ac_frame;
+/*Pointer on TAc_frame.*/
+typedef ac_frame* lp_ac_frame;
+
 /*Contains information about an Acinerella package.*/
 struct _ac_package {
   /*The stream the package belongs to.*/
@@ -169,6 +325,106 @@ typedef ac_package* lp_ac_package;
 
 typedef void* lp_ac_proberesult;
 
+/*Performance counters of a decoder, see ac_get_stats. The counters start at zero
+ when the decoder is created and only grow. Times are in microseconds.*/
+struct _ac_stats {
+  /*Packages and bytes read from the file by all decoders of the instance and
+   the time spent in the demuxer.*/
+  int64_t packets_read;
+  int64_t bytes_read;
+  int64_t read_time;
+  /*Packages of other streams this decoder read and threw away while it looked
+   for its own ones.*/
+  int64_t packets_discarded;
+  /*Time spent in the codec and in the conversion into the output format
+   (swscale or swresample).*/
+  int64_t decode_time;
+  int64_t convert_time;
+  /*Frames the codec returned. Video frames which were decoded without being
+   converted by ac_skip_frames or the load shedding are counted as dropped, the
+   ones ac_seek_accurate decoded to reach its target as sought.*/
+  int64_t frames_decoded;
+  int64_t frames_dropped;
+  int64_t frames_sought;
+  /*Frames of the decode ahead ring which were replaced by a later one before
+   they were fetched by ac_get_frame_at.*/
+  int64_t frames_late;
+  /*Number of seeks, the total and the longest time they took. Accurate seeks
+   include decoding up to the target frame.*/
+  int64_t seek_count;
+  int64_t seek_time;
+  int64_t seek_time_max;
+  /*Largest package read by the instance, largest output buffer of the decoder
+   in bytes and most packages queued for one stream in the shared demux mode.*/
+  int64_t max_package_size;
+  int64_t max_buffer_size;
+  int64_t max_queued_packages;
+  /*Current level of the automatic discard mode, zero if all frames are decoded
+   completely. See ac_set_auto_discard.*/
+  int64_t discard_level;
+};
+
+typedef struct _ac_stats ac_stats;
+/*Pointer on TAc_stats.*/
+typedef ac_stats* lp_ac_stats;
+
+/*Result of scanning a media file, see ac_scan_files.*/
+enum _ac_scan_error {
+  /*The file contains an audio or video stream which can be decoded. Check
+   audio_decoder and video_decoder for the stream type which is needed.*/
+  AC_SCAN_OK = 0,
+  /*The file does not exist, can not be read or has an unknown format.*/
+  AC_SCAN_OPEN_FAILED = 1,
+  /*The file contains neither an audio nor a video stream.*/
+  AC_SCAN_NO_STREAMS = 2,
+  /*There is no decoder for the codecs of any audio or video stream.*/
+  AC_SCAN_NO_DECODER = 3
+};
+
+typedef enum _ac_scan_error ac_scan_error;
+
+/*Contains what ac_scan_files found out about one media file.*/
+struct _ac_scan_result {
+  /*Index of the file in the list passed to ac_scan_files.*/
+  int index;
+  /*Whether the file can be played.*/
+  ac_scan_error error;
+  /*Short names of the container format and of the codecs of the audio and
+   video stream, the first one which can be decoded is preferred. Empty if not
+   available.*/
+  char container[32];
+  char audio_codec[32];
+  char video_codec[32];
+  /*Length of the file in milliseconds, -1 if unknown.*/
+  int64_t duration;
+  /*If true, the file has an audio or video stream.*/
+  bool has_audio;
+  bool has_video;
+  /*If true, there is a decoder for the codec of the audio or video stream. An
+   attached picture like the cover of a MP3 file is a video stream as well.*/
+  bool audio_decoder;
+  bool video_decoder;
+};
+
+typedef struct _ac_scan_result ac_scan_result;
+/*Pointer on TAc_scan_result.*/
+typedef ac_scan_result* lp_ac_scan_result;
+
+/*An image returned by ac_get_thumbnail. The lines of the image follow each
+ other without any padding.*/
+struct _ac_image {
+  /*Size of the image in pixels.*/
+  int width;
+  int height;
+  /*Pointer on the image data and its size in bytes.*/
+  char *pBuffer;
+  int buffer_size;
+};
+
+typedef struct _ac_image ac_image;
+/*Pointer on TAc_image.*/
+typedef ac_image* lp_ac_image;
+
 /*Callback function used to ask the application to read data. Should return
    the number of bytes read or an value smaller than zero if an error occured.*/
 typedef int CALL_CONVT (*ac_read_callback)(void *sender, char *buf, int size);
@@ -182,6 +438,13 @@ typedef int CALL_CONVT (*ac_openclose_callback)(void *sender);
 typedef void* CALL_CONVT (*ac_malloc_callback)(size_t size);
 typedef void* CALL_CONVT (*ac_realloc_callback)(void *ptr, size_t size);
 typedef void CALL_CONVT (*ac_free_callback)(void *ptr);
+/*Callback function which receives the result of each file scanned by
+   ac_scan_files. The result is only valid during the call.*/
+typedef void CALL_CONVT (*ac_scan_callback)(void *sender, lp_ac_scan_result result);
+/*Callback function which receives the thumbnail of each file passed to
+   ac_get_thumbnails, NULL if there is none. The image is only valid during the
+   call.*/
+typedef void CALL_CONVT (*ac_thumbnail_callback)(void *sender, int index, lp_ac_image image);
 
 /*Initializes an Acinerella instance.*/
 extern lp_ac_instance CALL_CONVT ac_init(void);
@@ -205,6 +468,60 @@ extern int CALL_CONVT ac_open(
   ac_seek_callback seek_proc,
   ac_openclose_callback close_proc,
   lp_ac_proberesult proberesult);
+/*Opens a media file directly from disk. The file is read natively, so no data
+ has to pass the read/seek callbacks.
+ @param(inst specifies the Acinerella Instance the file should be opened for)
+ @param(filename specifies the UTF-8 encoded path of the media file)
+ @param(buffer_size specifies the size of the IO buffer in bytes. Pass zero to
+  use the default size.)*/
+extern int CALL_CONVT ac_open_file(
+  lp_ac_instance pacInstance,
+  const char *filename,
+  int buffer_size);
+/*Opens a media file by mapping it into memory. ffmpeg reads the data straight
+ from the mapping and seeking does not need any system call. This is meant for
+ files on local drives. If the file can not be mapped, it is read like in
+ ac_open_file.
+ @param(inst specifies the Acinerella Instance the file should be opened for)
+ @param(filename specifies the UTF-8 encoded path of the media file)*/
+extern int CALL_CONVT ac_open_mapped(
+  lp_ac_instance pacInstance,
+  const char *filename);
+
+/*Handle of a file which is opened in the background, see ac_open_async.*/
+typedef struct _ac_open_job ac_open_job;
+typedef ac_open_job* lp_ac_open_job;
+
+/*Opens a media file on a thread of its own, which probes the file and
+ discovers its streams like ac_open_file or ac_open_mapped. The instance must
+ not be used until the job has been finished by ac_open_async_wait or
+ ac_open_async_cancel, which have to be called exactly once. The output
+ options of the instance may still be changed before the decoders are created.
+ @param(mapped specifies whether the file is opened like in ac_open_mapped)
+ Returns NULL if the thread could not be started.*/
+extern lp_ac_open_job CALL_CONVT ac_open_async(
+  lp_ac_instance pacInstance,
+  const char *filename,
+  bool mapped);
+/*Returns true if the file has been opened or the opening has failed, so
+ ac_open_async_wait does not block.*/
+extern bool CALL_CONVT ac_open_async_ready(lp_ac_open_job job);
+/*Waits until the file has been opened and frees the job. Returns what
+ ac_open_file would have returned.*/
+extern int CALL_CONVT ac_open_async_wait(lp_ac_open_job job);
+/*Stops the opening as soon as possible, closes the file if it has been opened
+ and frees the job. The instance may be used for another file afterwards.*/
+extern void CALL_CONVT ac_open_async_cancel(lp_ac_open_job job);
+/*Enables the stream info cache for files opened by ac_open_file and
+ ac_open_mapped. The first open of a file stores the detected format and what
+ was found out about its streams in the given directory, keyed by the path, size
+ and modification time of the file. Later opens of the unchanged file skip
+ probing and the stream info discovery, which decodes the first frames. The
+ codec parameters and extradata found by the discovery are restored as well.
+ Formats whose streams are only found while reading, like MPEG transport
+ streams, are not cached. Pass NULL to disable the cache. Has to be called before any file is opened.
+ @param(directory specifies the UTF-8 encoded path of an existing directory)*/
+extern void CALL_CONVT ac_set_info_cache(const char *directory);
 /*Closes an opened media file.*/
 extern void CALL_CONVT ac_close(lp_ac_instance pacInstance);
   
@@ -213,8 +530,20 @@ extern void CALL_CONVT ac_get_stream_info(lp_ac_instance pacInstance, int nb, lp
 
 /*Reads a package from an opened media file.*/
 extern lp_ac_package CALL_CONVT ac_read_package(lp_ac_instance pacInstance);
-/*Frees a package that has been read.*/
+/*Frees a package that has been read. The package record is kept by the
+ instance and reused by the next ac_read_package call, so packages have to be
+ freed before the instance is.*/
 extern void CALL_CONVT ac_free_package(lp_ac_package pPackage);
+/*Returns an empty package which can be filled by ac_read_package_to. Free it
+ with ac_free_package.*/
+extern lp_ac_package CALL_CONVT ac_alloc_package(lp_ac_instance pacInstance);
+/*Reads the next package of an opened media file into the given package,
+ replacing the data read before. Reading all packages into the same package
+ does not allocate any package records. Returns 0 at the end of the file.*/
+extern int CALL_CONVT ac_read_package_to(lp_ac_instance pacInstance, lp_ac_package pPackage);
+/*Sets the functions the package records are allocated and freed with. Has to
+ be called before any package is read. Pass NULL to use the ffmpeg allocator.*/
+extern void CALL_CONVT ac_set_package_allocator(ac_malloc_callback malloc_proc, ac_free_callback free_proc);
 
 /*Creates an decoder for the specified stream number. Returns NIL if no decoder
  could be found.*/
@@ -227,8 +556,85 @@ extern int CALL_CONVT ac_decode_package(lp_ac_package pPackage, lp_ac_decoder pD
 extern int CALL_CONVT ac_drop_decode_package(lp_ac_package pPackage, lp_ac_decoder pDecoder);
 
 extern int CALL_CONVT ac_get_audio_frame(lp_ac_instance pacInstance, lp_ac_decoder pDecoder);
+/*Decodes exactly "frame_count" sample frames of an audio decoder into the given
+ buffer, which has to hold frame_count * channel_count samples. Decoded samples
+ which do not fit are kept by the decoder for the next call. The timecode of the
+ decoder is set to the time of the first sample frame in the buffer. Returns
+ the number of sample frames written, which is only less than frame_count at
+ the end of the file. Do not mix with ac_get_audio_frame.*/
+extern int CALL_CONVT ac_read_audio_frames(lp_ac_instance pacInstance, lp_ac_decoder pDecoder, char *buffer, int frame_count);
 extern int CALL_CONVT ac_get_frame(lp_ac_instance pacInstance, lp_ac_decoder pDecoder);
 extern int CALL_CONVT ac_skip_frames(lp_ac_instance pacInstance, lp_ac_decoder pDecoder, int num);
+
+/*Returns the frame the video decoder has decoded last and adds a reference to
+ it. The frame has to be given back with ac_release_frame. Has to be called from
+ the thread which decodes. Returns NULL if the decoder does not use a frame pool
+ or no frame has been decoded yet.*/
+extern lp_ac_frame CALL_CONVT ac_get_video_frame(lp_ac_decoder pDecoder);
+/*Releases a frame returned by ac_get_video_frame, so the decoder can reuse it.
+ May be called from any thread, even after the decoder has been freed.*/
+extern void CALL_CONVT ac_release_frame(lp_ac_frame pFrame);
+
+/*Lets the decode scheduler decode the video ahead of the playback. The
+ scheduler is a pool of worker threads shared by all decoders, which decodes
+ one frame of a decoder at a time. The decoded frames are kept in a ring of
+ the given size and are fetched with ac_get_frame_at. The decoder has to use a
+ frame pool which is larger than the ring. As long as the decode ahead runs,
+ the decoder must not be used by any other function than the decode ahead
+ functions below, neither may its instance unless it is in the shared demux
+ mode.
+ @param(loop specifies whether the video starts over at its end. The
+  timecodes of the ring keep counting up then.)
+ Returns 1 if the thread has been started.*/
+extern int CALL_CONVT ac_start_decode_ahead(lp_ac_decoder pDecoder, int frame_count, bool loop);
+/*Stops the decode ahead and waits for the frame being decoded. Called by
+ ac_free_decoder as well.*/
+extern void CALL_CONVT ac_stop_decode_ahead(lp_ac_decoder pDecoder);
+/*Lets the decode ahead continue at the given time in seconds. Frames
+ decoded before are dropped.*/
+extern void CALL_CONVT ac_decode_ahead_seek(lp_ac_decoder pDecoder, double time);
+/*Changes whether the decode ahead starts over at the end of the video.*/
+extern void CALL_CONVT ac_decode_ahead_loop(lp_ac_decoder pDecoder, bool loop);
+/*Returns the latest decoded frame whose timecode is not after the given
+ presentation time in seconds, with a reference which has to be released with
+ ac_release_frame. Earlier frames are dropped. Returns NULL if no new frame is
+ due. Has to be called from one thread only.*/
+extern lp_ac_frame CALL_CONVT ac_get_frame_at(lp_ac_decoder pDecoder, double time);
+/*Returns true if the decode ahead has reached the end of the video and
+ all frames have been fetched.*/
+extern bool CALL_CONVT ac_decode_ahead_finished(lp_ac_decoder pDecoder);
+/*Sets the priority class the decode scheduler decodes the video ahead with. May
+ be called at any time from any thread.*/
+extern void CALL_CONVT ac_set_decode_priority(lp_ac_decoder pDecoder, ac_priority priority);
+
+/*Copies the performance counters of the decoder into "stats". The counters are
+ updated by the decoding threads without any locking, so this may be polled
+ every frame from any thread. A copy taken while a frame is decoded may mix
+ counters from before and after that frame.*/
+extern void CALL_CONVT ac_get_stats(lp_ac_decoder pDecoder, lp_ac_stats stats);
+
+/*Lets the decode ahead of a video decoder keep all frames of a looping
+ video in memory. The first pass from the start of the video is kept and the
+ following passes and seeks are played from memory without reading, decoding
+ or seeking the file. Only videos whose converted frames fit into the given
+ size in bytes and which are not longer than the given duration in seconds are
+ kept. Pass zero to disable the cache. Has to be called before
+ ac_start_decode_ahead.*/
+extern void CALL_CONVT ac_set_loop_cache(lp_ac_decoder pDecoder, int64_t max_size, double max_duration);
+/*Lets a video decoder save time at the cost of quality.
+ @param(skip_frame specifies the frames which are not decoded at all)
+ @param(skip_loop_filter specifies the frames which are not deblocked)
+ @param(skip_idct specifies the frames whose inverse transform is skipped)
+ The levels take effect with the next package and may be changed from any
+ thread. ac_skip_frames always skips the frames no other frame refers to.*/
+extern void CALL_CONVT ac_set_discard(lp_ac_decoder pDecoder, ac_discard skip_frame,
+  ac_discard skip_loop_filter, ac_discard skip_idct);
+/*Lets the decode ahead of a video decoder raise the discard levels step
+ by step while it falls behind the presentation time and lower them again once
+ it keeps up. The levels set by ac_set_discard are the minimum. Whenever the
+ thread has to skip frames to catch up, frames no other frame refers to are
+ skipped until the next keyframe or until it has caught up.*/
+extern void CALL_CONVT ac_set_auto_discard(lp_ac_decoder pDecoder, bool enabled);
  
 /*Seeks to the given target position in the file. The seek funtion is not able to seek a single audio/video stream
 but seeks the whole file forward. The stream number paremter (nb) is only used for the timecode reference.
@@ -236,6 +642,74 @@ The parameter "dir" specifies the seek direction: 0 for forward, -1 for backward
 The target_pos paremeter is in milliseconds. Returns 1 if the functions succeded.*/
 extern int CALL_CONVT ac_seek(lp_ac_decoder pDecoder, int dir, int64_t target_pos);
 
+/*Builds the keyframe index of a video decoder from the index of the container.
+ If the container has none and "scan" is true, the whole file is read once to
+ find the keyframes, the file is at its start afterwards. Returns the number of
+ keyframes found. ac_seek_accurate builds the index without scanning on its
+ first call.*/
+extern int CALL_CONVT ac_build_keyframe_index(lp_ac_decoder pDecoder, bool scan);
+/*Seeks a video decoder exactly to the given time in seconds. The file is
+ sought to the keyframe before the time and the frames up to the time are
+ decoded without converting them. The first frame at the time is converted as
+ if it had been returned by ac_get_frame. Audio decoders are sought like in
+ ac_seek. Returns 1 if the frame has been found.*/
+extern int CALL_CONVT ac_seek_accurate(lp_ac_decoder pDecoder, double time);
+
 extern lp_ac_proberesult CALL_CONVT ac_probe_input_buffer(void* buf, int bufsize, char* filename, int* score_max);
 
+/*Scans a list of media files on multiple threads without creating decoders.
+ The result of each file is passed to the callback as soon as the file has been
+ scanned, in no particular order. The callback is never called by two threads
+ at once. Returns when all files have been scanned, the return value is the
+ number of files which can be played. The stream info cache is used, see
+ ac_set_info_cache.
+ @param(filenames specifies the UTF-8 encoded paths of the files)
+ @param(thread_count specifies the number of threads to use. Zero chooses the
+  count by the number of processor cores.)*/
+extern int CALL_CONVT ac_scan_files(const char **filenames, int count, int thread_count,
+  void *sender, ac_scan_callback callback);
+
+/*Returns a single frame of a video file as a thumbnail, NULL if the file has
+ no video which can be decoded. The frame is taken from the keyframe at or
+ before the given time, short videos show a frame from their middle. Image
+ files like JPEG and PNG are read by the image demuxers of ffmpeg, so they are
+ decoded and scaled the same way. The frame is scaled while it is converted, no
+ image of the full size is created. Free the image with ac_free_image.
+ @param(filename specifies the UTF-8 encoded path of the video file)
+ @param(time specifies the time of the frame in seconds)
+ @param(max_size specifies the size the larger side of the thumbnail is
+  limited to, the aspect ratio is kept)
+ @param(format specifies the format of the image, which has to be a packed
+  format)*/
+extern lp_ac_image CALL_CONVT ac_get_thumbnail(const char *filename, double time, int max_size,
+  ac_output_format format);
+/*Frees an image returned by ac_get_thumbnail.*/
+extern void CALL_CONVT ac_free_image(lp_ac_image pImage);
+/*Creates the thumbnails of a list of video files on multiple threads, see
+ ac_get_thumbnail. Each thumbnail is passed to the callback as soon as it has
+ been created, the callback is never called by two threads at once. Returns
+ when all files are done, the return value is the number of thumbnails
+ created.
+ @param(thread_count specifies the number of threads to use. Zero chooses the
+  count by the number of processor cores.)*/
+extern int CALL_CONVT ac_get_thumbnails(const char **filenames, int count, double time, int max_size,
+  ac_output_format format, int thread_count, void *sender, ac_thumbnail_callback callback);
+
+/*Rates for each channel of recorded samples how well they repeat after each of
+ the given lags, which are the periods of the tones looked for. Each weight is
+ 1 minus the sum of the absolute differences of the samples one lag apart,
+ divided by 32767 and by sample_count, so 1 means the samples repeat exactly.
+ All channels are analyzed in one call.
+ @param(samples specifies the 16 bit samples of all channels, the samples of
+  one channel follow each other)
+ @param(sample_count specifies the number of samples of each channel)
+ @param(lags specifies the lags in samples, each less than sample_count)
+ @param(weights receives channel_count * lag_count weights, the ones of the
+  first channel first)*/
+extern void CALL_CONVT ac_analyze_pitch(const int16_t *samples, int sample_count, int channel_count,
+  const int *lags, int lag_count, double *weights);
+/*Selects the implementation of ac_analyze_pitch, e.g. to compare them. Returns
+ false and keeps the current one if the processor does not support it.*/
+extern bool CALL_CONVT ac_set_pitch_kernel(ac_pitch_kernel kernel);
+
 #endif /*VIDEOPLAY_H*/
@@ -31,6 +31,18 @@ namespace Vocaluxe.Lib.Video
             return 0;
         }
 
+        public virtual void Prefetch(string VideoFileName, float Start, float Gap)
+        {
+        }
+
+        public virtual void ClearPrefetches()
+        {
+        }
+
+        public virtual void KeepPrefetches()
+        {
+        }
+
         public virtual bool Close(int StreamID)
         {
             return true;
@@ -63,11 +75,23 @@ namespace Vocaluxe.Lib.Video
         {
         }
 
+        public virtual void SetPriority(int StreamID, EVideoPriority Priority)
+        {
+        }
+
         public virtual bool Finished(int StreamID)
         {
             return false;
         }
 
+        /// <summary>
+        /// Returns one line of decoding statistics for each open stream
+        /// </summary>
+        public virtual string[] GetStats()
+        {
+            return new string[0];
+        }
+
         protected bool AlreadyAdded(int StreamID)
         {
             foreach (VideoStreams st in _Streams)
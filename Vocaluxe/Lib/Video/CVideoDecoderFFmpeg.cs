@@ -16,7 +16,15 @@ namespace Vocaluxe.Lib.Video
 
     class CVideoDecoderFFmpeg : CVideoDecoder
     {
+        private const int MAXPREFETCH = 1;          // videos opened in advance at most
+
         private List<Decoder> _Decoder = new List<Decoder>();
+        private List<Reader> _Readers = new List<Reader>();     // playback state of each stream, same index as _Decoder
+        private List<Decoder> _Prefetched = new List<Decoder>();
+        private Decoder _Handover = null;           // decoder of a shown video which becomes the prefetch when it is closed
+        private bool _HandoverKept = false;         // the prefetches are needed, the handover happens on close
+        private float _HandoverStart = 0f;
+        private float _HandoverGap = 0f;
         private CLOSEPROC closeproc;
         private int _Count = 1;
 
@@ -33,11 +41,13 @@ namespace Vocaluxe.Lib.Video
 
         public override void CloseAll()
         {
+            ClearPrefetches();
+
             lock (MutexDecoder)
             {
-                for (int i = 0; i < _Decoder.Count; i++)
+                for (int i = _Decoder.Count - 1; i >= 0; i--)
 			    {
-			        _Decoder[i].Free(closeproc, i+1);
+			        _Release(i);
 			    }
             }
         }
@@ -45,6 +55,44 @@ namespace Vocaluxe.Lib.Video
         public override int Load(string VideoFileName)
         {
             VideoStreams stream = new VideoStreams(0);
+
+            lock (MutexDecoder)
+            {
+                //A prefetched video has been opened and sought already
+                Decoder prefetched = _Prefetched.Find(delegate(Decoder d) { return d.FileName == VideoFileName; });
+                if (prefetched != null)
+                {
+                    _Prefetched.Remove(prefetched);
+                    _Decoder.Add(prefetched);
+                    _Readers.Add(new Reader());
+                    stream.handle = _Count++;
+                    stream.file = VideoFileName;
+                    _Streams.Add(stream);
+
+                    //A decoder handed over from a paused preview runs again for the new stream
+                    _UpdatePaused(prefetched);
+                    return stream.handle;
+                }
+
+                //A looping video which is already shown is read from the same decoder
+                foreach (Decoder shared in _Decoder)
+                {
+                    if (shared.Shareable && shared.FileName == VideoFileName)
+                    {
+                        shared.References++;
+                        _Decoder.Add(shared);
+                        _Readers.Add(new Reader());
+                        stream.handle = _Count++;
+                        stream.file = VideoFileName;
+                        _Streams.Add(stream);
+
+                        //The decoder may have been paused by all other streams
+                        _UpdatePaused(shared);
+                        return stream.handle;
+                    }
+                }
+            }
+
             Decoder decoder = new Decoder();
 
             if (decoder.Open(VideoFileName))
@@ -52,6 +100,7 @@ namespace Vocaluxe.Lib.Video
                 lock (MutexDecoder)
                 {
                     _Decoder.Add(decoder);
+                    _Readers.Add(new Reader());
                     stream.handle = _Count++;
                     stream.file = VideoFileName;
                     _Streams.Add(stream);
@@ -62,6 +111,72 @@ namespace Vocaluxe.Lib.Video
             return -1;
         }
 
+        public override void Prefetch(string VideoFileName, float Start, float Gap)
+        {
+            lock (MutexDecoder)
+            {
+                if (_Prefetched.Exists(delegate(Decoder d) { return d.FileName == VideoFileName; }))
+                    return;
+
+                //A video which is shown already, like the preview of the song, is not opened a second
+                //time. Its decoder is sought and kept when the stream is closed.
+                Decoder shown = _Decoder.Find(delegate(Decoder d) { return d.FileName == VideoFileName && d.References == 1; });
+                if (shown != null)
+                {
+                    foreach (Decoder decoder in _Prefetched)
+                    {
+                        decoder.Free(closeproc, -1);
+                    }
+                    _Prefetched.Clear();
+
+                    _Handover = shown;
+                    _HandoverKept = false;
+                    _HandoverStart = Start;
+                    _HandoverGap = Gap;
+                    return;
+                }
+            }
+
+            //The decoder opens the file and decodes the first frames at the position in the background
+            Decoder decoder = new Decoder();
+            if (!decoder.Open(VideoFileName))
+                return;
+            decoder.Skip(Start, Gap);
+            decoder.Prefetched = true;
+
+            lock (MutexDecoder)
+            {
+                _Prefetched.Add(decoder);
+                if (_Prefetched.Count > MAXPREFETCH)
+                {
+                    _Prefetched[0].Free(closeproc, -1);
+                    _Prefetched.RemoveAt(0);
+                }
+            }
+        }
+
+        public override void ClearPrefetches()
+        {
+            lock (MutexDecoder)
+            {
+                foreach (Decoder decoder in _Prefetched)
+                {
+                    decoder.Free(closeproc, -1);
+                }
+                _Prefetched.Clear();
+                _Handover = null;
+                _HandoverKept = false;
+            }
+        }
+
+        public override void KeepPrefetches()
+        {
+            lock (MutexDecoder)
+            {
+                _HandoverKept = true;
+            }
+        }
+
         public override bool Close(int StreamID)
         {
             if (_Initialized)
@@ -70,7 +185,7 @@ namespace Vocaluxe.Lib.Video
                 {
                     if (AlreadyAdded(StreamID))
                     {
-                        _Decoder[GetStreamIndex(StreamID)].Free(closeproc, StreamID);
+                        _Release(GetStreamIndex(StreamID));
                         return true;
                     }
                 }
@@ -87,7 +202,12 @@ namespace Vocaluxe.Lib.Video
                 {
                     if (AlreadyAdded(StreamID))
                     {
-                        return _Decoder[GetStreamIndex(StreamID)].GetFrame(ref Frame, Time, ref VideoTime);
+                        int Index = GetStreamIndex(StreamID);
+                        Reader reader = _Readers[Index];
+                        if (reader.Paused)
+                            return false;
+
+                        return _Decoder[Index].GetFrame(ref Frame, Time, ref VideoTime, ref reader.FrameNumber);
                     }
                 }
                 
@@ -119,7 +239,7 @@ namespace Vocaluxe.Lib.Video
                 {
                     if (AlreadyAdded(StreamID))
                     {
-                        return _Decoder[GetStreamIndex(StreamID)].Skip(Start, Gap);
+                        return _Exclusive(GetStreamIndex(StreamID)).Skip(Start, Gap);
                     }
                 }
                 
@@ -135,7 +255,9 @@ namespace Vocaluxe.Lib.Video
                 {
                     if (AlreadyAdded(StreamID))
                     {
-                        _Decoder[GetStreamIndex(StreamID)].Loop = Loop;
+                        int Index = GetStreamIndex(StreamID);
+                        if (_Decoder[Index].Loop != Loop)
+                            _Exclusive(Index).Loop = Loop;
                     }
                 }
                 
@@ -150,7 +272,9 @@ namespace Vocaluxe.Lib.Video
                 {
                     if (AlreadyAdded(StreamID))
                     {
-                        _Decoder[GetStreamIndex(StreamID)].Paused = true;
+                        int Index = GetStreamIndex(StreamID);
+                        _Readers[Index].Paused = true;
+                        _UpdatePaused(_Decoder[Index]);
                     }
                 }
 
@@ -165,7 +289,27 @@ namespace Vocaluxe.Lib.Video
                 {
                     if (AlreadyAdded(StreamID))
                     {
-                        _Decoder[GetStreamIndex(StreamID)].Paused = false;
+                        int Index = GetStreamIndex(StreamID);
+                        _Readers[Index].Paused = false;
+                        _UpdatePaused(_Decoder[Index]);
+                    }
+                }
+
+            }
+        }
+
+        public override void SetPriority(int StreamID, EVideoPriority Priority)
+        {
+            if (_Initialized)
+            {
+                lock (MutexDecoder)
+                {
+                    if (AlreadyAdded(StreamID))
+                    {
+                        //A shared decoder keeps the highest priority of its streams
+                        Decoder decoder = _Decoder[GetStreamIndex(StreamID)];
+                        if (decoder.References <= 1 || Priority < decoder.Priority)
+                            decoder.Priority = Priority;
                     }
                 }
 
@@ -187,6 +331,121 @@ namespace Vocaluxe.Lib.Video
             return true;
         }
 
+        public override string[] GetStats()
+        {
+            List<string> Stats = new List<string>();
+            if (_Initialized)
+            {
+                lock (MutexDecoder)
+                {
+                    for (int i = 0; i < _Decoder.Count; i++)
+                    {
+                        //Shared decoders are listed once
+                        if (_Decoder.IndexOf(_Decoder[i]) != i)
+                            continue;
+
+                        string Line = _Decoder[i].Stats;
+                        if (Line != String.Empty)
+                            Stats.Add(Line);
+                    }
+                }
+            }
+            return Stats.ToArray();
+        }
+
+        /// <summary>
+        /// Drops the reference of a stream to its decoder, the decoder is freed with the last one.
+        /// Has to be called inside MutexDecoder.
+        /// </summary>
+        private void _Release(int Index)
+        {
+            Decoder decoder = _Decoder[Index];
+            if (decoder.References > 1)
+            {
+                decoder.References--;
+                _Decoder.RemoveAt(Index);
+                _Readers.RemoveAt(Index);
+                _Streams.RemoveAt(Index);
+                _UpdatePaused(decoder);
+                return;
+            }
+
+            //Closing the preview while the selection changes drops the handover, the selected song
+            //may have no video at all
+            if (decoder == _Handover && !_HandoverKept)
+                _Handover = null;
+
+            if (decoder == _Handover)
+            {
+                _Decoder.RemoveAt(Index);
+                _Readers.RemoveAt(Index);
+                _Streams.RemoveAt(Index);
+                _Handover = null;
+                _HandoverKept = false;
+
+                decoder.Skip(_HandoverStart, _HandoverGap);
+                decoder.Prefetched = true;
+                _Prefetched.Add(decoder);
+                if (_Prefetched.Count > MAXPREFETCH)
+                {
+                    _Prefetched[0].Free(closeproc, -1);
+                    _Prefetched.RemoveAt(0);
+                }
+                return;
+            }
+
+            //The stream is removed by close_proc once the thread has finished
+            decoder.References = 0;
+            decoder.Free(closeproc, _Streams[Index].handle);
+        }
+
+        /// <summary>
+        /// Returns the decoder of a stream after moving the stream to a decoder of its own if it
+        /// shares one, so it can change its playback without affecting the other streams. The new
+        /// decoder continues with the settings and the position the shared one has been sought to.
+        /// Has to be called inside MutexDecoder.
+        /// </summary>
+        private Decoder _Exclusive(int Index)
+        {
+            Decoder shared = _Decoder[Index];
+            if (shared.References <= 1)
+                return shared;
+
+            Decoder decoder = new Decoder();
+            decoder.Loop = shared.Loop;
+            decoder.Priority = shared.Priority;
+            if (_Readers[Index].Paused)
+                decoder.Paused = true;
+            if (!decoder.Open(shared.FileName))
+                return shared;
+
+            if (shared.SkipStart != 0f || shared.SkipGap != 0f)
+                decoder.Skip(shared.SkipStart, shared.SkipGap);
+
+            shared.References--;
+            _Decoder[Index] = decoder;
+            _Readers[Index].FrameNumber = -1;
+            _UpdatePaused(shared);
+            return decoder;
+        }
+
+        /// <summary>
+        /// Stops the clock of a decoder while all of its streams are paused.
+        /// Has to be called inside MutexDecoder.
+        /// </summary>
+        private void _UpdatePaused(Decoder decoder)
+        {
+            bool Paused = true;
+            for (int i = 0; i < _Decoder.Count; i++)
+            {
+                if (_Decoder[i] == decoder && !_Readers[i].Paused)
+                    Paused = false;
+            }
+
+            if (decoder.Paused != Paused)
+                decoder.Paused = Paused;
+        }
+
         private void close_proc(int StreamID)
         {
             if (_Initialized)
@@ -197,6 +456,7 @@ namespace Vocaluxe.Lib.Video
                     {
                         int Index = GetStreamIndex(StreamID);
                         _Decoder.RemoveAt(Index);
+                        _Readers.RemoveAt(Index);
                         _Streams.RemoveAt(Index);
                     }
                 }
@@ -205,48 +465,37 @@ namespace Vocaluxe.Lib.Video
         }
     }
 
-    struct SFrameBuffer
+    /// <summary>
+    /// The playback state of one stream. Several streams may read the same decoder.
+    /// </summary>
+    class Reader
     {
-        public byte[] data;
-        public float time;
-        public bool displayed;
+        public bool Paused = false;
+        public int FrameNumber = -1;                // number of the frame of the decoder uploaded last
     }
 
     class Decoder
     {
+        private const int DECODEAHEADFRAMES = 5;    // frames acinerella decodes in advance
+
         private IntPtr _instance = IntPtr.Zero;     // acinerella instance
         private IntPtr _videodecoder = IntPtr.Zero; // acinerella video decoder instance
           
-        private Stopwatch _LoopTimer = new Stopwatch();
+        private Stopwatch _LoopTimer = new Stopwatch();    // time since _LoopStart, never reset by reading it
+        private float _LoopStart = 0f;
         private CLOSEPROC _Closeproc;               // delegate for stream closing
         private int _StreamID;                      // stream ID for stream closing
         private string _FileName;                   // current video file name
-                
-        private FileStream _fs;                     // video file stream
-        private TAc_read_callback _rc;              // read callback for acinerella
-        private TAc_seek_callback _sc;              // seek callback for acinerella
         
         private bool _FileOpened = false;
         
-        private float _VideoTimeBase = 0f;          // frame time
-        private float _VideoDecoderTime = 0f;       // time of last decoded frame
         private float _CurrentVideoTime = 0f;       // current video position
-        private bool _BufferFull = false;           // buffer is full, waiting for free frame slot
-
-        private bool _skip = false;                 // do skip
-        private float _Time = 0f;
-        private float _Gap = 0f;
-        private float _Start = 0f;
-        private bool _Loop = false;
         private float _Duration = 0f;
         private float _VideoSkipTime = 0f;          // = VideoGap
-        private float _SkipTime = 0f;               // = Start + VideoGap
         
         private bool _Paused = false;
-        private bool _NoMoreFrames = false;
         private bool _Finished = false;
-        private bool _BeforeLoop = false;
-        
+        private bool _Loop = false;
         
         private int _Width = 0;
         private int _Height = 0;
@@ -256,26 +505,104 @@ namespace Vocaluxe.Lib.Video
         private bool _SetLoop = false;
         private bool _SetSkip = false;
         private bool _terminated = false;
+        private bool _Opening = false;              // the file is opened on the thread pool
+        private int _References = 1;                // streams reading this decoder
+        private EVideoPriority _Priority = EVideoPriority.Preview;
+        private bool _Prefetched = false;           // sought in advance, nothing has been shown yet
+        private IntPtr _Frame = IntPtr.Zero;        // frame fetched last, referenced until the next one is fetched
+        private int _FrameNumber = 0;               // counts the fetched frames
+        private float _FetchTime = -1f;             // time the last frame was fetched for
                 
-        private Thread _thread;
-        //AutoResetEvent EventDecode = new AutoResetEvent(false);
-        SFrameBuffer[] _FrameBuffer = new SFrameBuffer[5];
-        private bool _NewFrame = false;
-        Object MutexFramebuffer = new Object();
+        Object MutexFrame = new Object();
         Object MutexSyncSignals = new Object();
+        Object MutexControl = new Object();
 
-        public Decoder()
+        public void Free(CLOSEPROC close_proc, int StreamID)
         {
-            _rc = new TAc_read_callback(read_proc);
-            _sc = new TAc_seek_callback(seek_proc);            
-            _thread = new Thread(Execute);
+            lock (MutexSyncSignals)
+            {
+                _Closeproc = close_proc;
+                _StreamID = StreamID;
+                _terminated = true;
+
+                //Freed once the file has been opened
+                if (_Opening)
+                    return;
+            }
+            ThreadPool.QueueUserWorkItem(new WaitCallback(FreeProc));
         }
 
-        public void Free(CLOSEPROC close_proc, int StreamID)
+        public string FileName
+        {
+            get { return _FileName; }
+        }
+
+        /// <summary>
+        /// Number of streams reading the frames of this decoder, guarded by the decoder list
+        /// </summary>
+        public int References
+        {
+            get { return _References; }
+            set { _References = value; }
+        }
+
+        /// <summary>
+        /// True if another stream of the same file may read this decoder. Only looping videos
+        /// run on the clock of the decoder, all other ones follow the time of their stream.
+        /// The streams pause on their own, the clock stops when all of them are paused.
+        /// </summary>
+        public bool Shareable
         {
-            _Closeproc = close_proc;
-            _StreamID = StreamID;
-            _terminated = true;                 
+            get { return _References > 0 && !_terminated && _SetLoop; }
+        }
+
+        public EVideoPriority Priority
+        {
+            get { return _Priority; }
+            set
+            {
+                lock (MutexFrame)
+                {
+                    _Priority = value;
+                    if (_FileOpened)
+                        CAcinerella.ac_set_decode_priority(_videodecoder, (TAc_priority)_Priority);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Set after the decoder has been sought to the start of a song in advance. The first
+        /// skip to the same position is left out then.
+        /// </summary>
+        public bool Prefetched
+        {
+            get { return _Prefetched; }
+            set { _Prefetched = value; }
+        }
+
+        /// <summary>
+        /// Position of the last skip, see Skip
+        /// </summary>
+        public float SkipStart
+        {
+            get
+            {
+                lock (MutexSyncSignals)
+                {
+                    return _SetStart;
+                }
+            }
+        }
+
+        public float SkipGap
+        {
+            get
+            {
+                lock (MutexSyncSignals)
+                {
+                    return _SetGap;
+                }
+            }
         }
 
         public float Length
@@ -312,7 +639,11 @@ namespace Vocaluxe.Lib.Video
         public bool Loop
         {
             get { return _SetLoop; }
-            set { _SetLoop = value; }
+            set
+            {
+                _SetLoop = value;
+                DoControl();
+            }
         }
 
         public bool Finished
@@ -323,6 +654,25 @@ namespace Vocaluxe.Lib.Video
             }
         }
 
+        /// <summary>
+        /// Decoding statistics of acinerella in one line, empty if the file is not opened
+        /// </summary>
+        public string Stats
+        {
+            get
+            {
+                TAc_stats Stats;
+                lock (MutexFrame)
+                {
+                    if (!_FileOpened)
+                        return String.Empty;
+
+                    CAcinerella.ac_get_stats(_videodecoder, out Stats);
+                }
+                return FormatStats(Stats);
+            }
+        }
+
         public bool Open(string FileName)
         {
             if (_FileOpened)
@@ -332,47 +682,45 @@ namespace Vocaluxe.Lib.Video
                 return false;
 
             _FileName = FileName;
-            _thread.Priority = ThreadPriority.Normal;
-            _thread.Name = Path.GetFileName(FileName);
-            _thread.Start();
+            _Opening = true;
+            ThreadPool.QueueUserWorkItem(new WaitCallback(OpenProc));
             return true;
         }
        
-        public bool GetFrame(ref STexture frame, float Time, ref float VideoTime)
+        /// <summary>
+        /// Uploads the frame at the time to the texture. FrameNumber is the number of the frame
+        /// the stream has uploaded last, so each stream of a shared decoder gets every frame once.
+        /// </summary>
+        public bool GetFrame(ref STexture frame, float Time, ref float VideoTime, ref int FrameNumber)
         {
             if (!_FileOpened)
                 return false;
 
-            if (_Paused)
-                return false;
-
             if (_SetLoop)
             {
+                //The clock runs from the first frame on and only stops while all streams are
+                //paused, so it does not depend on how many streams read it
                 lock (MutexSyncSignals)
                 { 
-                    _SetTime += _LoopTimer.ElapsedMilliseconds / 1000f;
-                    VideoTime = _SetTime;
+                    if (!_Paused && !_LoopTimer.IsRunning)
+                        _LoopTimer.Start();
 
-                    _LoopTimer.Stop();
-                    _LoopTimer.Reset();
-                    _LoopTimer.Start();
+                    _SetTime = _LoopStart + _LoopTimer.ElapsedMilliseconds / 1000f;
+                    VideoTime = _SetTime;
                 }
 
-                
-                UploadNewFrame(ref frame);
-                //EventDecode.Set();
+                UploadNewFrame(ref frame, ref FrameNumber);
                 return true;
             }
 
-            if (_SetTime != Time)
+            if (_SetTime != Time || FrameNumber != _FrameNumber)
             {
                 lock (MutexSyncSignals)
                 {
                     _SetTime = Time;                   
                 }
-                UploadNewFrame(ref frame);
+                UploadNewFrame(ref frame, ref FrameNumber);
                 VideoTime = _CurrentVideoTime;
-                //EventDecode.Set();
                 return true;
             }
             return false;
@@ -382,104 +730,116 @@ namespace Vocaluxe.Lib.Video
         {
             lock (MutexSyncSignals)
             {
+                bool sought = _Prefetched && _SetStart == Start && _SetGap == Gap;
+                _Prefetched = false;
+                if (sought)
+                    return true;
+
                 _SetStart = Start;
                 _SetGap = Gap;
                 _SetSkip = true;
-                _NoMoreFrames = false;
                 _Finished = false;
             }
-            //EventDecode.Set();
+            DoControl();
 
             return true;
         }
 
         #region Threading
         private void DoSkip()
-        {            
-            _VideoSkipTime = _Gap;
-            _SkipTime = _Start + _Gap;
-            _BeforeLoop = false;           
-
-            if (_SkipTime > 0)
+        {
+            float SkipTime;
+            lock (MutexSyncSignals)
             {
-                _VideoDecoderTime = _SkipTime;
-                try
+                _VideoSkipTime = _SetGap;
+                SkipTime = _SetStart + _SetGap;
+
+                //A looping video runs on its own clock
+                if (_Loop)
                 {
-                    CAcinerella.ac_seek(_videodecoder, -1, (Int64)(_SkipTime * 1000f));
-                }
-                catch (Exception e)
-                {                   
-                    CLog.LogError("Error seeking video file \"" + _FileName + "\": " + e.Message);
+                    _LoopStart = _SetStart;
+                    _SetTime = _SetStart;
+                    _LoopTimer.Reset();
                 }
-                
             }
-            else
+
+            if (SkipTime < 0f)
+                SkipTime = 0f;
+
+            try
+            {
+                CAcinerella.ac_decode_ahead_seek(_videodecoder, SkipTime);
+            }
+            catch (Exception e)
             {
-                _VideoDecoderTime = 0f;
-                try 
-	            {
-                    CAcinerella.ac_seek(_videodecoder, -1, (Int64)0);
-	            }
-	            catch (Exception e)
-	            {
-                    CLog.LogError("Error seeking video file \"" + _FileName + "\": " + e.Message);
-	            }              
+                CLog.LogError("Error seeking video file \"" + _FileName + "\": " + e.Message);
             }
 
             lock (MutexSyncSignals)
             {
-                _CurrentVideoTime = _VideoDecoderTime;
+                _CurrentVideoTime = SkipTime;
             }
-            
-            lock (MutexFramebuffer)
+
+            //The frame before the skip is not shown anymore
+            lock (MutexFrame)
             {
-                for (int i = 0; i < _FrameBuffer.Length; i++)
-                {
-                    _FrameBuffer[i].displayed = true;
-                    _FrameBuffer[i].time = -1f;
-                }
+                if (_Frame != IntPtr.Zero)
+                    CAcinerella.ac_release_frame(_Frame);
+                _Frame = IntPtr.Zero;
             }
-            
-            _BufferFull = false;
-            _skip = false;
-            _NewFrame = false;
-            //EventDecode.Set();
         }
 
-        private void Execute()
+        //The frames are decoded and sought by the threads of acinerella, the thread pool only
+        //opens and frees the file. Skips and loop changes are passed on right away.
+        private void OpenProc(Object State)
         {
             DoOpen();
-            //EventDecode.Set();
 
-            while (!_terminated)
+            bool terminated;
+            lock (MutexSyncSignals)
             {
-                //if (EventDecode.WaitOne(10))
-                {
-                    lock (MutexSyncSignals)
-                    {
-                        _Time = _SetTime;
-                        if (_SetSkip)
-                            _skip = true;
-
-                        _SetSkip = false;
-                        _Gap = _SetGap;
-                        _Start = _SetStart;
-                        _Loop = _SetLoop;
-                    }
+                _Opening = false;
+                terminated = _terminated;
+            }
+
+            if (terminated)
+                DoFree();
+            else
+                DoControl();
+        }
 
-                    if (_skip)
-                        DoSkip();
+        private void FreeProc(Object State)
+        {
+            DoFree();
+        }
+
+        //Passes the skip and loop requests made so far on to acinerella, requests made while
+        //the file is opened are passed on after that
+        private void DoControl()
+        {
+            lock (MutexControl)
+            {
+                bool skip;
+                bool loop;
+                lock (MutexSyncSignals)
+                {
+                    if (_terminated || !_FileOpened)
+                        return;
 
-                    if (!_NewFrame)
-                        DoDecode();
+                    skip = _SetSkip;
+                    _SetSkip = false;
+                    loop = _SetLoop;
+                }
 
-                    if (_NewFrame)
-                        Copy();
-                    Thread.Sleep(1);
+                if (loop != _Loop)
+                {
+                    _Loop = loop;
+                    CAcinerella.ac_decode_ahead_loop(_videodecoder, loop);
                 }
-            }
 
-            DoFree(); 
+                if (skip)
+                    DoSkip();
+            }
         }
 
         private void DoOpen()
@@ -488,11 +848,8 @@ namespace Vocaluxe.Lib.Video
             TAc_instance Instance = new TAc_instance();
             try
             {
-                _fs = new FileStream(_FileName, FileMode.Open, FileAccess.Read, FileShare.Read);
-
-
-                _instance = CAcinerella.ac_init();
-                CAcinerella.ac_open(_instance, IntPtr.Zero, null, _rc, _sc, null, IntPtr.Zero);
+                //The audio of the same file reads from the same instance
+                _instance = CAcSharedInstances.Open(_FileName, TAc_stream_type.AC_STREAM_TYPE_VIDEO);
 
                 Instance = (TAc_instance)Marshal.PtrToStructure(_instance, typeof(TAc_instance));
                 ok = true;
@@ -521,14 +878,26 @@ namespace Vocaluxe.Lib.Video
 
                 if (Info.stream_type == TAc_stream_type.AC_STREAM_TYPE_VIDEO)
                 {
-                    _videodecoder = CAcinerella.ac_create_decoder(_instance, i);
+                    lock (CAcSharedInstances.Lock)
+                    {
+                        //There is no need to decode more pixels than the screen can show
+                        Instance = (TAc_instance)Marshal.PtrToStructure(_instance, typeof(TAc_instance));
+                        Instance.output_max_size = Math.Max(CConfig.ScreenW, CConfig.ScreenH);
+                        Instance.allow_lowres = true;
+                        //The ring of the decode ahead thread, the frame being converted, the one
+                        //the decoder references, the one the streams upload and the one replacing it
+                        Instance.frame_pool_size = DECODEAHEADFRAMES + 4;
+                        Marshal.StructureToPtr(Instance, _instance, false);
+
+                        _videodecoder = CAcinerella.ac_create_decoder(_instance, i);
+                    }
                     
                     VideoStreamIndex = i;
                     break;
                 }
             }
 
-            if (VideoStreamIndex < 0)
+            if (VideoStreamIndex < 0 || _videodecoder == IntPtr.Zero)
             {
                 //Free();
                 return;
@@ -536,272 +905,133 @@ namespace Vocaluxe.Lib.Video
 
             TAc_decoder Videodecoder = (TAc_decoder)Marshal.PtrToStructure(_videodecoder, typeof(TAc_decoder));
 
-            _Width = Videodecoder.stream_info.video_info.frame_width;
-            _Height = Videodecoder.stream_info.video_info.frame_height;
+            _Width = Videodecoder.output_width;
+            _Height = Videodecoder.output_height;
 
-            if (Videodecoder.stream_info.video_info.frames_per_second > 0)
-                _VideoTimeBase = 1f / (float)Videodecoder.stream_info.video_info.frames_per_second;
+            //Rather show the video at a lower quality than fall behind the song
+            CAcinerella.ac_set_auto_discard(_videodecoder, true);
 
-            _VideoDecoderTime = 0f;
-            _Time = 0f;
+            //Short looping videos like theme backgrounds are played from memory after the first pass
+            CAcinerella.ac_set_loop_cache(_videodecoder, (long)CConfig.VideoLoopCacheSize * 1024 * 1024, CConfig.VideoLoopCacheLength);
 
-            for (int i = 0; i < _FrameBuffer.Length; i++)
+            lock (MutexFrame)
             {
-                _FrameBuffer[i].time = -1f;
-                _FrameBuffer[i].displayed = true;
-                _FrameBuffer[i].data = new byte[_Width * _Height * 4];
+                CAcinerella.ac_set_decode_priority(_videodecoder, (TAc_priority)_Priority);
             }
-            _FileOpened = true;
-        }
-
-        private void DoDecode()
-        {
-            const int FRAMEDROPCOUNT = 4;
-
-            if (!_FileOpened || _NewFrame)
-                return;
 
-            if (_Paused || _NoMoreFrames || _BufferFull)
+            _Loop = _SetLoop;
+            if (CAcinerella.ac_start_decode_ahead(_videodecoder, DECODEAHEADFRAMES, _Loop) == 0)
+            {
+                CLog.LogError("Error starting to decode video file: " + _FileName);
                 return;
+            }
 
-            if ((_SkipTime < 0f) && (_Time + _SkipTime >= 0f))
-                _SkipTime = 0f;
-
-            float myTime = _Time + _VideoSkipTime;
-            float TimeDifference = myTime - _VideoDecoderTime;
-
-            bool DropFrame = false;
-            if (TimeDifference >= (FRAMEDROPCOUNT - 1) * _VideoTimeBase)
-                DropFrame = true;
-
-            if (_terminated)
-                return;
+            _FileOpened = true;
+        }
 
-            int FrameFinished = 0;
-            if (DropFrame && !_BeforeLoop)
+        private void UploadNewFrame(ref STexture frame, ref int FrameNumber)
+        {
+            lock (MutexFrame)
             {
-                try
-                {
-                    FrameFinished = CAcinerella.ac_skip_frames(_instance, _videodecoder, FRAMEDROPCOUNT - 1);
-                }
-                catch (Exception)
-                {
-                    CLog.LogError("Error AcSkipFrame " + _FileName);
-                }
-                
-            }
+                if (!_FileOpened)
+                    return;
 
-            if (!_BeforeLoop && (!DropFrame || FrameFinished != 0))
-            {
-                try
-                {
-                    FrameFinished = CAcinerella.ac_get_frame(_instance, _videodecoder);
-                }
-                catch (Exception)
+                float Time;
+                lock (MutexSyncSignals)
                 {
-                    CLog.LogError("Error AcGetFrame " + _FileName);
+                    Time = _SetTime + _VideoSkipTime;
                 }
-            }
 
-            if (FrameFinished == 0)
-            {
-                if (_Loop)
+                //The first stream asking after the clock moved on fetches the frame, the frames of
+                //the decode ahead can only be taken once
+                if (Time != _FetchTime)
                 {
-                    _BeforeLoop = true;
-                    bool doskip = true;
-                    float tm = 0f;
-                    int num = -1;
-                    lock (MutexFramebuffer)
+                    _FetchTime = Time;
+                    IntPtr Frame = CAcinerella.ac_get_frame_at(_videodecoder, Time);
+                    if (Frame != IntPtr.Zero)
                     {
-                        for (int i = 0; i < _FrameBuffer.Length; i++)
+                        if (_Frame != IntPtr.Zero)
+                            CAcinerella.ac_release_frame(_Frame);
+                        _Frame = Frame;
+                        _FrameNumber++;
+
+                        TAc_frame Fetched = (TAc_frame)Marshal.PtrToStructure(_Frame, typeof(TAc_frame));
+                        lock (MutexSyncSignals)
                         {
-                            if (_FrameBuffer[i].time > tm && !_FrameBuffer[i].displayed)
-                            {
-                                tm = _FrameBuffer[i].time;
-                                num = i;
-                            }
+                            _CurrentVideoTime = (float)Fetched.timecode;
                         }
-
-                        if (num >= 0)
-                            doskip = _FrameBuffer[num].displayed;
+                        _Finished = false;
                     }
-
-                    if (!doskip)
-                        return;
-
-                    lock (MutexSyncSignals)
-                    {
-                        _Start = 0f;
-                        _Gap = 0f;
-                        _SetTime = 0f;
-                    }
-
-                    DoSkip();
-                }
-                else
-                {
-                    _NoMoreFrames = true;
+                    else if (CAcinerella.ac_decode_ahead_finished(_videodecoder))
+                        _Finished = true;
                 }
-                return;
-            }
-            else
-            {
-                _NewFrame = true;
-                Copy();
-            }
-        }
 
-        private void Copy()
-        {
-            if (!_NewFrame)
-                return;
+                if (_Frame == IntPtr.Zero || FrameNumber == _FrameNumber)
+                    return;
 
-            int num = -1;
-            
-            lock (MutexFramebuffer)
-            {
-                for (int i = 0; i < _FrameBuffer.Length; i++)
-                {
-                    if (_FrameBuffer[i].displayed)
-                    {
-                        num = i;
-                        break;
-                    }
-                }
-
-                if (num == -1)
+                //The texture is uploaded straight from the frame pool of acinerella
+                TAc_frame VideoFrame = (TAc_frame)Marshal.PtrToStructure(_Frame, typeof(TAc_frame));
+                if (frame.index == -1 || _Width != frame.width || _Height != frame.height)
                 {
-                    _BufferFull = true;
+                    CDraw.RemoveTexture(ref frame);
+                    frame = CDraw.AddTexture(_Width, _Height, VideoFrame.buffer);
                 }
                 else
                 {
-                    TAc_decoder Videodecoder = (TAc_decoder)Marshal.PtrToStructure(_videodecoder, typeof(TAc_decoder));
-
-                    _VideoDecoderTime = (float)Videodecoder.timecode;
-                    _FrameBuffer[num].time = _VideoDecoderTime;
-
-                    if (Videodecoder.buffer != IntPtr.Zero)
-                    {
-                        Marshal.Copy(Videodecoder.buffer, _FrameBuffer[num].data, 0, _Width * _Height * 4);
-
-                        _FrameBuffer[num].displayed = false;
-                    }
-
-                    int numfull = 0;
-                    for (int i = 0; i < _FrameBuffer.Length; i++)
-                    {
-                        if (!_FrameBuffer[i].displayed)
-                            numfull++;
-                    }
-
-                    if (numfull < _FrameBuffer.Length)
-                        _BufferFull = false;
-
-                    _NewFrame = false;
+                    CDraw.UpdateTexture(ref frame, VideoFrame.buffer);
                 }
+                FrameNumber = _FrameNumber;
             }
-
-            //if (!_BufferFull)
-            //    EventDecode.Set();
         }
 
-        private void UploadNewFrame(ref STexture frame)
+        private string FormatStats(TAc_stats Stats)
         {
-            if (!_FileOpened)
-                return;
-
-            lock (MutexFramebuffer)
-            {
-                int num = FindFrame();
-
-                if (num >= 0)
-                {
-                    if (frame.index == -1 || _Width != frame.width || _Height != frame.height)
-                    {
-                        CDraw.RemoveTexture(ref frame);
-                        frame = CDraw.AddTexture(_Width, _Height, ref _FrameBuffer[num].data);
-                    }
-                    else
-                    {
-                        CDraw.UpdateTexture(ref frame, ref _FrameBuffer[num].data);
-                    }
-
-                    lock (MutexSyncSignals)
-                    {
-                        _CurrentVideoTime = _FrameBuffer[num].time;
-                    }
-                    _Finished = false;
-                    //EventDecode.Set();
-                }
-                else
-                {
-                    if (_NoMoreFrames)
-                        _Finished = true;
-                }
-            }
+            long Frames = Math.Max(Stats.frames_decoded, 1L);
+            return Path.GetFileName(_FileName) + ": " +
+                (Stats.decode_time / 1000.0 / Frames).ToString("0.00") + "ms decode, " +
+                (Stats.convert_time / 1000.0 / Frames).ToString("0.00") + "ms convert, " +
+                (Stats.read_time / 1000.0 / Frames).ToString("0.00") + "ms read per frame, " +
+                Stats.frames_decoded.ToString() + " frames, " +
+                Stats.frames_dropped.ToString() + " dropped, " +
+                Stats.frames_sought.ToString() + " sought, " +
+                Stats.frames_late.ToString() + " late, " +
+                "discard level " + Stats.discard_level.ToString() + ", " +
+                Stats.seek_count.ToString() + " seeks (max " + (Stats.seek_time_max / 1000.0).ToString("0.0") + "ms)";
         }
 
-        private int FindFrame()
+        private void DoFree()
         {
-            int Result = -1;
-            float diff = 10000000f;
-
-            for (int i = 0; i < _FrameBuffer.Length; i++)
+            //Waits for a skip which is being passed on
+            lock (MutexControl)
             {
-                float td = _SetTime + _VideoSkipTime - _FrameBuffer[i].time;
-
-                if (td > _VideoTimeBase * 2f)
+                //Videos which did not play smoothly are logged to find the reason later
+                if (_FileOpened)
                 {
-                    _FrameBuffer[i].displayed = true;
+                    TAc_stats Stats;
+                    CAcinerella.ac_get_stats(_videodecoder, out Stats);
+                    if (Stats.frames_dropped > 0 || Stats.frames_late > 0)
+                        CLog.LogPerformance("Video stuttered: " + FormatStats(Stats));
                 }
 
-                if (!_FrameBuffer[i].displayed && (td < diff) && (td > _VideoTimeBase))
+                lock (MutexFrame)
                 {
-                    diff = Math.Abs(_FrameBuffer[i].time - _SetTime - _VideoSkipTime);
-                    Result = i;
-                }
-            }
-
-            if (Result != -1)
-            {
-                _FrameBuffer[Result].displayed = true;
-                _BufferFull = false;
-            }
-
-            return Result;
-        }
+                    _FileOpened = false;
 
-        private void DoFree()
-        {
-            if (_videodecoder != IntPtr.Zero)
-                CAcinerella.ac_free_decoder(_videodecoder);
+                    if (_Frame != IntPtr.Zero)
+                        CAcinerella.ac_release_frame(_Frame);
+                    _Frame = IntPtr.Zero;
+                }
 
-            if (_instance != IntPtr.Zero)
-                CAcinerella.ac_close(_instance);
+                //Stops the decode ahead thread as well
+                if (_videodecoder != IntPtr.Zero)
+                    CAcinerella.ac_free_decoder(_videodecoder);
 
-            if (_instance != IntPtr.Zero)
-                CAcinerella.ac_free(_instance);
+                //Closes the file unless the audio still reads from it
+                CAcSharedInstances.Release(_instance, TAc_stream_type.AC_STREAM_TYPE_VIDEO);
+            }
 
             _Closeproc(_StreamID);
         }
         #endregion Threading
-
-        #region Callbacks
-        private Int32 read_proc(IntPtr sender, IntPtr buf, Int32 size)
-        {
-            Int32 r = 0;
-
-            byte[] bb = new byte[size];
-            r = _fs.Read(bb, 0, size);
-            Marshal.Copy(bb, 0, buf, size);
-
-            return r;
-        }
-
-        private Int64 seek_proc(IntPtr sender, Int64 pos, Int32 whence)
-        {
-            return (Int64)_fs.Seek((long)pos, (SeekOrigin)whence);
-        }
-        #endregion Callbacks
     }
 }
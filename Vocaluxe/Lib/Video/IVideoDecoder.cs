@@ -18,12 +18,25 @@ namespace Vocaluxe.Lib.Video
         }
     }
 
+    /// <summary>
+    /// Decides which videos are decoded first if the decoding can not keep up with all of them
+    /// </summary>
+    enum EVideoPriority
+    {
+        Song,
+        Background,
+        Preview
+    }
+
     interface IVideoDecoder
     {
         bool Init();
         void CloseAll();
 
         int Load(string VideoFileName);
+        void Prefetch(string VideoFileName, float Start, float Gap);
+        void ClearPrefetches();
+        void KeepPrefetches();
         bool Close(int StreamID);
         int GetNumStreams();
 
@@ -33,7 +46,10 @@ namespace Vocaluxe.Lib.Video
         void SetLoop(int StreamID, bool Loop);
         void Pause(int StreamID);
         void Resume(int StreamID);
+        void SetPriority(int StreamID, EVideoPriority Priority);
 
         bool Finished(int StreamID);
+
+        string[] GetStats();
     }
 }
@@ -686,6 +686,20 @@ namespace Vocaluxe.Menu
                 CFonts.DrawText(txt, rect.X, rect.Y, CSettings.zNear);
                 dy += rect.Height;
             }
+
+            if (CConfig.DebugLevel >= EDebugLevel.TR_CONFIG_LEVEL3)
+            {
+                foreach (string Stats in CVideo.VdGetStats())
+                {
+                    txt = Stats;
+
+                    RectangleF rect = new RectangleF(CSettings.iRenderW - CFonts.GetTextWidth(txt), dy, CFonts.GetTextWidth(txt), CFonts.GetTextHeight(txt));
+
+                    CDraw.DrawColor(Gray, new SRectF(rect.X, rect.Top, rect.Width, rect.Height, CSettings.zNear));
+                    CFonts.DrawText(txt, rect.X, rect.Y, CSettings.zNear);
+                    dy += rect.Height;
+                }
+            }
         }
 
         private static void ReloadCursor()
@@ -8,6 +8,7 @@ using System.Xml.XPath;
 
 using Vocaluxe.Base;
 using Vocaluxe.Lib.Draw;
+using Vocaluxe.Lib.Song;
 
 namespace Vocaluxe.Menu.SongMenu
 {
@@ -699,9 +700,28 @@ namespace Vocaluxe.Menu.SongMenu
                     _VideoFadeTimer.Reset();
                     _VideoFadeTimer.Start();
                 }
+
+                PrefetchSongs();
             }
         }
 
+        /// <summary>
+        /// Opens the files of the selected song in advance, so singing it starts without waiting.
+        /// The audio of the neighbours is opened as well, their videos would take too much memory.
+        /// </summary>
+        private void PrefetchSongs()
+        {
+            CSong song = CSongs.VisibleSongs[_actsong];
+            CSound.Prefetch(song.GetMP3());
+            if (song.VideoFileName != String.Empty)
+                CVideo.VdPrefetch(Path.Combine(song.Folder, song.VideoFileName), song.Start, song.VideoGap);
+
+            if (_actsong + 1 < CSongs.NumVisibleSongs)
+                CSound.Prefetch(CSongs.VisibleSongs[_actsong + 1].GetMP3());
+            if (_actsong > 0)
+                CSound.Prefetch(CSongs.VisibleSongs[_actsong - 1].GetMP3());
+        }
+
         protected void Reset()
         {
             foreach (int stream in _streams)
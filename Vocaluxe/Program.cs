@@ -10,6 +10,7 @@ using System.Windows.Forms;
 
 using Vocaluxe.Base;
 using Vocaluxe.Lib.Draw;
+using Vocaluxe.Lib.Video.Acinerella;
 using Vocaluxe.Menu;
 
 namespace Vocaluxe
@@ -76,6 +77,9 @@ namespace Vocaluxe
 
                 Application.DoEvents();
 
+                // Known media files are opened without probing them again
+                CAcinerella.ac_set_info_cache(Path.Combine(Environment.CurrentDirectory, CSettings.sFolderMediaInfoCache));
+
                 // Init Playback
                 CLog.StartBenchmark(0, "Init Playback");
                 CSound.PlaybackInit();
@@ -224,10 +224,7 @@ namespace Vocaluxe.Screens
 
         public override bool UpdateGame()
         {
-            for (int i = 0; i < CSettings.MaxNumPlayer; i++)
-            {
-                CSound.AnalyzeBuffer(i);
-            }
+            CSound.AnalyzeBuffers(CSettings.MaxNumPlayer);
 
             if (_DelayTest != null)
             {
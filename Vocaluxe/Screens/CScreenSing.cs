@@ -8,6 +8,8 @@ using System.Windows.Forms;
 
 using Vocaluxe.Base;
 using Vocaluxe.Lib.Draw;
+using Vocaluxe.Lib.Sound;
+using Vocaluxe.Lib.Video;
 using Vocaluxe.Menu;
 
 using Vocaluxe.Lib.Song;
@@ -517,6 +519,7 @@ namespace Vocaluxe.Screens
             Texts[htTexts(TextSongName)].Text = songname;
 
             _CurrentStream = CSound.Load(song.GetMP3(), true);
+            CSound.SetPriority(_CurrentStream, EAudioPriority.Song);
             CSound.SetStreamVolume(_CurrentStream, _Volume);
             CSound.SetPosition(_CurrentStream, song.Start);
             _CurrentTime = song.Start;
@@ -530,10 +533,15 @@ namespace Vocaluxe.Screens
             if (song.VideoFileName != String.Empty)
             {
                 _CurrentVideo = CVideo.VdLoad(Path.Combine(song.Folder, song.VideoFileName));
+                CVideo.VdSetPriority(_CurrentVideo, EVideoPriority.Song);
                 CVideo.VdSkip(_CurrentVideo, song.Start, song.VideoGap);
                 _VideoAspect = song.VideoAspect;
             }
 
+            //The files opened in advance for other songs are not needed anymore
+            CSound.ClearPrefetches();
+            CVideo.VdClearPrefetches();
+
             CDraw.RemoveTexture(ref _Background);
             if (song.BackgroundFileName != String.Empty)
                 _Background = CDraw.AddTexture(Path.Combine(song.Folder, song.BackgroundFileName));
@@ -29,6 +29,7 @@ namespace Vocaluxe.Screens
 
         private string _SearchText = String.Empty;
         private bool _SearchActive = false;
+        private bool _SongStarted = false;
 
         public CScreenSong()
         {
@@ -175,6 +176,7 @@ namespace Vocaluxe.Screens
         public override void OnShow()
         {
             base.OnShow();
+            _SongStarted = false;
             CGame.EnterNormalGame();
             SongMenus[htSongMenus(SongMenu)].OnShow();
         }
@@ -232,6 +234,13 @@ namespace Vocaluxe.Screens
             base.OnClose();
             CBackgroundMusic.Disabled = false;
             SongMenus[htSongMenus(SongMenu)].OnHide();
+
+            //The files opened in advance are only needed by the selected song
+            if (!_SongStarted)
+            {
+                CSound.ClearPrefetches();
+                CVideo.VdClearPrefetches();
+            }
         }
 
         private void StartSong(int SongNr)
@@ -247,6 +256,8 @@ namespace Vocaluxe.Screens
 
                 CGame.AddVisibleSong(SongNr, gm);
 
+                _SongStarted = true;
+                CVideo.VdKeepPrefetches();
                 CGraphics.FadeTo(EScreens.ScreenNames);
             }
         }